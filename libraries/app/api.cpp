@@ -79,7 +79,8 @@ namespace graphene { namespace app {
     {
        if( api_name == "database_api" )
        {
-          _database_api = std::make_shared< database_api >( std::ref( *_app.chain_database() ) );
+          _database_api = std::make_shared< database_api >( std::ref( *_app.chain_database() ), _app.chain_object_changes(),
+                                                            _app.chain_full_accounts() );
        }
        else if( api_name == "block_api" )
        {
@@ -290,6 +291,21 @@ namespace graphene { namespace app {
         _on_pending_transaction = std::function<void(const variant&)>();
     }
 
+    graphene::chain::execution_profile network_node_api::get_execution_profile() const
+    {
+       return _app.chain_database()->get_execution_profiler().get_profile();
+    }
+
+    void network_node_api::set_execution_profiling(bool enabled)
+    {
+       _app.chain_database()->get_execution_profiler().enable(enabled);
+    }
+
+    void network_node_api::reset_execution_profile()
+    {
+       _app.chain_database()->get_execution_profiler().reset();
+    }
+
     fc::api<network_broadcast_api> login_api::network_broadcast()const
     {
        FC_ASSERT(_network_broadcast_api);
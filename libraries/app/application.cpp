@@ -24,6 +24,8 @@
 #include <graphene/app/api.hpp>
 #include <graphene/app/api_access.hpp>
 #include <graphene/app/application.hpp>
+#include <graphene/app/object_change_set.hpp>
+#include <graphene/app/full_account_cache.hpp>
 #include <graphene/app/plugin.hpp>
 
 #include <graphene/chain/protocol/fee_schedule.hpp>
@@ -35,11 +37,15 @@
 #include <graphene/net/exceptions.hpp>
 
 #include <graphene/utilities/key_conversion.hpp>
+#include <graphene/utilities/thread_pool.hpp>
 #include <graphene/chain/worker_evaluator.hpp>
 
 #include <fc/smart_ref_impl.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/thread/mutex.hpp>
+#include <fc/thread/scoped_lock.hpp>
 #include <fc/rpc/api_connection.hpp>
 #include <fc/rpc/websocket_api.hpp>
 #include <fc/network/resolve.hpp>
@@ -51,6 +57,8 @@
 #include <boost/algorithm/string.hpp>
 
 #include <iostream>
+#include <thread>
+#include <unordered_set>
 
 #include <fc/log/file_appender.hpp>
 #include <fc/log/logger.hpp>
@@ -76,6 +84,143 @@ namespace bpo = boost::program_options;
 
 namespace detail {
 
+   /**
+    * Runs the read-only calls of one websocket or HTTP client on an API thread while holding the chain database
+    * for reading, so a slow query neither waits for nor delays the blocks being applied on the chain thread.
+    * Every other call runs on the chain thread holding the database for writing.  The calls of one client are
+    * handled one at a time, so the state of its APIs is never used by two threads at once.
+    *
+    * The APIs of the client are created and their subscriptions changed on the API thread as well, where their
+    * callbacks are delivered.  The chain thread only reads the subscriptions while it holds the database for
+    * writing, which keeps the API thread out.
+    */
+   class api_thread_connection : public fc::rpc::websocket_api_connection
+   {
+      public:
+         api_thread_connection( fc::http::websocket_connection& c, fc::thread& api_thread, fc::thread& chain_thread,
+                                const chain::database& db )
+            : fc::rpc::websocket_api_connection( c ), _api_thread( api_thread ), _chain_thread( chain_thread ), _db( db )
+         {
+            c.on_message_handler( [this]( const std::string& msg ){ handle_message( msg, true ); } );
+            c.on_http_handler( [this]( const std::string& msg ){ return handle_message( msg, false ); } );
+         }
+
+      private:
+         /// @return the API method called by a request, empty if it is malformed
+         static std::string method_of( const std::string& message )
+         {
+            try
+            {
+               const fc::variant_object request = fc::json::from_string( message ).get_object();
+               const std::string method = request["method"].as_string();
+               if( method != "call" )
+                  return method;
+               // {"method":"call","params":[api,method,args]}
+               const fc::variants& params = request["params"].get_array();
+               return params.size() > 1 ? params[1].as_string() : std::string();
+            }
+            catch( const fc::exception& )
+            {
+               return std::string();
+            }
+         }
+
+         /// the calls that only read the chain database, whichever API they belong to
+         static bool is_read_only( const std::string& method )
+         {
+            static const std::unordered_set<std::string> read_only_methods = {
+               // database_api
+               "get_objects", "get_block_header", "get_block_header_batch", "get_block", "get_transaction",
+               "get_recent_transaction_by_id", "get_block_cache_stats", "get_full_account_cache_stats",
+               "get_chain_properties", "get_global_properties", "get_config", "get_chain_id",
+               "get_dynamic_global_properties", "get_key_references", "is_public_key_registered", "get_accounts",
+               "get_full_accounts", "get_account_by_name", "get_account_references", "lookup_account_names",
+               "lookup_accounts", "get_account_count", "get_account_balances", "get_named_account_balances",
+               "get_balance_objects", "get_vested_balances", "get_vesting_balances", "get_assets", "list_assets",
+               "lookup_asset_symbols", "list_sports", "get_global_betting_statistics", "list_event_groups",
+               "list_events_in_group", "list_betting_market_groups", "list_betting_markets",
+               "get_unmatched_bets_for_bettor", "get_all_unmatched_bets_for_bettor", "get_lotteries",
+               "get_account_lotteries", "get_lottery_balance", "get_sweeps_vesting_balance_object",
+               "get_sweeps_vesting_balance_available_for_claim", "get_order_book", "get_limit_orders",
+               "get_call_orders", "get_settle_orders", "get_margin_positions", "get_ticker", "get_24_volume",
+               "get_trade_history", "get_witnesses", "get_witness_by_account", "lookup_witness_accounts",
+               "get_witness_count", "get_committee_members", "get_committee_member_by_account",
+               "lookup_committee_member_accounts", "get_workers_by_account", "lookup_vote_ids",
+               "get_provisional_vote_totals", "get_transaction_hex", "get_required_signatures",
+               "get_potential_signatures", "get_potential_address_signatures", "verify_authority",
+               "verify_account_authority", "get_required_fees", "get_proposed_transactions", "get_blinded_balances",
+               "get_tournaments_in_state", "get_tournaments_by_state", "get_tournaments", "get_registered_tournaments",
+               // history_api
+               "get_account_history", "get_account_history_operations", "get_relative_account_history",
+               "get_fill_order_history", "get_market_history", "get_market_history_buckets", "list_core_accounts",
+               // block_api
+               "get_blocks",
+               // crypto_api
+               "blind", "blind_sum", "verify_sum", "verify_range", "range_proof_sign", "verify_range_proof_rewind",
+               "range_get_info",
+               // asset_api
+               "get_asset_holders", "get_asset_holders_count", "get_all_asset_holders",
+               // bookie_api
+               "get_binned_order_book", "get_total_matched_bet_amount_for_betting_market_group",
+               "get_events_containing_sub_string", "get_matched_bets_for_bettor", "get_all_matched_bets_for_bettor",
+               // affiliate_stats_api
+               "list_historic_referral_rewards", "list_top_referred_accounts", "list_top_rewards_per_app"
+            };
+            return read_only_methods.find( method ) != read_only_methods.end();
+         }
+
+         /// login creates the APIs, the others change the subscriptions read by their callbacks
+         static bool changes_api_state( const std::string& method )
+         {
+            static const std::unordered_set<std::string> api_state_methods = {
+               // login_api
+               "login",
+               // database_api
+               "set_subscribe_callback", "set_pending_transaction_callback", "set_block_applied_callback",
+               "cancel_all_subscriptions", "subscribe_to_market", "unsubscribe_from_market"
+            };
+            return api_state_methods.find( method ) != api_state_methods.end();
+         }
+
+         /// waits for later blocks, which are applied by other writers
+         static bool waits_for_blocks( const std::string& method )
+         {
+            return method == "broadcast_transaction_synchronous";
+         }
+
+         std::string handle_message( const std::string& message, bool send_message )
+         {
+            fc::scoped_lock<fc::mutex> one_call_at_a_time( _message_mutex );
+            const std::string method = method_of( message );
+            std::string reply;
+            if( is_read_only( method ) || changes_api_state( method ) )
+            {
+               reply = _api_thread.async( [this,&message]() {
+                  chain::read_write_lock::read_guard read( _db.get_read_write_lock() );
+                  return on_message( message, false );
+               }, "api call" ).wait();
+            }
+            else
+            {
+               const bool hold_write_side = !waits_for_blocks( method );
+               reply = _chain_thread.async( [this,&message,hold_write_side]() {
+                  if( !hold_write_side )
+                     return on_message( message, false );
+                  chain::read_write_lock::write_guard write( _db.get_read_write_lock() );
+                  return on_message( message, false );
+               }, "api call" ).wait();
+            }
+            if( send_message && !reply.empty() )
+               _connection.send_message( reply );
+            return reply;
+         }
+
+         fc::thread&             _api_thread;
+         fc::thread&             _chain_thread;
+         const chain::database&  _db;
+         fc::mutex               _message_mutex;
+   };
+
    genesis_state_type create_example_genesis() {
       auto nathan_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("nathan")));
       dlog("Allocating all stake to ${key}", ("key", utilities::key_to_wif(nathan_key)));
@@ -257,7 +402,25 @@ namespace detail {
 
       void new_connection( const fc::http::websocket_connection_ptr& c )
       {
-         auto wsc = std::make_shared<fc::rpc::websocket_api_connection>(*c);
+         if( !_api_threads )
+         {
+            setup_connection( c, std::make_shared<fc::rpc::websocket_api_connection>(*c) );
+            return;
+         }
+
+         // the APIs of the connection are created on its API thread, so their callbacks are delivered there
+         fc::thread& api_thread = _api_threads->next_thread();
+         // the websocket servers call back on the thread that created them, the chain thread
+         fc::thread& chain_thread = fc::thread::current();
+         api_thread.async( [this,&c,&api_thread,&chain_thread]() {
+            chain::read_write_lock::read_guard read( _chain_db->get_read_write_lock() );
+            setup_connection( c, std::make_shared<api_thread_connection>( std::ref(*c), std::ref(api_thread),
+                                                                          std::ref(chain_thread), std::ref(*_chain_db) ) );
+         }, "new api connection" ).wait();
+      }
+
+      void setup_connection( const fc::http::websocket_connection_ptr& c, const std::shared_ptr<fc::rpc::websocket_api_connection>& wsc )
+      {
          auto login = std::make_shared<graphene::app::login_api>( std::ref(*_self) );
          login->enable_api("database_api");
 
@@ -325,7 +488,9 @@ namespace detail {
 
       application_impl(application* self)
          : _self(self),
-           _chain_db(std::make_shared<chain::database>())
+           _chain_db(std::make_shared<chain::database>()),
+           _chain_object_changes(std::make_shared<object_change_set>(std::ref(*_chain_db))),
+           _chain_full_accounts(std::make_shared<full_account_cache>(std::ref(*_chain_db)))
       {
       }
 
@@ -409,18 +574,59 @@ namespace detail {
          }
          _chain_db->add_checkpoints( loaded_checkpoints );
 
+         if( _options->count("worker-threads") )
+            _chain_db->set_worker_threads( _options->at("worker-threads").as<uint32_t>() );
+         else
+            _chain_db->set_worker_threads( std::thread::hardware_concurrency() );
+         if( _options->count("block-cache-size") )
+            _chain_db->get_block_cache().set_max_size( _options->at("block-cache-size").as<uint32_t>() );
+         if( _options->count("full-account-cache-size") )
+            _chain_full_accounts->set_max_size( _options->at("full-account-cache-size").as<uint32_t>() );
+         if( _options->count("block-log-retain") )
+            _chain_db->set_block_log_retain( _options->at("block-log-retain").as<uint32_t>() );
+         if( _options->count("incremental-state-save") )
+            _chain_db->set_incremental_save( _options->at("incremental-state-save").as<bool>() );
+         if( _options->count("state-checkpoint-interval") )
+            _chain_db->set_state_checkpoint_interval( _options->at("state-checkpoint-interval").as<uint32_t>() );
+         if( _options->count("profile-execution") )
+            _chain_db->get_execution_profiler().enable( _options->at("profile-execution").as<bool>() );
+         _chain_db->get_execution_profiler().set_log_interval( _options->count("profile-log-interval")
+                                                               ? _options->at("profile-log-interval").as<uint32_t>()
+                                                               : 1200 );
+         if( _options->count("max-pending-transactions") )
+            _chain_db->set_max_pending_transactions( _options->at("max-pending-transactions").as<uint32_t>() );
+         if( _options->count("verify-vote-totals") )
+            _chain_db->set_verify_vote_totals( _options->at("verify-vote-totals").as<bool>() );
+
          bool replay = false;
          std::string replay_reason = "reason not provided";
+         bool bootstrap = _options->count("bootstrap-from-snapshot")
+                          && !fc::exists( _data_dir / "blockchain" / "object_database" );
+
+         auto write_db_version = [&] {
+            const auto mode = std::ios::out | std::ios::binary | std::ios::trunc;
+            std::ofstream db_version( (_data_dir / "db_version").generic_string().c_str(), mode );
+            std::string version_string = GRAPHENE_CURRENT_DB_VERSION;
+            db_version.write( version_string.c_str(), version_string.size() );
+            db_version.close();
+         };
 
+         if( bootstrap )
+         {
+            fc::remove_all( _data_dir / "db_version" );
+            _chain_db->open_from_snapshot( _data_dir / "blockchain",
+                                           _options->at("bootstrap-from-snapshot").as<boost::filesystem::path>() );
+            write_db_version();
+         }
          // never replay if data dir is empty
-         if( fc::exists( _data_dir ) && fc::directory_iterator( _data_dir ) != fc::directory_iterator() )
+         else if( fc::exists( _data_dir ) && fc::directory_iterator( _data_dir ) != fc::directory_iterator() )
          {
             if( _options->count("replay-blockchain") )
             {
                replay = true;
                replay_reason = "replay-blockchain argument specified";
             }
-            else if( !clean )
+            else if( !clean && _chain_db->state_checkpoint_interval() == 0 )
             {
                replay = true;
                replay_reason = "unclean shutdown detected";
@@ -440,10 +646,12 @@ namespace detail {
                    replay = true;
                    replay_reason = "db_version file content mismatch";
                }
+               else if( !clean )
+                  ilog( "Unclean shutdown detected, resuming from the last state checkpoint" );
             }
          }
 
-         if( !replay )
+         if( !replay && !bootstrap )
          {
             try
             {
@@ -464,12 +672,7 @@ namespace detail {
 
             fc::remove_all( _data_dir / "db_version" );
             _chain_db->reindex( _data_dir / "blockchain", initial_state() );
-
-            const auto mode = std::ios::out | std::ios::binary | std::ios::trunc;
-            std::ofstream db_version( (_data_dir / "db_version").generic_string().c_str(), mode );
-            std::string version_string = GRAPHENE_CURRENT_DB_VERSION;
-            db_version.write( version_string.c_str(), version_string.size() );
-            db_version.close();
+            write_db_version();
          }
 
          if( _options->count("force-validate") )
@@ -499,6 +702,8 @@ namespace detail {
          }
 
          reset_p2p_node(_data_dir);
+         if( _options->count("api-threads") && _options->at("api-threads").as<uint32_t>() > 0 )
+            _api_threads.reset( new graphene::utilities::thread_pool( _options->at("api-threads").as<uint32_t>(), "api" ) );
          reset_websocket_server();
          reset_websocket_tls_server();
       } FC_LOG_AND_RETHROW() }
@@ -675,6 +880,13 @@ namespace detail {
            if (!found_a_block_in_synopsis)
              FC_THROW_EXCEPTION(graphene::net::peer_is_on_an_unreachable_fork, "Unable to provide a list of blocks starting at any of the blocks in peer's synopsis");
          }
+
+         // only offer blocks we still have, a peer that needs pruned ones must sync from someone else
+         const uint32_t first_retained_block_num = _chain_db->first_retained_block_num();
+         if( block_header::num_from_id(last_known_block_id) + 1 < first_retained_block_num )
+           FC_THROW_EXCEPTION(graphene::net::peer_is_on_an_unreachable_fork,
+                              "Unable to provide a list of blocks, blocks before ${n} have been pruned",
+                              ("n", first_retained_block_num));
          for( uint32_t num = block_header::num_from_id(last_known_block_id);
               num <= _chain_db->head_block_num() && result.size() < limit;
               ++num )
@@ -695,13 +907,22 @@ namespace detail {
         // ilog("Request for item ${id}", ("id", id));
          if( id.item_type == graphene::net::block_message_type )
          {
-            auto opt_block = _chain_db->fetch_block_by_id(id.item_hash);
-            if( !opt_block )
+            auto packed_block = _chain_db->fetch_packed_block_by_id(id.item_hash);
+            if( !packed_block )
                elog("Couldn't find block ${id} -- corresponding ID in our chain is ${id2}",
                     ("id", id.item_hash)("id2", _chain_db->get_block_id_for_num(block_header::num_from_id(id.item_hash))));
-            FC_ASSERT( opt_block.valid() );
-            // ilog("Serving up block #${num}", ("num", opt_block->block_num()));
-            return block_message(std::move(*opt_block));
+            FC_ASSERT( packed_block );
+            // ilog("Serving up block #${num}", ("num", block_header::num_from_id(id.item_hash)));
+
+            // same bytes as message(block_message(block)), without unpacking and packing the block again
+            message msg;
+            msg.msg_type = block_message::type;
+            msg.data.reserve( packed_block->size() + sizeof(block_id_type) );
+            msg.data.insert( msg.data.end(), packed_block->begin(), packed_block->end() );
+            auto packed_id = fc::raw::pack( block_id_type( id.item_hash ) );
+            msg.data.insert( msg.data.end(), packed_id.begin(), packed_id.end() );
+            msg.size = (uint32_t)msg.data.size();
+            return msg;
          }
          return trx_message( _chain_db->get_recent_transaction( id.item_hash ) );
       } FC_CAPTURE_AND_RETHROW( (id) ) }
@@ -860,8 +1081,8 @@ namespace detail {
               return synopsis; // we have no blocks
           }
           
-          if( low_block_num == 0)
-             low_block_num = 1;
+          // never advertise blocks that have been pruned from our block log
+          low_block_num = std::max( low_block_num, _chain_db->first_retained_block_num() );
 
           // at this point:
           // low_block_num is the block before the first block we can undo,
@@ -951,7 +1172,11 @@ namespace detail {
       api_access _apiaccess;
 
       std::shared_ptr<graphene::chain::database>            _chain_db;
+      std::shared_ptr<object_change_set>                    _chain_object_changes;
+      std::shared_ptr<full_account_cache>                   _chain_full_accounts;
       std::shared_ptr<graphene::net::node>                  _p2p_network;
+      /// destroyed after the servers, see api_thread_connection
+      std::unique_ptr<graphene::utilities::thread_pool>     _api_threads;
       std::shared_ptr<fc::http::websocket_server>      _websocket_server;
       std::shared_ptr<fc::http::websocket_tls_server>  _websocket_tls_server;
 
@@ -994,6 +1219,18 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("genesis-json", bpo::value<boost::filesystem::path>(), "File to read Genesis State from")
          ("dbg-init-key", bpo::value<string>(), "Block signing key to use for init witnesses, overrides genesis file")
          ("api-access", bpo::value<boost::filesystem::path>(), "JSON file specifying API permissions")
+         ("worker-threads", bpo::value<uint32_t>(), "Number of threads used to parallelize block validation work such as signature recovery (default: number of CPU cores, 0 to disable)")
+         ("api-threads", bpo::value<uint32_t>(), "Number of threads serving websocket and HTTP API calls while blocks are applied (default: 0, serve them on the chain thread)")
+         ("block-cache-size", bpo::value<uint32_t>(), "Number of recent blocks kept unpacked in memory for peers and API clients (default: 2000, 0 to disable)")
+         ("full-account-cache-size", bpo::value<uint32_t>(), "Number of accounts whose get_full_accounts result is kept in memory (default: 1000, 0 to disable)")
+         ("bootstrap-from-snapshot", bpo::value<boost::filesystem::path>(), "Load the state from a binary snapshot (see snapshot-format) and replay only the blocks after it, instead of replaying the whole chain. Ignored if the node already has a state")
+         ("block-log-retain", bpo::value<uint32_t>(), "Prune the block log down to about this many of the most recent blocks (default: 0, keep all blocks). A pruned block log cannot be replayed")
+         ("incremental-state-save", bpo::value<bool>(), "On shutdown, save only the objects that changed since the last save (default: false)")
+         ("state-checkpoint-interval", bpo::value<uint32_t>(), "Save the changed objects every this many blocks, so that an unclean shutdown does not require a replay (default: 0, never). Implies incremental-state-save")
+         ("profile-execution", bpo::value<bool>(), "Time every operation and every step of applying a block, see network_node_api::get_execution_profile (default: false)")
+         ("profile-log-interval", bpo::value<uint32_t>(), "While profiling, log the most expensive operations and block steps every this many blocks (default: 1200, 0 to disable)")
+         ("max-pending-transactions", bpo::value<uint32_t>(), "Number of unconfirmed transactions kept, when full the ones paying the lowest fee per byte are dropped (default: 100000)")
+         ("verify-vote-totals", bpo::value<bool>(), "At every maintenance interval, check the running vote totals served by get_provisional_vote_totals against a full recount and log differences (default: false)")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
@@ -1069,6 +1306,16 @@ std::shared_ptr<chain::database> application::chain_database() const
    return my->_chain_db;
 }
 
+std::shared_ptr<object_change_set> application::chain_object_changes() const
+{
+   return my->_chain_object_changes;
+}
+
+std::shared_ptr<full_account_cache> application::chain_full_accounts() const
+{
+   return my->_chain_full_accounts;
+}
+
 void application::set_block_production(bool producing_blocks)
 {
    my->_is_block_producer = producing_blocks;
@@ -1102,6 +1349,9 @@ void application::shutdown_plugins()
 }
 void application::shutdown()
 {
+   // no new API calls, the database waits for the ones in progress when it closes
+   my->_websocket_server.reset();
+   my->_websocket_tls_server.reset();
    if( my->_p2p_network )
       my->_p2p_network->close();
    if( my->_chain_db )
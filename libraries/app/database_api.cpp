@@ -28,6 +28,7 @@
 #include <graphene/chain/account_object.hpp>
 
 #include <fc/bloom_filter.hpp>
+#include <fc/thread/thread.hpp>
 #include <fc/smart_ref_impl.hpp>
 
 #include <fc/crypto/hex.hpp>
@@ -91,7 +92,8 @@ class database_api_impl;
 class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 {
    public:
-      database_api_impl( graphene::chain::database& db );
+      database_api_impl( graphene::chain::database& db, std::shared_ptr<object_change_set> changes,
+                         std::shared_ptr<full_account_cache> accounts );
       ~database_api_impl();
 
       // Objects
@@ -108,6 +110,8 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       map<uint32_t, optional<block_header>> get_block_header_batch(const vector<uint32_t> block_nums)const;
       optional<signed_block> get_block(uint32_t block_num)const;
       processed_transaction get_transaction( uint32_t block_num, uint32_t trx_in_block )const;
+      block_cache::stats get_block_cache_stats()const;
+      full_account_cache::stats get_full_account_cache_stats()const;
       void check_transaction_for_duplicated_operations(const signed_transaction& trx);
 
       // Globals
@@ -125,6 +129,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       // Accounts
       vector<optional<account_object>> get_accounts(const vector<account_id_type>& account_ids)const;
       std::map<string,full_account> get_full_accounts( const vector<string>& names_or_ids, bool subscribe );
+      std::shared_ptr<const full_account> make_full_account( const account_object& account )const;
       optional<account_object> get_account_by_name( string name )const;
       vector<account_id_type> get_account_references( account_id_type account_id )const;
       vector<optional<account_object>> lookup_account_names(const vector<string>& account_names)const;
@@ -173,6 +178,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       void unsubscribe_from_market(asset_id_type a, asset_id_type b);
       market_ticker                      get_ticker( const string& base, const string& quote )const;
       market_volume                      get_24_volume( const string& base, const string& quote )const;
+      const market_ticker_object*        find_market_ticker( asset_id_type a, asset_id_type b )const;
       order_book                         get_order_book( const string& base, const string& quote, unsigned limit = 50 )const;
       vector<market_trade>               get_trade_history( const string& base, const string& quote, fc::time_point_sec start, fc::time_point_sec stop, unsigned limit = 100 )const;
 
@@ -189,6 +195,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 
       // Votes
       vector<variant> lookup_vote_ids( const vector<vote_id_type>& votes )const;
+      vector<uint64_t> get_provisional_vote_totals( const vector<vote_id_type>& votes )const;
 
       // Authority / validation
       std::string get_transaction_hex(const signed_transaction& trx)const;
@@ -236,38 +243,37 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
          return _subscribe_filter.contains( i );
       }
 
-      bool is_impacted_account( const flat_set<account_id_type>& accounts)
+      bool is_impacted_account( const impacted_account_set& impacted_accounts )
       {
-         if( !_subscribed_accounts.size() || !accounts.size() )
+         if( !_subscribed_accounts.size() )
             return false;
 
+         const flat_set<account_id_type>& accounts = impacted_accounts.get();
          return std::any_of(accounts.begin(), accounts.end(), [this](const account_id_type& account) {
             return _subscribed_accounts.find(account) != _subscribed_accounts.end();
          });
       }
 
       template<typename T>
-      void enqueue_if_subscribed_to_market(const object* obj, market_queue_type& queue, bool full_object=true)
+      void enqueue_if_subscribed_to_market(const object_changes& changes, size_t i, market_queue_type& queue, bool full_object=true)
       {
-         const T* order = dynamic_cast<const T*>(obj);
+         const T* order = dynamic_cast<const T*>(changes.get_object(i));
          FC_ASSERT( order != nullptr);
 
          auto market = order->get_market();
 
          auto sub = _market_subscriptions.find( market );
          if( sub != _market_subscriptions.end() ) {
-            queue[market].emplace_back( full_object ? obj->to_variant() : fc::variant(obj->id) );
+            queue[market].emplace_back( full_object ? *changes.get_variant(i) : fc::variant(order->id) );
          }
       }
 
       void broadcast_updates( const vector<variant>& updates );
       void broadcast_market_updates( const market_queue_type& queue);
-      void handle_object_changed(bool force_notify, bool full_object, const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts, std::function<const object*(object_id_type id)> find_object);
+      void handle_object_changed(bool force_notify, bool full_object, const object_changes& changes);
 
       /** called every time a block is applied to report the objects that were changed */
-      void on_objects_new(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts);
-      void on_objects_changed(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts);
-      void on_objects_removed(const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts);
+      void on_objects_changed(const object_changes& changes);
       void on_applied_block();
 
       bool _notify_remove_create = false;
@@ -277,13 +283,15 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       std::function<void(const fc::variant&)> _pending_trx_callback;
       std::function<void(const fc::variant&)> _block_applied_callback;
 
-      boost::signals2::scoped_connection                                                                                           _new_connection;
+      std::shared_ptr<object_change_set>                                                                                           _changes;
+      std::shared_ptr<full_account_cache>                                                                                          _full_accounts;
       boost::signals2::scoped_connection                                                                                           _change_connection;
-      boost::signals2::scoped_connection                                                                                           _removed_connection;
       boost::signals2::scoped_connection                                                                                           _applied_block_connection;
       boost::signals2::scoped_connection                                                                                           _pending_trx_connection;
       map< pair<asset_id_type,asset_id_type>, std::function<void(const variant&)> >      _market_subscriptions;
       graphene::chain::database&                                                                                                            _db;
+      /// the thread this API was created on, callbacks are delivered there so they never race with its calls
+      fc::thread&                                                                                                                          _api_thread;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -293,21 +301,26 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 //////////////////////////////////////////////////////////////////////
 
 database_api::database_api( graphene::chain::database& db )
-   : my( new database_api_impl( db ) ) {}
+   : my( new database_api_impl( db, std::shared_ptr<object_change_set>(), std::shared_ptr<full_account_cache>() ) ) {}
+
+database_api::database_api( graphene::chain::database& db, std::shared_ptr<object_change_set> changes )
+   : my( new database_api_impl( db, changes, std::shared_ptr<full_account_cache>() ) ) {}
+
+database_api::database_api( graphene::chain::database& db, std::shared_ptr<object_change_set> changes,
+                            std::shared_ptr<full_account_cache> accounts )
+   : my( new database_api_impl( db, changes, accounts ) ) {}
 
 database_api::~database_api() {}
 
-database_api_impl::database_api_impl( graphene::chain::database& db ):_db(db)
+database_api_impl::database_api_impl( graphene::chain::database& db, std::shared_ptr<object_change_set> changes,
+                                      std::shared_ptr<full_account_cache> accounts )
+   :_changes(changes),_full_accounts(accounts),_db(db),_api_thread(fc::thread::current())
 {
    wlog("creating database api ${x}", ("x",int64_t(this)) );
-   _new_connection = _db.new_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_new(ids, impacted_accounts);
-                                });
-   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_changed(ids, impacted_accounts);
-                                });
-   _removed_connection = _db.removed_objects.connect([this](const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_removed(ids, objs, impacted_accounts);
+   if( !_changes )
+      _changes = std::make_shared<object_change_set>( std::ref( _db ) );
+   _change_connection = _changes->applied.connect([this](const object_changes& changes) {
+                                on_objects_changed(changes);
                                 });
    _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ on_applied_block(); });
 
@@ -479,6 +492,28 @@ processed_transaction database_api_impl::get_transaction(uint32_t block_num, uin
    return opt_block->transactions[trx_num];
 }
 
+block_cache::stats database_api::get_block_cache_stats()const
+{
+   return my->get_block_cache_stats();
+}
+
+block_cache::stats database_api_impl::get_block_cache_stats()const
+{
+   return _db.get_block_cache().get_stats();
+}
+
+full_account_cache::stats database_api::get_full_account_cache_stats()const
+{
+   return my->get_full_account_cache_stats();
+}
+
+full_account_cache::stats database_api_impl::get_full_account_cache_stats()const
+{
+   if( !_full_accounts )
+      return full_account_cache::stats();
+   return _full_accounts->get_stats();
+}
+
 void database_api::check_transaction_for_duplicated_operations(const signed_transaction& trx)
 {
    my->check_transaction_for_duplicated_operations(trx);
@@ -735,92 +770,109 @@ std::map<std::string, full_account> database_api_impl::get_full_accounts( const
          subscribe_to_item( account->id );
       }
 
-      // fc::mutable_variant_object full_account;
-      full_account acnt;
-      acnt.account = *account;
-      acnt.statistics = account->statistics(_db);
-      acnt.registrar_name = account->registrar(_db).name;
-      acnt.referrer_name = account->referrer(_db).name;
-      acnt.lifetime_referrer_name = account->lifetime_referrer(_db).name;
-      acnt.votes = lookup_vote_ids( vector<vote_id_type>(account->options.votes.begin(),account->options.votes.end()) );
-
-      // Add the account itself, its statistics object, cashback balance, and referral account names
-      /*
-      full_account("account", *account)("statistics", account->statistics(_db))
-            ("registrar_name", account->registrar(_db).name)("referrer_name", account->referrer(_db).name)
-            ("lifetime_referrer_name", account->lifetime_referrer(_db).name);
-            */
-      if (account->cashback_vb)
-      {
-         acnt.cashback_balance = account->cashback_balance(_db);
-      }
-      // Add the account's proposals
-      const auto& proposal_idx = _db.get_index_type<proposal_index>();
-      const auto& pidx = dynamic_cast<const primary_index<proposal_index>&>(proposal_idx);
-      const auto& proposals_by_account = pidx.get_secondary_index<graphene::chain::required_approval_index>();
-      auto  required_approvals_itr = proposals_by_account._account_to_proposals.find( account->id );
-      if( required_approvals_itr != proposals_by_account._account_to_proposals.end() )
+      std::shared_ptr<const full_account> acnt;
+      if( _full_accounts )
+         acnt = _full_accounts->find( account->id );
+      if( !acnt )
       {
-         acnt.proposals.reserve( required_approvals_itr->second.size() );
-         for( auto proposal_id : required_approvals_itr->second )
-            acnt.proposals.push_back( proposal_id(_db) );
+         acnt = make_full_account( *account );
+         if( _full_accounts )
+            _full_accounts->insert( acnt );
       }
 
+      // The votes are not cached, see full_account_cache
+      full_account& result = results[account_name_or_id];
+      result = *acnt;
+      result.votes = lookup_vote_ids( vector<vote_id_type>(account->options.votes.begin(),account->options.votes.end()) );
+   }
+   return results;
+}
 
-      // Add the account's balances
-      auto balance_range = _db.get_index_type<account_balance_index>().indices().get<by_account_asset>().equal_range(boost::make_tuple(account->id));
-      //vector<account_balance_object> balances;
-      std::for_each(balance_range.first, balance_range.second,
-                    [&acnt](const account_balance_object& balance) {
-                       acnt.balances.emplace_back(balance);
-                    });
-
-      // Add the account's vesting balances
-      auto vesting_range = _db.get_index_type<vesting_balance_index>().indices().get<by_account>().equal_range(account->id);
-      std::for_each(vesting_range.first, vesting_range.second,
-                    [&acnt](const vesting_balance_object& balance) {
-                       acnt.vesting_balances.emplace_back(balance);
-                    });
-
-      // Add the account's orders
-      auto order_range = _db.get_index_type<limit_order_index>().indices().get<by_account>().equal_range(account->id);
-      std::for_each(order_range.first, order_range.second,
-                    [&acnt] (const limit_order_object& order) {
-                       acnt.limit_orders.emplace_back(order);
-                    });
-      auto call_range = _db.get_index_type<call_order_index>().indices().get<by_account>().equal_range(account->id);
-      std::for_each(call_range.first, call_range.second,
-                    [&acnt] (const call_order_object& call) {
-                       acnt.call_orders.emplace_back(call);
-                    });
-      auto settle_range = _db.get_index_type<force_settlement_index>().indices().get<by_account>().equal_range(account->id);
-      std::for_each(settle_range.first, settle_range.second,
-                    [&acnt] (const force_settlement_object& settle) {
-                       acnt.settle_orders.emplace_back(settle);
-                    });
-
-      // get assets issued by user
-      auto asset_range = _db.get_index_type<asset_index>().indices().get<by_issuer>().equal_range(account->id);
-      std::for_each(asset_range.first, asset_range.second,
-                    [&acnt] (const asset_object& asset) {
-                       acnt.assets.emplace_back(asset.id);
-                    });
-
-      // get withdraws permissions
-      auto withdraw_range = _db.get_index_type<withdraw_permission_index>().indices().get<by_from>().equal_range(account->id);
-      std::for_each(withdraw_range.first, withdraw_range.second,
-                    [&acnt] (const withdraw_permission_object& withdraw) {
-                       acnt.withdraws.emplace_back(withdraw);
-                    });
+std::shared_ptr<const full_account> database_api_impl::make_full_account( const account_object& account )const
+{
+   // fc::mutable_variant_object full_account;
+   full_account acnt;
+   acnt.account = account;
+   acnt.statistics = account.statistics(_db);
+   acnt.registrar_name = account.registrar(_db).name;
+   acnt.referrer_name = account.referrer(_db).name;
+   acnt.lifetime_referrer_name = account.lifetime_referrer(_db).name;
 
-      auto pending_payouts_range = 
-         _db.get_index_type<pending_dividend_payout_balance_for_holder_object_index>().indices().get<by_account_dividend_payout>().equal_range(boost::make_tuple(account->id));
+   // Add the account itself, its statistics object, cashback balance, and referral account names
+   /*
+   full_account("account", account)("statistics", account.statistics(_db))
+         ("registrar_name", account.registrar(_db).name)("referrer_name", account.referrer(_db).name)
+         ("lifetime_referrer_name", account.lifetime_referrer(_db).name);
+         */
+   if (account.cashback_vb)
+   {
+      acnt.cashback_balance = account.cashback_balance(_db);
+   }
+   // Add the account's proposals
+   const auto& proposal_idx = _db.get_index_type<proposal_index>();
+   const auto& pidx = dynamic_cast<const primary_index<proposal_index>&>(proposal_idx);
+   const auto& proposals_by_account = pidx.get_secondary_index<graphene::chain::required_approval_index>();
+   auto  required_approvals_itr = proposals_by_account._account_to_proposals.find( account.id );
+   if( required_approvals_itr != proposals_by_account._account_to_proposals.end() )
+   {
+      acnt.proposals.reserve( required_approvals_itr->second.size() );
+      for( auto proposal_id : required_approvals_itr->second )
+         acnt.proposals.push_back( proposal_id(_db) );
+   }
 
-      std::copy(pending_payouts_range.first, pending_payouts_range.second, std::back_inserter(acnt.pending_dividend_payments));
 
-      results[account_name_or_id] = acnt;
-   }
-   return results;
+   // Add the account's balances
+   auto balance_range = _db.get_index_type<account_balance_index>().indices().get<by_account_asset>().equal_range(boost::make_tuple(account.id));
+   //vector<account_balance_object> balances;
+   std::for_each(balance_range.first, balance_range.second,
+                 [&acnt](const account_balance_object& balance) {
+                    acnt.balances.emplace_back(balance);
+                 });
+
+   // Add the account's vesting balances
+   auto vesting_range = _db.get_index_type<vesting_balance_index>().indices().get<by_account>().equal_range(account.id);
+   std::for_each(vesting_range.first, vesting_range.second,
+                 [&acnt](const vesting_balance_object& balance) {
+                    acnt.vesting_balances.emplace_back(balance);
+                 });
+
+   // Add the account's orders
+   auto order_range = _db.get_index_type<limit_order_index>().indices().get<by_account>().equal_range(account.id);
+   std::for_each(order_range.first, order_range.second,
+                 [&acnt] (const limit_order_object& order) {
+                    acnt.limit_orders.emplace_back(order);
+                 });
+   auto call_range = _db.get_index_type<call_order_index>().indices().get<by_account>().equal_range(account.id);
+   std::for_each(call_range.first, call_range.second,
+                 [&acnt] (const call_order_object& call) {
+                    acnt.call_orders.emplace_back(call);
+                 });
+   auto settle_range = _db.get_index_type<force_settlement_index>().indices().get<by_account>().equal_range(account.id);
+   std::for_each(settle_range.first, settle_range.second,
+                 [&acnt] (const force_settlement_object& settle) {
+                    acnt.settle_orders.emplace_back(settle);
+                 });
+
+   // get assets issued by user
+   auto asset_range = _db.get_index_type<asset_index>().indices().get<by_issuer>().equal_range(account.id);
+   std::for_each(asset_range.first, asset_range.second,
+                 [&acnt] (const asset_object& asset) {
+                    acnt.assets.emplace_back(asset.id);
+                 });
+
+   // get withdraws permissions
+   auto withdraw_range = _db.get_index_type<withdraw_permission_index>().indices().get<by_from>().equal_range(account.id);
+   std::for_each(withdraw_range.first, withdraw_range.second,
+                 [&acnt] (const withdraw_permission_object& withdraw) {
+                    acnt.withdraws.emplace_back(withdraw);
+                 });
+
+   auto pending_payouts_range = 
+      _db.get_index_type<pending_dividend_payout_balance_for_holder_object_index>().indices().get<by_account_dividend_payout>().equal_range(boost::make_tuple(account.id));
+
+   std::copy(pending_payouts_range.first, pending_payouts_range.second, std::back_inserter(acnt.pending_dividend_payments));
+
+   return std::make_shared<const full_account>( std::move( acnt ) );
 }
 
 optional<account_object> database_api::get_account_by_name( string name )const
@@ -1411,39 +1463,36 @@ market_ticker database_api_impl::get_ticker( const string& base, const string& q
     result.quote_volume = 0;
 
     try {
-        const fc::time_point_sec now = fc::time_point::now();
-        const fc::time_point_sec yesterday = fc::time_point_sec( now.sec_since_epoch() - 86400 );
-        const auto batch_size = 100;
-
-        vector<market_trade> trades = get_trade_history( base, quote, now, yesterday, batch_size );
-        if( !trades.empty() )
+        const market_ticker_object* ticker = find_market_ticker( assets[0]->id, assets[1]->id );
+        if( ticker )
         {
-            result.latest = trades[0].price;
+            const int base_precision = assets[0]->precision;
+            const int quote_precision = assets[1]->precision;
+            auto to_real = [&]( share_type a, int p ) { return double( a.value ) / pow( 10, p ); };
+            auto price_to_real = [&]( share_type ticker_base, share_type ticker_quote ) -> double
+            {
+               if( ticker->base == assets[0]->id )
+                  return to_real( ticker_base, base_precision ) / to_real( ticker_quote, quote_precision );
+               return to_real( ticker_quote, base_precision ) / to_real( ticker_base, quote_precision );
+            };
 
-            while( !trades.empty() )
+            result.latest = price_to_real( ticker->latest_base, ticker->latest_quote );
+            if( !ticker->slots.empty() )
             {
-                for( const market_trade& t: trades )
+                if( ticker->open_base != 0 && ticker->open_quote != 0 )
+                    result.percent_change = ( ( result.latest / price_to_real( ticker->open_base, ticker->open_quote ) ) - 1 ) * 100;
+                if( ticker->base == assets[0]->id )
                 {
-                    result.base_volume += t.value;
-                    result.quote_volume += t.amount;
+                    result.base_volume = to_real( ticker->base_volume, base_precision );
+                    result.quote_volume = to_real( ticker->quote_volume, quote_precision );
+                }
+                else
+                {
+                    result.base_volume = to_real( ticker->quote_volume, base_precision );
+                    result.quote_volume = to_real( ticker->base_volume, quote_precision );
                 }
-
-                trades = get_trade_history( base, quote, trades.back().date, yesterday, batch_size );
-            }
-
-            const auto last_trade_yesterday = get_trade_history( base, quote, yesterday, fc::time_point_sec(), 1 );
-            if( !last_trade_yesterday.empty() )
-            {
-                const auto price_yesterday = last_trade_yesterday[0].price;
-                result.percent_change = ( (result.latest / price_yesterday) - 1 ) * 100;
             }
         }
-        else
-        {
-            const auto last_trade = get_trade_history( base, quote, now, fc::time_point_sec(), 1 );
-            if( !last_trade.empty() )
-                result.latest = last_trade[0].price;
-        }
 
         const auto orders = get_order_book( base, quote, 1 );
         if( !orders.asks.empty() ) result.lowest_ask = orders.asks[0].price;
@@ -1460,17 +1509,35 @@ market_volume database_api::get_24_volume( const string& base, const string& quo
 
 market_volume database_api_impl::get_24_volume( const string& base, const string& quote )const
 {
-    const auto ticker = get_ticker( base, quote );
+    const auto assets = lookup_asset_symbols( {base, quote} );
+    FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
+    FC_ASSERT( assets[1], "Invalid quote asset symbol: ${s}", ("s",quote) );
 
     market_volume result;
-    result.base = ticker.base;
-    result.quote = ticker.quote;
-    result.base_volume = ticker.base_volume;
-    result.quote_volume = ticker.quote_volume;
+    result.base = base;
+    result.quote = quote;
+    result.base_volume = 0;
+    result.quote_volume = 0;
+
+    const market_ticker_object* ticker = find_market_ticker( assets[0]->id, assets[1]->id );
+    if( ticker && !ticker->slots.empty() )
+    {
+        const bool same_order = ticker->base == assets[0]->id;
+        result.base_volume = double( ( same_order ? ticker->base_volume : ticker->quote_volume ).value ) / pow( 10, assets[0]->precision );
+        result.quote_volume = double( ( same_order ? ticker->quote_volume : ticker->base_volume ).value ) / pow( 10, assets[1]->precision );
+    }
 
     return result;
 }
 
+const market_ticker_object* database_api_impl::find_market_ticker( asset_id_type a, asset_id_type b )const
+{
+    if( a > b ) std::swap( a, b );
+    const auto& ticker_idx = _db.get_index_type<graphene::market_history::market_ticker_index>().indices().get<graphene::market_history::by_market>();
+    auto itr = ticker_idx.find( boost::make_tuple( a, b ) );
+    return itr != ticker_idx.end() ? &*itr : nullptr;
+}
+
 order_book database_api::get_order_book( const string& base, const string& quote, unsigned limit )const
 {
    return my->get_order_book( base, quote, limit);
@@ -1821,6 +1888,23 @@ vector<variant> database_api_impl::lookup_vote_ids( const vector<vote_id_type>&
    return result;
 }
 
+vector<uint64_t> database_api::get_provisional_vote_totals( const vector<vote_id_type>& votes )const
+{
+   return my->get_provisional_vote_totals( votes );
+}
+
+vector<uint64_t> database_api_impl::get_provisional_vote_totals( const vector<vote_id_type>& votes )const
+{
+   FC_ASSERT( votes.size() < 1000, "Only 1000 votes can be queried at a time" );
+
+   const vote_totals& totals = _db.get_vote_totals();
+   vector<uint64_t> result;
+   result.reserve( votes.size() );
+   for( auto id : votes )
+      result.push_back( totals.votes( id ) );
+   return result;
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Authority / validation                                           //
@@ -2210,7 +2294,7 @@ void database_api_impl::broadcast_updates( const vector<variant>& updates )
 {
    if( updates.size() && _subscribe_callback ) {
       auto capture_this = shared_from_this();
-      fc::async([capture_this,updates](){
+      _api_thread.async([capture_this,updates](){
           if(capture_this->_subscribe_callback)
             capture_this->_subscribe_callback( fc::variant(updates) );
       });
@@ -2222,7 +2306,7 @@ void database_api_impl::broadcast_market_updates( const market_queue_type& queue
    if( queue.size() )
    {
       auto capture_this = shared_from_this();
-      fc::async([capture_this, this, queue](){
+      _api_thread.async([capture_this, this, queue](){
           for( const auto& item : queue )
           {
             auto sub = _market_subscriptions.find(item.first);
@@ -2233,52 +2317,40 @@ void database_api_impl::broadcast_market_updates( const market_queue_type& queue
    }
 }
 
-void database_api_impl::on_objects_removed( const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts)
+void database_api_impl::on_objects_changed(const object_changes& changes)
 {
-   handle_object_changed(_notify_remove_create, false, ids, impacted_accounts,
-      [objs](object_id_type id) -> const object* {
-         auto it = std::find_if(
-               objs.begin(), objs.end(),
-               [id](const object* o) {return o != nullptr && o->id == id;});
-
-         if (it != objs.end())
-            return *it;
-
-         return nullptr;
-      }
-   );
-}
-
-void database_api_impl::on_objects_new(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts)
-{
-   handle_object_changed(_notify_remove_create, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
-}
-
-void database_api_impl::on_objects_changed(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts)
-{
-   handle_object_changed(false, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
+   switch( changes.type )
+   {
+      case object_changes::new_objects:
+         handle_object_changed(_notify_remove_create, true, changes);
+         break;
+      case object_changes::changed_objects:
+         handle_object_changed(false, true, changes);
+         break;
+      case object_changes::removed_objects:
+         handle_object_changed(_notify_remove_create, false, changes);
+         break;
+   }
 }
 
-void database_api_impl::handle_object_changed(bool force_notify, bool full_object, const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts, std::function<const object*(object_id_type id)> find_object)
+void database_api_impl::handle_object_changed(bool force_notify, bool full_object, const object_changes& changes)
 {
    if( _subscribe_callback )
    {
       vector<variant> updates;
+      const bool impacted = force_notify || is_impacted_account(changes.impacted_accounts);
 
-      for(auto id : ids)
+      for( size_t i = 0; i < changes.ids.size(); ++i )
       {
-         if( force_notify || is_subscribed_to_item(id) || is_impacted_account(impacted_accounts) )
+         const object_id_type id = changes.ids[i];
+         if( impacted || is_subscribed_to_item(id) )
          {
             if( full_object )
             {
-               auto obj = find_object(id);
+               const variant* obj = changes.get_variant(i);
                if( obj )
                {
-                  updates.emplace_back( obj->to_variant() );
+                  updates.emplace_back( *obj );
                }
             }
             else
@@ -2301,15 +2373,16 @@ void database_api_impl::handle_object_changed(bool force_notify, bool full_objec
    //if( _subscribe_callback ) 
    //         _subscribe_callback( updates );
 
-      for(auto id : ids)
+      for( size_t i = 0; i < changes.ids.size(); ++i )
       {
+         const object_id_type id = changes.ids[i];
          if( id.is<call_order_object>() )
          {
-            enqueue_if_subscribed_to_market<call_order_object>( find_object(id), broadcast_queue, full_object );
+            enqueue_if_subscribed_to_market<call_order_object>( changes, i, broadcast_queue, full_object );
          }
          else if( id.is<limit_order_object>() )
          {
-            enqueue_if_subscribed_to_market<limit_order_object>( find_object(id), broadcast_queue, full_object );
+            enqueue_if_subscribed_to_market<limit_order_object>( changes, i, broadcast_queue, full_object );
          }
       }
 
@@ -2326,7 +2399,7 @@ void database_api_impl::on_applied_block()
    {
       auto capture_this = shared_from_this();
       block_id_type block_id = _db.head_block_id();
-      fc::async([this,capture_this,block_id](){
+      _api_thread.async([this,capture_this,block_id](){
          _block_applied_callback(fc::variant(block_id));
       });
    }
@@ -2363,7 +2436,7 @@ void database_api_impl::on_applied_block()
    }
    /// we need to ensure the database_api is not deleted for the life of the async operation
    auto capture_this = shared_from_this();
-   fc::async([this,capture_this,subscribed_markets_ops](){
+   _api_thread.async([this,capture_this,subscribed_markets_ops](){
       for(auto item : subscribed_markets_ops)
       {
          auto itr = _market_subscriptions.find(item.first);
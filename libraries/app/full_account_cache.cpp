@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/full_account_cache.hpp>
+
+#include <fc/thread/scoped_lock.hpp>
+
+namespace graphene { namespace app {
+
+full_account_cache::full_account_cache( graphene::chain::database& db, uint32_t max_size )
+   : _db( db ), _max_size( max_size )
+{
+   _new_connection = db.new_objects.connect( [this]( const vector<object_id_type>&,
+                                                     const impacted_account_set& impacted_accounts ) {
+      on_objects_changed( impacted_accounts );
+   });
+   _change_connection = db.changed_objects.connect( [this]( const vector<object_id_type>& ids,
+                                                           const impacted_account_set& impacted_accounts ) {
+      on_objects_changed( impacted_accounts, &ids );
+   });
+   _removed_connection = db.removed_objects.connect( [this]( const vector<object_id_type>&, const vector<const object*>&,
+                                                            const impacted_account_set& impacted_accounts ) {
+      on_objects_changed( impacted_accounts );
+   });
+   _pending_connection = db.pending_objects_changed.connect( [this]( const impacted_account_set& impacted_accounts ) {
+      on_objects_changed( impacted_accounts );
+   });
+}
+
+void full_account_cache::on_objects_changed( const impacted_account_set& impacted_accounts,
+                                             const vector<object_id_type>* changed_ids )
+{
+   {
+      fc::scoped_lock<fc::mutex> lock( _mutex );
+      if( _entries.empty() )
+         return;
+   }
+   invalidate( impacted_accounts.get() );
+
+   // only the accounts of the old values are reported for changed objects, while an object may have moved
+   // to another account, e.g. an asset to its new issuer
+   if( changed_ids != nullptr )
+   {
+      vector<const object*> new_values;
+      new_values.reserve( changed_ids->size() );
+      for( const auto& id : *changed_ids )
+         new_values.push_back( _db.find_object( id ) );
+      invalidate( impacted_account_set( std::move( new_values ) ).get() );
+   }
+}
+
+std::shared_ptr<const full_account> full_account_cache::find( account_id_type account )const
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   const auto& idx = _entries.get<by_account>();
+   auto itr = idx.find( account );
+   if( itr == idx.end() )
+   {
+      ++_misses;
+      return std::shared_ptr<const full_account>();
+   }
+   ++_hits;
+   _entries.relocate( _entries.begin(), _entries.project<0>( itr ) );
+   return itr->result;
+}
+
+void full_account_cache::insert( std::shared_ptr<const full_account> acnt )
+{
+   entry e;
+   e.account = acnt->account.id;
+   e.result  = std::move( acnt );
+
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   if( _max_size == 0 )
+      return;
+   auto& idx = _entries.get<by_account>();
+   auto itr = idx.find( e.account );
+   if( itr != idx.end() )
+   {
+      idx.replace( itr, e );
+      _entries.relocate( _entries.begin(), _entries.project<0>( itr ) );
+      return;
+   }
+   shrink_to( _max_size - 1 );
+   _entries.push_front( e );
+}
+
+void full_account_cache::invalidate( const flat_set<account_id_type>& accounts )
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   auto& idx = _entries.get<by_account>();
+   for( const auto& account : accounts )
+      _invalidations += idx.erase( account );
+}
+
+void full_account_cache::clear()
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   _entries.clear();
+}
+
+full_account_cache::stats full_account_cache::get_stats()const
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   stats result;
+   result.hits          = _hits;
+   result.misses        = _misses;
+   result.invalidations = _invalidations;
+   result.size          = _entries.size();
+   result.max_size      = _max_size;
+   return result;
+}
+
+uint32_t full_account_cache::max_size()const
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   return _max_size;
+}
+
+void full_account_cache::set_max_size( uint32_t max_size )
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   _max_size = max_size;
+   shrink_to( _max_size );
+}
+
+void full_account_cache::shrink_to( uint32_t max_size )
+{
+   while( _entries.size() > max_size )
+      _entries.pop_back();
+}
+
+} } // graphene::app
@@ -281,6 +281,22 @@ namespace graphene { namespace app {
           */
          void unsubscribe_from_pending_transactions();
 
+         /**
+          * @brief Return the time spent in each operation type and each step of applying a block
+          *        since profiling was enabled or last reset
+          */
+         graphene::chain::execution_profile get_execution_profile() const;
+
+         /**
+          * @brief Start or stop timing operations and block steps, starting clears the previous profile
+          */
+         void set_execution_profiling(bool enabled);
+
+         /**
+          * @brief Clear the execution profile
+          */
+         void reset_execution_profile();
+
       private:
          application& _app;
          map<transaction_id_type, signed_transaction> _pending_transactions;
@@ -437,6 +453,9 @@ FC_API(graphene::app::network_node_api,
        (list_pending_transactions)
        (subscribe_to_pending_transactions)
        (unsubscribe_from_pending_transactions)
+       (get_execution_profile)
+       (set_execution_profiling)
+       (reset_execution_profile)
      )
 FC_API(graphene::app::crypto_api,
        (blind)
@@ -34,6 +34,8 @@ namespace graphene { namespace app {
    using std::string;
 
    class abstract_plugin;
+   class object_change_set;
+   class full_account_cache;
 
    class application
    {
@@ -79,6 +81,10 @@ namespace graphene { namespace app {
 
          net::node_ptr                    p2p_node();
          std::shared_ptr<chain::database> chain_database()const;
+         /// Object notifications of the chain database, shared by the database_api of every connection
+         std::shared_ptr<object_change_set> chain_object_changes()const;
+         /// Results of get_full_accounts, shared by the database_api of every connection
+         std::shared_ptr<full_account_cache> chain_full_accounts()const;
 
          void set_block_production(bool producing_blocks);
          fc::optional< api_access_info > get_api_access_info( const string& username )const;
@@ -50,6 +50,9 @@
 
 #include <graphene/market_history/market_history_plugin.hpp>
 
+#include <graphene/app/object_change_set.hpp>
+#include <graphene/app/full_account_cache.hpp>
+
 #include <fc/api.hpp>
 #include <fc/optional.hpp>
 #include <fc/variant_object.hpp>
@@ -125,6 +128,11 @@ class database_api
 {
    public:
       database_api(graphene::chain::database& db);
+      /// Shares the object notifications of db with every other database_api created with the same changes
+      database_api(graphene::chain::database& db, std::shared_ptr<object_change_set> changes);
+      /// Also shares the results of get_full_accounts through accounts, which may be null
+      database_api(graphene::chain::database& db, std::shared_ptr<object_change_set> changes,
+                   std::shared_ptr<full_account_cache> accounts);
       ~database_api();
 
       /////////////
@@ -192,6 +200,16 @@ class database_api
        */
       optional<signed_transaction> get_recent_transaction_by_id( const transaction_id_type& id )const;
 
+      /**
+       * @brief Retrieve hit and miss counts and the size of the cache of recent blocks
+       */
+      block_cache::stats get_block_cache_stats()const;
+
+      /**
+       * @brief Retrieve hit, miss and invalidation counts and the size of the cache of get_full_accounts results
+       */
+      full_account_cache::stats get_full_account_cache_stats()const;
+
       /**
        * TODO
        * 
@@ -591,6 +609,17 @@ class database_api
        */
       vector<variant> lookup_vote_ids( const vector<vote_id_type>& votes )const;
 
+      /**
+       *  @brief Get the stake currently voting for each of the given vote ids.
+       *
+       *  These totals are kept up to date with every block and pending transaction.  The standings
+       *  only take effect at the next maintenance interval, which counts the votes again and may differ
+       *  if non-member votes are not counted.
+       *
+       *  The results will be in the same order as the votes.
+       */
+      vector<uint64_t> get_provisional_vote_totals( const vector<vote_id_type>& votes )const;
+
       ////////////////////////////
       // Authority / validation //
       ////////////////////////////
@@ -701,6 +730,8 @@ FC_API(graphene::app::database_api,
    (get_block)
    (get_transaction)
    (get_recent_transaction_by_id)
+   (get_block_cache_stats)
+   (get_full_account_cache_stats)
 
    // Globals
    (get_chain_properties)
@@ -778,6 +809,7 @@ FC_API(graphene::app::database_api,
    (get_workers_by_account)
    // Votes
    (lookup_vote_ids)
+   (get_provisional_vote_totals)
 
    // Authority / validation
    (get_transaction_hex)
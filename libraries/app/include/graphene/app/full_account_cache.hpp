@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/full_account.hpp>
+#include <graphene/chain/database.hpp>
+
+#include <fc/thread/mutex.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/signals2/signal.hpp>
+
+#include <memory>
+
+namespace graphene { namespace app {
+   using boost::multi_index_container;
+   using namespace boost::multi_index;
+
+   /**
+    * @brief keeps recent get_full_accounts results, one per account
+    *
+    * Wallets poll get_full_accounts for the same few accounts over and over, while most blocks touch none
+    * of them.  An entry is dropped whenever the chain database reports a change of an object that impacts
+    * its account, whether by a block, a pending transaction or an undone block or pending state.
+    *
+    * The votes of an account are not cached, they belong to witnesses and committee members and change
+    * without impacting the account, see database_api::get_full_accounts.  The least recently used entry
+    * is dropped when the cache is full.  Every method is thread safe.
+    */
+   class full_account_cache
+   {
+      public:
+         struct stats
+         {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t invalidations = 0;
+            uint32_t size = 0;
+            uint32_t max_size = 0;
+         };
+
+         full_account_cache( graphene::chain::database& db, uint32_t max_size = 1000 );
+
+         /// @return the cached result for account, null on a miss
+         std::shared_ptr<const full_account> find( account_id_type account )const;
+         void insert( std::shared_ptr<const full_account> acnt );
+         /// Drops the entries of the given accounts
+         void invalidate( const flat_set<account_id_type>& accounts );
+         void clear();
+
+         stats    get_stats()const;
+         uint32_t max_size()const;
+         void     set_max_size( uint32_t max_size );
+
+      private:
+         struct entry
+         {
+            account_id_type                      account;
+            std::shared_ptr<const full_account>  result;
+         };
+
+         struct by_account;
+         typedef multi_index_container<
+            entry,
+            indexed_by<
+               sequenced<>,
+               hashed_unique< tag<by_account>, member< entry, account_id_type, &entry::account >, std::hash<object_id_type> >
+            >
+         > entry_index_type;
+
+         /// changed_ids are the ids of changed objects, whose new values impact accounts too
+         void on_objects_changed( const impacted_account_set& impacted_accounts,
+                                  const vector<object_id_type>* changed_ids = nullptr );
+         void shrink_to( uint32_t max_size );
+
+         graphene::chain::database& _db;
+         mutable fc::mutex        _mutex;
+         mutable entry_index_type _entries;
+         uint32_t                 _max_size;
+         mutable uint64_t         _hits = 0;
+         mutable uint64_t         _misses = 0;
+         uint64_t                 _invalidations = 0;
+
+         boost::signals2::scoped_connection _new_connection;
+         boost::signals2::scoped_connection _change_connection;
+         boost::signals2::scoped_connection _removed_connection;
+         boost::signals2::scoped_connection _pending_connection;
+   };
+
+} } // graphene::app
+
+FC_REFLECT( graphene::app::full_account_cache::stats, (hits)(misses)(invalidations)(size)(max_size) )
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <boost/signals2/signal.hpp>
+
+namespace graphene { namespace app {
+   using namespace graphene::chain;
+
+   /**
+    * The objects reported by one new_objects, changed_objects or removed_objects notification of the chain
+    * database.  An object is converted to a variant the first time a subscriber asks for it and every other
+    * subscriber shares that variant, so the work scales with the changed objects and not with the subscribers.
+    *
+    * Only valid for the duration of object_change_set::applied.
+    */
+   class object_changes
+   {
+      public:
+         enum change_type
+         {
+            new_objects,
+            changed_objects,
+            removed_objects
+         };
+
+         object_changes( change_type type, const vector<object_id_type>& ids, vector<const object*>&& objects,
+                         const impacted_account_set& impacted_accounts );
+
+         const change_type                  type;
+         const vector<object_id_type>&      ids;
+         /// computed on the first call
+         const impacted_account_set&        impacted_accounts;
+
+         /// @return the object with ids[i], null if it does not exist anymore
+         const object*  get_object( size_t i )const { return _objects[i]; }
+         /// @return the object with ids[i] as a variant, null if it does not exist anymore
+         const variant* get_variant( size_t i )const;
+         /// @return how many objects have been converted to variants so far
+         size_t conversions()const { return _conversions; }
+
+      private:
+         vector<const object*>    _objects;
+         mutable vector<variant>  _variants;
+         mutable vector<bool>     _converted;
+         mutable size_t           _conversions = 0;
+   };
+
+   /**
+    * Listens to the object notifications of the chain database on behalf of all database_api instances and
+    * hands each of them the same object_changes.
+    */
+   class object_change_set
+   {
+      public:
+         object_change_set( graphene::chain::database& db );
+
+         /// Emitted for every notification of the chain database, only while there are subscribers
+         boost::signals2::signal<void(const object_changes&)> applied;
+
+      private:
+         graphene::chain::database&         _db;
+         boost::signals2::scoped_connection _new_connection;
+         boost::signals2::scoped_connection _change_connection;
+         boost::signals2::scoped_connection _removed_connection;
+   };
+
+} } // graphene::app
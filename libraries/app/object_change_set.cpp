@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/object_change_set.hpp>
+
+namespace graphene { namespace app {
+
+object_changes::object_changes( change_type t, const vector<object_id_type>& i, vector<const object*>&& objects,
+                                const impacted_account_set& accounts )
+   : type( t ), ids( i ), impacted_accounts( accounts ), _objects( std::move( objects ) ),
+     _variants( _objects.size() ), _converted( _objects.size(), false )
+{
+   FC_ASSERT( _objects.size() == ids.size() );
+}
+
+const variant* object_changes::get_variant( size_t i )const
+{
+   if( _objects[i] == nullptr )
+      return nullptr;
+   if( !_converted[i] )
+   {
+      _variants[i] = _objects[i]->to_variant();
+      _converted[i] = true;
+      ++_conversions;
+   }
+   return &_variants[i];
+}
+
+object_change_set::object_change_set( graphene::chain::database& db ) : _db( db )
+{
+   auto find_objects = [this]( const vector<object_id_type>& ids ) -> vector<const object*>
+   {
+      vector<const object*> objects;
+      objects.reserve( ids.size() );
+      for( const auto& id : ids )
+         objects.push_back( _db.find_object( id ) );
+      return objects;
+   };
+
+   _new_connection = _db.new_objects.connect( [this,find_objects]( const vector<object_id_type>& ids,
+                                                                   const impacted_account_set& impacted_accounts ) {
+      if( !applied.empty() )
+         applied( object_changes( object_changes::new_objects, ids, find_objects( ids ), impacted_accounts ) );
+   });
+   _change_connection = _db.changed_objects.connect( [this,find_objects]( const vector<object_id_type>& ids,
+                                                                         const impacted_account_set& impacted_accounts ) {
+      if( !applied.empty() )
+         applied( object_changes( object_changes::changed_objects, ids, find_objects( ids ), impacted_accounts ) );
+   });
+   _removed_connection = _db.removed_objects.connect( [this]( const vector<object_id_type>& ids, const vector<const object*>& objs,
+                                                             const impacted_account_set& impacted_accounts ) {
+      if( !applied.empty() )
+         applied( object_changes( object_changes::removed_objects, ids, vector<const object*>( objs ), impacted_accounts ) );
+   });
+}
+
+} } // graphene::app
@@ -26,6 +26,7 @@
 
 #include <fc/uint128.hpp>
 
+#include <algorithm>
 #include <cmath>
 
 using namespace graphene::chain;
@@ -166,14 +167,57 @@ string asset_object::amount_to_string(share_type amount) const
 }
 
 
+namespace {
+
+   /**
+    * The tickets of a lottery, numbered in the order of get_holders(): the holders by decreasing
+    * balance, each holding as many consecutive numbers as it has tickets.  Keeps one entry per
+    * holder instead of one per ticket.
+    */
+   class lottery_tickets
+   {
+      public:
+         lottery_tickets( const database& db, asset_id_type lottery )
+         {
+            const auto& asset_bal_idx = db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
+            const auto range = asset_bal_idx.equal_range( boost::make_tuple( lottery ) );
+            for( const account_balance_object& bal : boost::make_iterator_range( range.first, range.second ) )
+            {
+               if( bal.balance.value <= 0 )
+                  continue;
+               _count += bal.balance.value;
+               _ends.emplace_back( _count, bal.owner );
+            }
+         }
+
+         /// @return the number of tickets
+         uint64_t size()const { return _count; }
+
+         /// @return the holder of ticket number n < size()
+         account_id_type holder( uint64_t n )const
+         {
+            auto itr = std::upper_bound( _ends.begin(), _ends.end(), n,
+               []( uint64_t n, const std::pair<uint64_t, account_id_type>& e ) { return n < e.first; } );
+            FC_ASSERT( itr != _ends.end() );
+            return itr->second;
+         }
+
+         /// (number after the last ticket, holder) of each holder
+         const vector< std::pair<uint64_t, account_id_type> >& holders()const { return _ends; }
+
+      private:
+         uint64_t                                       _count = 0;
+         vector< std::pair<uint64_t, account_id_type> > _ends;
+   };
+
+} // anonymous namespace
+
 vector<account_id_type> asset_object::get_holders( database& db ) const
 {
    auto& asset_bal_idx = db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
    
-   uint64_t max_supply = get_id()(db).options.max_supply.value;
-   
    vector<account_id_type> holders; // repeating if balance > 1
-   holders.reserve(max_supply);
+   holders.reserve( dynamic_data(db).current_supply.value );
    const auto range = asset_bal_idx.equal_range( boost::make_tuple( get_id() ) );
    for( const account_balance_object& bal : boost::make_iterator_range( range.first, range.second ) )
       for( uint64_t balance = bal.balance.value; balance > 0; --balance)
@@ -201,14 +245,11 @@ map< account_id_type, vector< uint16_t > > asset_object::distribute_winners_part
 {
    transaction_evaluation_state eval( &db );
       
-   auto holders = get_holders( db );
+   const lottery_tickets holders( db, get_id() );
    FC_ASSERT( dynamic_data( db ).current_supply == holders.size() );
    map<account_id_type, vector<uint16_t> > structurized_participants;
-   for( account_id_type holder : holders )
-   {
-      if( !structurized_participants.count( holder ) )
-         structurized_participants.emplace( holder, vector< uint16_t >() );
-   }
+   for( const auto& holder : holders.holders() )
+      structurized_participants.emplace( holder.second, vector< uint16_t >() );
    uint64_t jackpot = get_id()( db ).dynamic_data( db ).current_supply.value * lottery_options->ticket_price.amount.value;
    auto winner_numbers = db.get_winner_numbers( get_id(), holders.size(), lottery_options->winning_tickets.size() );
    
@@ -229,12 +270,12 @@ map< account_id_type, vector< uint16_t > > asset_object::distribute_winners_part
       lottery_reward_operation reward_op;
       reward_op.lottery = get_id();
       reward_op.is_benefactor_reward = false;
-      reward_op.winner = holders[winner_num];
+      reward_op.winner = holders.holder( winner_num );
       reward_op.win_percentage = tickets[c];
       reward_op.amount = asset( jackpot * tickets[c] * ( 1. - sweeps_distribution_percentage / (double)GRAPHENE_100_PERCENT ) / GRAPHENE_100_PERCENT , db.get_balance(id).asset_id );
       db.apply_operation(eval, reward_op);
       
-      structurized_participants[ holders[ winner_num ] ].push_back( tickets[c] );
+      structurized_participants[ reward_op.winner ].push_back( tickets[c] );
    }
    return structurized_participants;
 }
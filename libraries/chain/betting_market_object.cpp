@@ -140,6 +140,78 @@ share_type betting_market_position_object::reduce()
    return immediate_winnings;
 }
 
+bet_price_level_index::bet_level bet_price_level_index::level_of(const bet_object& bet)
+{
+   bet_level result;
+   result.key = level_key{bet.betting_market_id, bet.back_or_lay, bet.backer_multiplier};
+   result.amount_to_bet = bet.amount_to_bet.amount;
+   result.delayed = bet.end_of_delay.valid();
+   return result;
+}
+
+void bet_price_level_index::adjust(const bet_level& bet, bool add)
+{
+   if (bet.delayed)
+      return;
+   if (add)
+   {
+      price_level& level = _levels[bet.key];
+      level.amount_to_bet += bet.amount_to_bet;
+      ++level.bet_count;
+   }
+   else
+   {
+      auto itr = _levels.find(bet.key);
+      assert(itr != _levels.end());
+      if (itr == _levels.end())
+         return;
+      if (--itr->second.bet_count == 0)
+         _levels.erase(itr);
+      else
+         itr->second.amount_to_bet -= bet.amount_to_bet;
+   }
+}
+
+void bet_price_level_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const bet_object*>(&obj) );
+   adjust(level_of(static_cast<const bet_object&>(obj)), true);
+}
+
+void bet_price_level_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const bet_object*>(&obj) );
+   adjust(level_of(static_cast<const bet_object&>(obj)), false);
+}
+
+void bet_price_level_index::about_to_modify( const object& before )
+{
+   assert( dynamic_cast<const bet_object*>(&before) );
+   _before = level_of(static_cast<const bet_object&>(before));
+}
+
+void bet_price_level_index::object_modified( const object& after )
+{
+   assert( dynamic_cast<const bet_object*>(&after) );
+   const bet_level now = level_of(static_cast<const bet_object&>(after));
+   adjust(_before, false);
+   adjust(now, true);
+}
+
+bet_price_level_index::level_range bet_price_level_index::get_levels(betting_market_id_type betting_market_id) const
+{
+   return level_range(_levels.lower_bound(level_key{betting_market_id, bet_type::back, 0}),
+                      _levels.upper_bound(level_key{betting_market_id, bet_type::lay, 0}));
+}
+
+bet_price_level_index::level_range bet_price_level_index::get_levels(betting_market_id_type betting_market_id, bet_type back_or_lay) const
+{
+   const bet_multiplier_type best = back_or_lay == bet_type::back ? 0 : std::numeric_limits<bet_multiplier_type>::max();
+   const bet_multiplier_type worst = back_or_lay == bet_type::back ? std::numeric_limits<bet_multiplier_type>::max() : 0;
+   return level_range(_levels.lower_bound(level_key{betting_market_id, back_or_lay, best}),
+                      _levels.upper_bound(level_key{betting_market_id, back_or_lay, worst}));
+}
+
 // betting market object implementation
 namespace 
 {
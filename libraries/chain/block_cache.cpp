@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/block_cache.hpp>
+
+#include <fc/thread/scoped_lock.hpp>
+
+namespace graphene { namespace chain {
+
+optional<block_cache::entry> block_cache::find( const block_id_type& id )const
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   return find_locked( block_header::num_from_id( id ), &id );
+}
+
+optional<block_cache::entry> block_cache::find( uint32_t num )const
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   return find_locked( num, nullptr );
+}
+
+optional<block_cache::entry> block_cache::find_locked( uint32_t num, const block_id_type* id )const
+{
+   const auto& idx = _entries.get<by_num>();
+   auto itr = idx.find( num );
+   if( itr == idx.end() || ( id != nullptr && itr->block_id != *id ) )
+   {
+      ++_misses;
+      return optional<entry>();
+   }
+   ++_hits;
+   _entries.relocate( _entries.begin(), _entries.project<0>( itr ) );
+   return *itr;
+}
+
+void block_cache::insert( const block_id_type& id, std::shared_ptr<const signed_block> block,
+                          std::shared_ptr<const vector<char>> packed )
+{
+   if( _max_size == 0 )
+      return;
+   entry e;
+   e.block_num = block_header::num_from_id( id );
+   e.block_id  = id;
+   e.block     = std::move( block );
+   e.packed    = std::move( packed );
+
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   auto& idx = _entries.get<by_num>();
+   auto itr = idx.find( e.block_num );
+   if( itr != idx.end() )
+   {
+      idx.replace( itr, e );
+      _entries.relocate( _entries.begin(), _entries.project<0>( itr ) );
+      return;
+   }
+   shrink_to( _max_size - 1 );
+   _entries.push_front( e );
+}
+
+void block_cache::remove( const block_id_type& id )
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   auto& idx = _entries.get<by_num>();
+   auto itr = idx.find( block_header::num_from_id( id ) );
+   if( itr != idx.end() && itr->block_id == id )
+      idx.erase( itr );
+}
+
+void block_cache::clear()
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   _entries.clear();
+}
+
+block_cache::stats block_cache::get_stats()const
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   stats result;
+   result.hits     = _hits;
+   result.misses   = _misses;
+   result.size     = _entries.size();
+   result.max_size = _max_size;
+   return result;
+}
+
+void block_cache::set_max_size( uint32_t max_size )
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   _max_size = max_size;
+   shrink_to( _max_size );
+}
+
+void block_cache::shrink_to( uint32_t max_size )
+{
+   while( _entries.size() > max_size )
+      _entries.pop_back();
+}
+
+} } // graphene::chain
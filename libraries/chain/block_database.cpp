@@ -25,6 +25,24 @@
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/smart_ref_impl.hpp>
+#include <fc/thread/mutex.hpp>
+#include <fc/thread/scoped_lock.hpp>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <thread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace graphene { namespace chain {
 
@@ -39,7 +57,206 @@ FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
 
 namespace graphene { namespace chain {
 
-void block_database::open( const fc::path& dbdir )
+namespace detail {
+
+class block_database_impl
+{
+   public:
+      virtual ~block_database_impl() {}
+
+      virtual void open( const fc::path& dbdir ) = 0;
+      virtual bool is_open()const = 0;
+      virtual void flush() = 0;
+      virtual void close() = 0;
+
+      virtual void store( const block_id_type& id, const vector<char>& packed_block ) = 0;
+      virtual void remove( const block_id_type& id ) = 0;
+
+      virtual bool                   contains( const block_id_type& id )const = 0;
+      virtual block_id_type          fetch_block_id( uint32_t block_num )const = 0;
+      virtual optional<signed_block> fetch_optional( const block_id_type& id )const = 0;
+      virtual optional<signed_block> fetch_by_number( uint32_t block_num )const = 0;
+      virtual optional<signed_block> last()const = 0;
+      virtual optional<block_id_type> last_id()const = 0;
+
+      /// Block numbers below this one have been pruned
+      virtual uint32_t first_retained_block_num()const { return 1; }
+};
+
+/**
+ * The original backend: every access seeks one of two shared std::fstreams.
+ */
+class stream_block_database : public block_database_impl
+{
+   public:
+      virtual void open( const fc::path& dbdir )override;
+      virtual bool is_open()const override;
+      virtual void flush()override;
+      virtual void close()override;
+
+      virtual void store( const block_id_type& id, const vector<char>& packed_block )override;
+      virtual void remove( const block_id_type& id )override;
+
+      virtual bool                   contains( const block_id_type& id )const override;
+      virtual block_id_type          fetch_block_id( uint32_t block_num )const override;
+      virtual optional<signed_block> fetch_optional( const block_id_type& id )const override;
+      virtual optional<signed_block> fetch_by_number( uint32_t block_num )const override;
+      virtual optional<signed_block> last()const override;
+      virtual optional<block_id_type> last_id()const override;
+   private:
+      mutable std::fstream _blocks;
+      mutable std::fstream _block_num_to_pos;
+};
+
+/**
+ * The index file is memory mapped and blocks are read with pread(), so lookups never touch shared
+ * state other than the published mapping and index size.
+ *
+ * The mapping grows by doubling. Superseded mappings stay mapped until close() so that a reader
+ * still holding an old pointer keeps reading valid (and, being MAP_SHARED, identical) memory.
+ * While the database is open the index file may carry zeroed capacity past the last entry; it is
+ * truncated back on close() and zeroed entries are skipped like removed ones on open().
+ *
+ * An entry is overwritten in place when a fork replaces a block or a block is removed.  Writes are
+ * bracketed by a sequence counter, odd while a write is in progress, and readers copy an entry again
+ * until the counter is even and unchanged around their copy, so they never see a torn entry.
+ *
+ * Only one instance may write to a directory. Other instances see the index as it was when they
+ * opened it.
+ */
+class mapped_block_database : public block_database_impl
+{
+   public:
+      /// @param first_block_num number of the block whose entry is at the start of the index
+      explicit mapped_block_database( uint32_t first_block_num = 0 ) : _first_block_num( first_block_num ) {}
+      virtual ~mapped_block_database() { close(); }
+
+      virtual void open( const fc::path& dbdir )override;
+      virtual bool is_open()const override;
+      virtual void flush()override;
+      virtual void close()override;
+
+      virtual void store( const block_id_type& id, const vector<char>& packed_block )override;
+      virtual void remove( const block_id_type& id )override;
+
+      virtual bool                   contains( const block_id_type& id )const override;
+      virtual block_id_type          fetch_block_id( uint32_t block_num )const override;
+      virtual optional<signed_block> fetch_optional( const block_id_type& id )const override;
+      virtual optional<signed_block> fetch_by_number( uint32_t block_num )const override;
+      virtual optional<signed_block> last()const override;
+      virtual optional<block_id_type> last_id()const override;
+
+      /// @return the lowest block number stored, scanning the index from its start
+      optional<uint32_t>     first_stored_block_num()const;
+   private:
+      uint64_t               index_pos( uint32_t block_num )const;
+      bool                   read_entry( uint64_t index_pos, index_entry& e )const;
+      void                   write_entry( uint64_t index_pos, const index_entry& e );
+      optional<signed_block> read_block( const index_entry& e )const;
+      optional<index_entry>  last_entry()const;
+      void                   reserve_index( uint64_t size );
+
+      const uint32_t                  _first_block_num;
+      int                             _index_fd  = -1;
+      int                             _blocks_fd = -1;
+      std::atomic<char*>              _index_data{ nullptr };
+      std::atomic<uint64_t>           _index_size{ 0 };
+      std::atomic<uint64_t>           _index_seq{ 0 };
+      uint64_t                        _index_capacity = 0;
+      uint64_t                        _blocks_size = 0;
+      bool                            _index_grown = false;
+      vector< std::pair<void*,size_t> > _mappings;
+};
+
+/**
+ * Splits the block log into directories of blocks_per_segment blocks each, every one of them laid
+ * out like a mapped_block_database whose index starts at the segment's first block.  Segments that
+ * only hold blocks older than the retained range are deleted as new segments are started.
+ *
+ * Segments are reference counted, so a reader that looked one up keeps using it even if it is
+ * pruned meanwhile.
+ */
+class segmented_block_database : public block_database_impl
+{
+   public:
+      segmented_block_database( uint32_t blocks_per_segment, uint32_t retain_blocks )
+         : _blocks_per_segment( blocks_per_segment ), _retain_blocks( retain_blocks )
+      {
+         FC_ASSERT( blocks_per_segment > 0 );
+      }
+
+      virtual void open( const fc::path& dbdir )override;
+      virtual bool is_open()const override;
+      virtual void flush()override;
+      virtual void close()override;
+
+      virtual void store( const block_id_type& id, const vector<char>& packed_block )override;
+      virtual void remove( const block_id_type& id )override;
+
+      virtual bool                   contains( const block_id_type& id )const override;
+      virtual block_id_type          fetch_block_id( uint32_t block_num )const override;
+      virtual optional<signed_block> fetch_optional( const block_id_type& id )const override;
+      virtual optional<signed_block> fetch_by_number( uint32_t block_num )const override;
+      virtual optional<signed_block> last()const override;
+      virtual optional<block_id_type> last_id()const override;
+
+      virtual uint32_t first_retained_block_num()const override;
+
+      /// @return true if dbdir holds a segmented block log
+      static bool is_segmented( const fc::path& dbdir );
+
+   private:
+      typedef std::shared_ptr<mapped_block_database> segment_ptr;
+
+      static fc::path segment_dir( const fc::path& dbdir, uint32_t first_block_num );
+
+      segment_ptr find_segment( uint32_t block_num )const;
+      segment_ptr create_segment( uint32_t block_num );
+      void        import_flat_log();
+      void        prune( uint32_t head_block_num );
+      void        update_first_retained_block_num();
+
+      const uint32_t                 _blocks_per_segment;
+      const uint32_t                 _retain_blocks;
+      fc::path                       _dbdir;
+      bool                           _open = false;
+      mutable fc::mutex              _segments_mutex;
+      std::map<uint32_t,segment_ptr> _segments; ///< keyed by the number of the first block of the segment
+      std::atomic<uint32_t>          _first_retained_block_num{ 0 }; ///< 0 while no block is stored
+};
+
+static void pread_all( int fd, char* data, size_t size, uint64_t pos )
+{
+   while( size > 0 )
+   {
+      ssize_t r = ::pread( fd, data, size, pos );
+      if( r < 0 && errno == EINTR )
+         continue;
+      FC_ASSERT( r > 0, "Unable to read block data: ${e}", ("e", r < 0 ? strerror(errno) : "unexpected end of file") );
+      data += r;
+      size -= r;
+      pos += r;
+   }
+}
+
+static void pwrite_all( int fd, const char* data, size_t size, uint64_t pos )
+{
+   while( size > 0 )
+   {
+      ssize_t r = ::pwrite( fd, data, size, pos );
+      if( r < 0 && errno == EINTR )
+         continue;
+      FC_ASSERT( r > 0, "Unable to write block data: ${e}", ("e", strerror(errno)) );
+      data += r;
+      size -= r;
+      pos += r;
+   }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// stream_block_database
+
+void stream_block_database::open( const fc::path& dbdir )
 { try {
    fc::create_directories(dbdir);
    _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
@@ -57,44 +274,37 @@ void block_database::open( const fc::path& dbdir )
    }
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
-bool block_database::is_open()const
+bool stream_block_database::is_open()const
 {
   return _blocks.is_open();
 }
 
-void block_database::close()
+void stream_block_database::close()
 {
   _blocks.close();
   _block_num_to_pos.close();
 }
 
-void block_database::flush()
+void stream_block_database::flush()
 {
   _blocks.flush();
   _block_num_to_pos.flush();
 }
 
-void block_database::store( const block_id_type& _id, const signed_block& b )
+void stream_block_database::store( const block_id_type& id, const vector<char>& packed_block )
 {
-   block_id_type id = _id;
-   if( id == block_id_type() )
-   {
-      id = b.id();
-      elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
-   }
    auto num = block_header::num_from_id(id);
    _block_num_to_pos.seekp( sizeof( index_entry ) * num );
    index_entry e;
    _blocks.seekp( 0, _blocks.end );
-   auto vec = fc::raw::pack( b );
    e.block_pos  = _blocks.tellp();
-   e.block_size = vec.size();
+   e.block_size = packed_block.size();
    e.block_id   = id;
-   _blocks.write( vec.data(), vec.size() );
+   _blocks.write( packed_block.data(), packed_block.size() );
    _block_num_to_pos.write( (char*)&e, sizeof(e) );
 }
 
-void block_database::remove( const block_id_type& id )
+void stream_block_database::remove( const block_id_type& id )
 { try {
    index_entry e;
    auto index_pos = sizeof(e)*block_header::num_from_id(id);
@@ -113,7 +323,7 @@ void block_database::remove( const block_id_type& id )
    }
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
-bool block_database::contains( const block_id_type& id )const
+bool stream_block_database::contains( const block_id_type& id )const
 {
    if( id == block_id_type() )
       return false;
@@ -129,7 +339,7 @@ bool block_database::contains( const block_id_type& id )const
    return e.block_id == id && e.block_size > 0;
 }
 
-block_id_type block_database::fetch_block_id( uint32_t block_num )const
+block_id_type stream_block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
    index_entry e;
@@ -145,7 +355,7 @@ block_id_type block_database::fetch_block_id( uint32_t block_num )const
    return e.block_id;
 }
 
-optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
+optional<signed_block> stream_block_database::fetch_optional( const block_id_type& id )const
 {
    try
    {
@@ -177,7 +387,7 @@ optional<signed_block> block_database::fetch_optional( const block_id_type& id )
    return optional<signed_block>();
 }
 
-optional<signed_block> block_database::fetch_by_number( uint32_t block_num )const
+optional<signed_block> stream_block_database::fetch_by_number( uint32_t block_num )const
 {
    try
    {
@@ -206,7 +416,7 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    return optional<signed_block>();
 }
 
-optional<signed_block> block_database::last()const
+optional<signed_block> stream_block_database::last()const
 {
    try
    {
@@ -244,7 +454,7 @@ optional<signed_block> block_database::last()const
    return optional<signed_block>();
 }
 
-optional<block_id_type> block_database::last_id()const
+optional<block_id_type> stream_block_database::last_id()const
 {
    try
    {
@@ -278,5 +488,664 @@ optional<block_id_type> block_database::last_id()const
    return optional<block_id_type>();
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// mapped_block_database
+
+void mapped_block_database::open( const fc::path& dbdir )
+{ try {
+   FC_ASSERT( !is_open() );
+   fc::create_directories(dbdir);
+
+   int flags = O_RDWR | O_CREAT;
+   if( !fc::exists( dbdir/"index" ) )
+      flags |= O_TRUNC;
+
+   _index_fd = ::open( (dbdir/"index").generic_string().c_str(), flags, 0644 );
+   FC_ASSERT( _index_fd >= 0, "Unable to open block index: ${e}", ("e", strerror(errno)) );
+   _blocks_fd = ::open( (dbdir/"blocks").generic_string().c_str(), flags, 0644 );
+   if( _blocks_fd < 0 )
+   {
+      auto err = errno;
+      close();
+      FC_THROW( "Unable to open blocks: ${e}", ("e", strerror(err)) );
+   }
+
+   struct stat st;
+   FC_ASSERT( ::fstat( _blocks_fd, &st ) == 0 );
+   _blocks_size = st.st_size;
+   FC_ASSERT( ::fstat( _index_fd, &st ) == 0 );
+   uint64_t index_size = st.st_size - st.st_size % sizeof(index_entry);
+
+   if( index_size > 0 )
+   {
+      void* data = ::mmap( nullptr, index_size, PROT_READ | PROT_WRITE, MAP_SHARED, _index_fd, 0 );
+      FC_ASSERT( data != MAP_FAILED, "Unable to map block index: ${e}", ("e", strerror(errno)) );
+      _mappings.emplace_back( data, index_size );
+      _index_data = (char*)data;
+      _index_capacity = index_size;
+   }
+
+   // drop zeroed capacity left behind by an unclean shutdown
+   const index_entry empty_entry = index_entry();
+   while( index_size > 0 && memcmp( _index_data.load() + index_size - sizeof(index_entry), &empty_entry, sizeof(index_entry) ) == 0 )
+      index_size -= sizeof(index_entry);
+   _index_size = index_size;
+} FC_CAPTURE_AND_RETHROW( (dbdir) ) }
+
+bool mapped_block_database::is_open()const
+{
+   return _blocks_fd >= 0;
+}
+
+void mapped_block_database::flush()
+{
+   // writes go straight to the page cache, there is nothing buffered in-process
+}
+
+void mapped_block_database::close()
+{
+   for( const auto& m : _mappings )
+      ::munmap( m.first, m.second );
+   _mappings.clear();
+   _index_data = nullptr;
+   _index_capacity = 0;
+
+   if( _index_fd >= 0 )
+   {
+      if( _index_grown && ::ftruncate( _index_fd, _index_size ) != 0 )
+         elog( "Unable to truncate block index: ${e}", ("e", strerror(errno)) );
+      ::close( _index_fd );
+   }
+   if( _blocks_fd >= 0 )
+      ::close( _blocks_fd );
+
+   _index_fd = -1;
+   _blocks_fd = -1;
+   _index_size = 0;
+   _blocks_size = 0;
+   _index_grown = false;
+}
+
+void mapped_block_database::reserve_index( uint64_t size )
+{
+   if( size <= _index_capacity )
+      return;
+
+   uint64_t capacity = std::max( std::max( _index_capacity * 2, size ), uint64_t(sizeof(index_entry) * 1024 * 64) );
+   FC_ASSERT( ::ftruncate( _index_fd, capacity ) == 0, "Unable to grow block index: ${e}", ("e", strerror(errno)) );
+   _index_grown = true;
+
+   void* data = ::mmap( nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _index_fd, 0 );
+   FC_ASSERT( data != MAP_FAILED, "Unable to map block index: ${e}", ("e", strerror(errno)) );
+   _mappings.emplace_back( data, capacity );
+   _index_data.store( (char*)data, std::memory_order_release );
+   _index_capacity = capacity;
+}
+
+uint64_t mapped_block_database::index_pos( uint32_t block_num )const
+{
+   if( block_num < _first_block_num )
+      return std::numeric_limits<uint64_t>::max();
+   return uint64_t( block_num - _first_block_num ) * sizeof(index_entry);
+}
+
+bool mapped_block_database::read_entry( uint64_t index_pos, index_entry& e )const
+{
+   while( true )
+   {
+      const uint64_t seq = _index_seq.load( std::memory_order_acquire );
+      if( seq & 1 )
+      {
+         std::this_thread::yield();
+         continue;
+      }
+      if( _index_size.load( std::memory_order_acquire ) <= index_pos )
+         return false;
+      memcpy( (char*)&e, _index_data.load( std::memory_order_acquire ) + index_pos, sizeof(e) );
+      std::atomic_thread_fence( std::memory_order_acquire );
+      if( _index_seq.load( std::memory_order_relaxed ) == seq )
+         return true;
+   }
+}
+
+void mapped_block_database::write_entry( uint64_t index_pos, const index_entry& e )
+{
+   reserve_index( index_pos + sizeof(e) );
+   _index_seq.fetch_add( 1, std::memory_order_relaxed );
+   std::atomic_thread_fence( std::memory_order_release );
+   memcpy( _index_data.load( std::memory_order_relaxed ) + index_pos, (const char*)&e, sizeof(e) );
+   if( _index_size.load( std::memory_order_relaxed ) < index_pos + sizeof(e) )
+      _index_size.store( index_pos + sizeof(e), std::memory_order_relaxed );
+   _index_seq.fetch_add( 1, std::memory_order_release );
+}
+
+optional<signed_block> mapped_block_database::read_block( const index_entry& e )const
+{
+   try
+   {
+      vector<char> data( e.block_size );
+      if( e.block_size )
+         pread_all( _blocks_fd, data.data(), e.block_size, e.block_pos );
+      auto result = fc::raw::unpack<signed_block>(data);
+      FC_ASSERT( result.id() == e.block_id );
+      return result;
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return optional<signed_block>();
+}
+
+optional<uint32_t> mapped_block_database::first_stored_block_num()const
+{
+   index_entry e;
+   const uint64_t size = _index_size.load( std::memory_order_acquire );
+   for( uint64_t pos = 0; pos < size; pos += sizeof(index_entry) )
+      if( read_entry( pos, e ) && e.block_size > 0 )
+         return _first_block_num + uint32_t( pos / sizeof(index_entry) );
+   return optional<uint32_t>();
+}
+
+optional<index_entry> mapped_block_database::last_entry()const
+{
+   index_entry e;
+   uint64_t pos = _index_size.load( std::memory_order_acquire );
+   while( pos >= sizeof(index_entry) )
+   {
+      pos -= sizeof(index_entry);
+      if( read_entry( pos, e ) && e.block_size > 0 )
+         return e;
+   }
+   return optional<index_entry>();
+}
+
+void mapped_block_database::store( const block_id_type& id, const vector<char>& packed_block )
+{
+   index_entry e;
+   e.block_pos  = _blocks_size;
+   e.block_size = packed_block.size();
+   e.block_id   = id;
+   auto num = block_header::num_from_id(id);
+   FC_ASSERT( num >= _first_block_num );
+   pwrite_all( _blocks_fd, packed_block.data(), packed_block.size(), e.block_pos );
+   _blocks_size += packed_block.size();
+   write_entry( index_pos( num ), e );
+}
+
+void mapped_block_database::remove( const block_id_type& id )
+{ try {
+   index_entry e;
+   auto pos = index_pos( block_header::num_from_id(id) );
+   if( !read_entry( pos, e ) )
+      FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
+
+   if( e.block_id == id )
+   {
+      e.block_size = 0;
+      write_entry( pos, e );
+   }
+} FC_CAPTURE_AND_RETHROW( (id) ) }
+
+bool mapped_block_database::contains( const block_id_type& id )const
+{
+   if( id == block_id_type() )
+      return false;
+
+   index_entry e;
+   if( !read_entry( index_pos( block_header::num_from_id(id) ), e ) )
+      return false;
+   return e.block_id == id && e.block_size > 0;
+}
+
+block_id_type mapped_block_database::fetch_block_id( uint32_t block_num )const
+{
+   assert( block_num != 0 );
+   index_entry e;
+   if( !read_entry( index_pos( block_num ), e ) )
+      FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
+
+   FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
+   return e.block_id;
+}
+
+optional<signed_block> mapped_block_database::fetch_optional( const block_id_type& id )const
+{
+   index_entry e;
+   if( !read_entry( index_pos( block_header::num_from_id(id) ), e ) || e.block_id != id )
+      return optional<signed_block>();
+   return read_block( e );
+}
+
+optional<signed_block> mapped_block_database::fetch_by_number( uint32_t block_num )const
+{
+   index_entry e;
+   if( !read_entry( index_pos( block_num ), e ) )
+      return optional<signed_block>();
+   return read_block( e );
+}
+
+optional<signed_block> mapped_block_database::last()const
+{
+   auto e = last_entry();
+   if( !e )
+      return optional<signed_block>();
+   return read_block( *e );
+}
+
+optional<block_id_type> mapped_block_database::last_id()const
+{
+   auto e = last_entry();
+   if( !e )
+      return optional<block_id_type>();
+   return e->block_id;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// segmented_block_database
+
+static const char segment_prefix[] = "segment-";
+
+fc::path segmented_block_database::segment_dir( const fc::path& dbdir, uint32_t first_block_num )
+{
+   char name[32];
+   snprintf( name, sizeof(name), "%s%010u", segment_prefix, first_block_num );
+   return dbdir / name;
+}
+
+bool segmented_block_database::is_segmented( const fc::path& dbdir )
+{
+   if( !fc::exists( dbdir ) )
+      return false;
+   for( boost::filesystem::directory_iterator itr( dbdir ), end; itr != end; ++itr )
+      if( boost::starts_with( itr->path().filename().string(), segment_prefix ) )
+         return true;
+   return false;
+}
+
+void segmented_block_database::open( const fc::path& dbdir )
+{ try {
+   FC_ASSERT( !is_open() );
+   fc::create_directories( dbdir );
+   _dbdir = dbdir;
+
+   for( boost::filesystem::directory_iterator itr( dbdir ), end; itr != end; ++itr )
+   {
+      const std::string name = itr->path().filename().string();
+      if( !boost::starts_with( name, segment_prefix ) )
+         continue;
+      uint32_t first_block_num = boost::lexical_cast<uint32_t>( name.substr( sizeof(segment_prefix) - 1 ) );
+      segment_ptr segment = std::make_shared<mapped_block_database>( first_block_num );
+      segment->open( itr->path() );
+      _segments[first_block_num] = segment;
+   }
+   _open = true;
+
+   if( fc::exists( dbdir / "index" ) )
+      import_flat_log();
+
+   auto head = last_id();
+   if( head )
+      prune( block_header::num_from_id( *head ) );
+   update_first_retained_block_num();
+} FC_CAPTURE_AND_RETHROW( (dbdir) ) }
+
+void segmented_block_database::import_flat_log()
+{
+   mapped_block_database flat;
+   flat.open( _dbdir );
+   auto head = flat.last_id();
+   if( head )
+   {
+      const uint32_t last_num = block_header::num_from_id( *head );
+      uint32_t first_num = 1;
+      if( _retain_blocks > 0 && last_num > _retain_blocks )
+      {
+         first_num = last_num - _retain_blocks + 1;
+         first_num = std::max<uint32_t>( first_num - first_num % _blocks_per_segment, 1 );
+      }
+      ilog( "Moving blocks ${f} to ${l} into a segmented block log", ("f", first_num)("l", last_num) );
+      for( uint32_t num = first_num; num <= last_num; ++num )
+      {
+         auto b = flat.fetch_by_number( num );
+         if( b )
+            store( b->id(), fc::raw::pack( *b ) );
+      }
+   }
+   flat.close();
+   fc::remove( _dbdir / "index" );
+   fc::remove( _dbdir / "blocks" );
+}
+
+bool segmented_block_database::is_open()const
+{
+   return _open;
+}
+
+void segmented_block_database::flush()
+{
+   fc::scoped_lock<fc::mutex> lock( _segments_mutex );
+   for( const auto& segment : _segments )
+      segment.second->flush();
+}
+
+void segmented_block_database::close()
+{
+   fc::scoped_lock<fc::mutex> lock( _segments_mutex );
+   _segments.clear();
+   _first_retained_block_num = 0;
+   _open = false;
+}
+
+segmented_block_database::segment_ptr segmented_block_database::find_segment( uint32_t block_num )const
+{
+   fc::scoped_lock<fc::mutex> lock( _segments_mutex );
+   auto itr = _segments.find( block_num - block_num % _blocks_per_segment );
+   if( itr == _segments.end() )
+      return segment_ptr();
+   return itr->second;
+}
+
+segmented_block_database::segment_ptr segmented_block_database::create_segment( uint32_t block_num )
+{
+   const uint32_t first_block_num = block_num - block_num % _blocks_per_segment;
+   segment_ptr segment = std::make_shared<mapped_block_database>( first_block_num );
+   segment->open( segment_dir( _dbdir, first_block_num ) );
+   fc::scoped_lock<fc::mutex> lock( _segments_mutex );
+   _segments[first_block_num] = segment;
+   return segment;
+}
+
+void segmented_block_database::prune( uint32_t head_block_num )
+{
+   if( _retain_blocks == 0 || head_block_num <= _retain_blocks )
+      return;
+   const uint32_t first_retained = head_block_num - _retain_blocks + 1;
+
+   vector<uint32_t> pruned;
+   {
+      fc::scoped_lock<fc::mutex> lock( _segments_mutex );
+      auto itr = _segments.begin();
+      while( itr != _segments.end() && uint64_t(itr->first) + _blocks_per_segment <= first_retained )
+      {
+         pruned.push_back( itr->first );
+         itr = _segments.erase( itr );
+      }
+   }
+   for( uint32_t first_block_num : pruned )
+   {
+      ilog( "Pruning blocks ${f} to ${l}", ("f", first_block_num)("l", first_block_num + _blocks_per_segment - 1) );
+      fc::remove_all( segment_dir( _dbdir, first_block_num ) );
+   }
+   if( !pruned.empty() )
+      update_first_retained_block_num();
+}
+
+void segmented_block_database::update_first_retained_block_num()
+{
+   vector<segment_ptr> segments;
+   {
+      fc::scoped_lock<fc::mutex> lock( _segments_mutex );
+      for( const auto& segment : _segments )
+         segments.push_back( segment.second );
+   }
+   for( const auto& segment : segments )
+   {
+      auto first = segment->first_stored_block_num();
+      if( first )
+      {
+         _first_retained_block_num = *first;
+         return;
+      }
+   }
+   _first_retained_block_num = 0;
+}
+
+uint32_t segmented_block_database::first_retained_block_num()const
+{
+   return std::max<uint32_t>( _first_retained_block_num, 1 );
+}
+
+void segmented_block_database::store( const block_id_type& id, const vector<char>& packed_block )
+{
+   const uint32_t num = block_header::num_from_id( id );
+   segment_ptr segment = find_segment( num );
+   if( !segment )
+   {
+      segment = create_segment( num );
+      prune( num );
+   }
+   segment->store( id, packed_block );
+   const uint32_t first = _first_retained_block_num;
+   if( first == 0 || num < first )
+      _first_retained_block_num = num;
+}
+
+void segmented_block_database::remove( const block_id_type& id )
+{
+   segment_ptr segment = find_segment( block_header::num_from_id( id ) );
+   if( !segment )
+      FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
+   segment->remove( id );
+}
+
+bool segmented_block_database::contains( const block_id_type& id )const
+{
+   if( id == block_id_type() )
+      return false;
+   segment_ptr segment = find_segment( block_header::num_from_id( id ) );
+   return segment && segment->contains( id );
+}
+
+block_id_type segmented_block_database::fetch_block_id( uint32_t block_num )const
+{
+   segment_ptr segment = find_segment( block_num );
+   if( !segment )
+      FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
+   return segment->fetch_block_id( block_num );
+}
+
+optional<signed_block> segmented_block_database::fetch_optional( const block_id_type& id )const
+{
+   segment_ptr segment = find_segment( block_header::num_from_id( id ) );
+   if( !segment )
+      return optional<signed_block>();
+   return segment->fetch_optional( id );
+}
+
+optional<signed_block> segmented_block_database::fetch_by_number( uint32_t block_num )const
+{
+   segment_ptr segment = find_segment( block_num );
+   if( !segment )
+      return optional<signed_block>();
+   return segment->fetch_by_number( block_num );
+}
+
+optional<signed_block> segmented_block_database::last()const
+{
+   vector<segment_ptr> segments;
+   {
+      fc::scoped_lock<fc::mutex> lock( _segments_mutex );
+      for( auto itr = _segments.rbegin(); itr != _segments.rend(); ++itr )
+         segments.push_back( itr->second );
+   }
+   for( const auto& segment : segments )
+   {
+      auto result = segment->last();
+      if( result )
+         return result;
+   }
+   return optional<signed_block>();
+}
+
+optional<block_id_type> segmented_block_database::last_id()const
+{
+   vector<segment_ptr> segments;
+   {
+      fc::scoped_lock<fc::mutex> lock( _segments_mutex );
+      for( auto itr = _segments.rbegin(); itr != _segments.rend(); ++itr )
+         segments.push_back( itr->second );
+   }
+   for( const auto& segment : segments )
+   {
+      auto result = segment->last_id();
+      if( result )
+         return result;
+   }
+   return optional<block_id_type>();
+}
+
+} // detail
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// block_database
+
+block_database::block_database( backend_type backend )
+{
+   set_backend( backend );
+}
+
+block_database::~block_database() {}
+
+void block_database::set_backend( backend_type backend )
+{
+   FC_ASSERT( !my || !my->is_open(), "cannot change the backend of an open block database" );
+   _backend = backend;
+   if( backend == segmented_backend )
+      my.reset( new detail::segmented_block_database( _blocks_per_segment, _retain_blocks ) );
+   else if( backend == mapped_backend )
+      my.reset( new detail::mapped_block_database );
+   else
+      my.reset( new detail::stream_block_database );
+}
+
+void block_database::enable_segments( uint32_t retain_blocks, uint32_t blocks_per_segment )
+{
+   _retain_blocks = retain_blocks;
+   _blocks_per_segment = blocks_per_segment;
+   set_backend( segmented_backend );
+}
+
+void block_database::open( const fc::path& dbdir )
+{
+   if( _backend != segmented_backend && detail::segmented_block_database::is_segmented( dbdir ) )
+   {
+      wlog( "Found a segmented block log in ${d}, opening it as such", ("d", dbdir) );
+      set_backend( segmented_backend );
+   }
+   my->open( dbdir );
+}
+
+bool block_database::is_open()const
+{
+   return my->is_open();
+}
+
+void block_database::close()
+{
+   _cache.clear();
+   my->close();
+}
+
+void block_database::flush()
+{
+   my->flush();
+}
+
+void block_database::store( const block_id_type& _id, const signed_block& b )
+{
+   block_id_type id = _id;
+   if( id == block_id_type() )
+   {
+      id = b.id();
+      elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
+   }
+   auto packed = std::make_shared<vector<char>>( fc::raw::pack( b ) );
+   my->store( id, *packed );
+   _cache.insert( id, std::make_shared<signed_block>( b ), packed );
+}
+
+void block_database::remove( const block_id_type& id )
+{
+   _cache.remove( id );
+   my->remove( id );
+}
+
+bool block_database::contains( const block_id_type& id )const
+{
+   return my->contains( id );
+}
+
+block_id_type block_database::fetch_block_id( uint32_t block_num )const
+{
+   return my->fetch_block_id( block_num );
+}
+
+optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
+{
+   auto cached = _cache.find( id );
+   if( cached )
+      return *cached->block;
+
+   auto result = my->fetch_optional( id );
+   if( result )
+      _cache.insert( id, std::make_shared<signed_block>( *result ), nullptr );
+   return result;
+}
+
+optional<signed_block> block_database::fetch_by_number( uint32_t block_num )const
+{
+   auto cached = _cache.find( block_num );
+   if( cached )
+      return *cached->block;
+
+   auto result = my->fetch_by_number( block_num );
+   if( result )
+      _cache.insert( result->id(), std::make_shared<signed_block>( *result ), nullptr );
+   return result;
+}
+
+optional<signed_block> block_database::read_by_number( uint32_t block_num )const
+{
+   return my->fetch_by_number( block_num );
+}
+
+std::shared_ptr<const vector<char>> block_database::fetch_packed( const block_id_type& id )const
+{
+   auto cached = _cache.find( id );
+   if( cached && cached->packed )
+      return cached->packed;
+
+   std::shared_ptr<const signed_block> block;
+   if( cached )
+      block = cached->block;
+   else
+   {
+      auto result = my->fetch_optional( id );
+      if( !result )
+         return std::shared_ptr<const vector<char>>();
+      block = std::make_shared<signed_block>( std::move( *result ) );
+   }
+   auto packed = std::make_shared<vector<char>>( fc::raw::pack( *block ) );
+   _cache.insert( id, block, packed );
+   return packed;
+}
+
+optional<signed_block> block_database::last()const
+{
+   return my->last();
+}
+
+optional<block_id_type> block_database::last_id()const
+{
+   return my->last_id();
+}
+
+uint32_t block_database::first_retained_block_num()const
+{
+   return my->first_retained_block_num();
+}
 
 } }
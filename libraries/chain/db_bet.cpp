@@ -29,6 +29,8 @@
 #include <graphene/chain/betting_market_object.hpp>
 #include <graphene/chain/event_object.hpp>
 
+#include <fc/thread/non_preemptable_scope_check.hpp>
+
 #include <boost/range/iterator_range.hpp>
 #include <boost/range/combine.hpp>
 #include <boost/range/join.hpp>
@@ -174,8 +176,13 @@ void database::settle_betting_market_group(const betting_market_group_object& be
    // stored in the individual betting markets
    std::map<betting_market_id_type, betting_market_resolution_type> resolutions_by_market_id;
 
-   // collecting bettors and their positions
-   std::map<account_id_type, std::vector<const betting_market_position_object*> > bettor_positions_map;
+   // collecting bettors and their positions, market by market
+   struct settled_position
+   {
+      account_id_type bettor_id;
+      const betting_market_position_object* position;
+   };
+   std::vector<settled_position> positions;
 
    auto& betting_market_index = get_index_type<betting_market_object_index>().indices().get<by_betting_market_group_id>();
    // [ROL] it seems to be my mistake - wrong index used
@@ -199,90 +206,131 @@ void database::settle_betting_market_group(const betting_market_group_object& be
          const betting_market_position_object& position = *position_itr;
          ++position_itr;
 
-         bettor_positions_map[position.bettor_id].push_back(&position);
+         positions.push_back(settled_position{position.bettor_id, &position});
       }
    }
 
-   // walking through bettors' positions and collecting winings and fees respecting asset_id
-   for (const auto& bettor_positions_pair: bettor_positions_map)
+   // group the positions by bettor, each bettor's positions stay in market order
+   std::stable_sort(positions.begin(), positions.end(), [](const settled_position& a, const settled_position& b) {
+      return a.bettor_id < b.bettor_id;
+   });
+
+   struct bettor_settlement
    {
-      uint16_t rake_fee_percentage = get_global_properties().parameters.betting_rake_fee_percentage();
-      share_type net_profits;
-      share_type payout_amounts;
-      account_id_type bettor_id = bettor_positions_pair.first;
-      const std::vector<const betting_market_position_object*>& bettor_positions = bettor_positions_pair.second;
+      account_id_type bettor_id;
+      size_t          first_position;
+      size_t          end_position;
+      share_type      net_profits;
+      share_type      payout_amounts;
+      share_type      rake_amount;
+   };
+   std::vector<bettor_settlement> bettors;
+   for (size_t i = 0; i < positions.size(); ++i)
+   {
+      if (bettors.empty() || bettors.back().bettor_id != positions[i].bettor_id)
+         bettors.push_back(bettor_settlement{positions[i].bettor_id, i, i});
+      bettors.back().end_position = i + 1;
+   }
 
-      for (const betting_market_position_object* position : bettor_positions)
+   // walking through bettors' positions and collecting winings and fees respecting asset_id, this only
+   // reads the positions, so the bettors are spread over the worker threads; no other task of this thread
+   // may run until the positions are removed
+   ASSERT_TASK_NOT_PREEMPTED();
+   const uint16_t rake_fee_percentage = get_global_properties().parameters.betting_rake_fee_percentage();
+   auto compute_payouts = [&](size_t begin, size_t end) {
+      for (size_t b = begin; b < end; ++b)
       {
-         betting_market_resolution_type resolution;
-         try
+         bettor_settlement& bettor = bettors[b];
+         for (size_t i = bettor.first_position; i < bettor.end_position; ++i)
          {
-            resolution = resolutions_by_market_id.at(position->betting_market_id);
-         }
-         catch (std::out_of_range&)
-         {
-            FC_THROW_EXCEPTION(fc::key_not_found_exception, "Unexpected betting market ID, shouldn't happen");
+            const betting_market_position_object* position = positions[i].position;
+            auto resolution_itr = resolutions_by_market_id.find(position->betting_market_id);
+            if (resolution_itr == resolutions_by_market_id.end())
+               FC_THROW_EXCEPTION(fc::key_not_found_exception, "Unexpected betting market ID, shouldn't happen");
+
+            switch (resolution_itr->second)
+            {
+               case betting_market_resolution_type::win:
+                  {
+                     share_type total_payout = position->pay_if_payout_condition + position->pay_if_not_canceled;
+                     bettor.payout_amounts += total_payout;
+                     bettor.net_profits += total_payout - position->pay_if_canceled;
+                     break;
+                  }
+               case betting_market_resolution_type::not_win:
+                  {
+                     share_type total_payout = position->pay_if_not_payout_condition + position->pay_if_not_canceled;
+                     bettor.payout_amounts += total_payout;
+                     bettor.net_profits += total_payout - position->pay_if_canceled;
+                     break;
+                  }
+               case betting_market_resolution_type::cancel:
+                  bettor.payout_amounts += position->pay_if_canceled;
+                  break;
+               default:
+                  // the position is left alone
+                  positions[i].position = nullptr;
+                  continue;
+            }
          }
 
-         ///if (cancel)
-         ///   resolution = betting_market_resolution_type::cancel;
-         ///else
-         ///{
-         ///   // checked in evaluator, should never happen, see above
-         ///   assert(resolutions.count(position->betting_market_id));
-         ///   resolution = resolutions.at(position->betting_market_id);
-         ///}
+         // the fees for the dividend-distribution account if net profit
+         if (bettor.net_profits.value > 0 && rake_account_id)
+            bettor.rake_amount = ((fc::uint128_t(bettor.net_profits.value) * rake_fee_percentage + GRAPHENE_100_PERCENT - 1) / GRAPHENE_100_PERCENT).to_uint64();
+      }
+   };
+   if (_thread_pool && bettors.size() >= 1000)
+      _thread_pool->for_each_range(bettors.size(), compute_payouts);
+   else
+      compute_payouts(0, bettors.size());
 
+   // The rake account is credited once at the end, unless that could change the outcome: when its balance does
+   // not exist yet it has to be created where it used to be, and when it is a bettor, its own payout comes first.
+   share_type rake_to_credit;
+   bool defer_rake = false;
+   if (rake_account_id)
+   {
+      const auto& balance_idx = get_index_type<account_balance_index>().indices().get<by_account_asset>();
+      auto rake_bettor = std::lower_bound(bettors.begin(), bettors.end(), *rake_account_id,
+                                          [](const bettor_settlement& bettor, account_id_type id) { return bettor.bettor_id < id; });
+      defer_rake = balance_idx.find(boost::make_tuple(*rake_account_id, betting_market_group.asset_id)) != balance_idx.end() &&
+                   (rake_bettor == bettors.end() || rake_bettor->bettor_id != *rake_account_id);
+   }
 
-         switch (resolution)
+   // paying out in the order of the bettors
+   for (const bettor_settlement& bettor : bettors)
+   {
+      // pay the fees to the dividend-distribution account if net profit
+      if (bettor.rake_amount.value)
+      {
+         share_type affiliates_share = payout_helper.payout( bettor.bettor_id, bettor.rake_amount );
+         FC_ASSERT( bettor.rake_amount.value >= affiliates_share.value );
+         if (bettor.rake_amount.value > affiliates_share.value)
          {
-            case betting_market_resolution_type::win:
-               {
-                  share_type total_payout = position->pay_if_payout_condition + position->pay_if_not_canceled;
-                  payout_amounts += total_payout;
-                  net_profits += total_payout - position->pay_if_canceled;
-                  break;
-               }
-            case betting_market_resolution_type::not_win:
-               {
-                  share_type total_payout = position->pay_if_not_payout_condition + position->pay_if_not_canceled;
-                  payout_amounts += total_payout;
-                  net_profits += total_payout - position->pay_if_canceled;
-                  break;
-               }
-            case betting_market_resolution_type::cancel:
-               payout_amounts += position->pay_if_canceled;
-               break;
-            default:
-               continue;
+            if (defer_rake)
+               rake_to_credit += bettor.rake_amount - affiliates_share;
+            else
+               adjust_balance(*rake_account_id, asset(bettor.rake_amount - affiliates_share, betting_market_group.asset_id));
          }
-         remove(*position);
       }
 
-      // pay the fees to the dividend-distribution account if net profit
-      share_type rake_amount;
-      if (net_profits.value > 0 && rake_account_id)
-      {
-         rake_amount = ((fc::uint128_t(net_profits.value) * rake_fee_percentage + GRAPHENE_100_PERCENT - 1) / GRAPHENE_100_PERCENT).to_uint64();
-         share_type affiliates_share;
-         if (rake_amount.value)
-            affiliates_share = payout_helper.payout( bettor_id, rake_amount );
-         FC_ASSERT( rake_amount.value >= affiliates_share.value );
-         if (rake_amount.value > affiliates_share.value)
-            adjust_balance(*rake_account_id, asset(rake_amount - affiliates_share, betting_market_group.asset_id));
-      }
-      
       // pay winning - rake
-      adjust_balance(bettor_id, asset(payout_amounts - rake_amount, betting_market_group.asset_id));
+      adjust_balance(bettor.bettor_id, asset(bettor.payout_amounts - bettor.rake_amount, betting_market_group.asset_id));
       // [ROL]
-      //fc_idump(fc::logger::get("betting"), (payout_amounts)(net_profits.value)(rake_amount.value));
+      //fc_idump(fc::logger::get("betting"), (bettor.payout_amounts)(bettor.net_profits.value)(bettor.rake_amount.value));
 
-      push_applied_operation(betting_market_group_resolved_operation(bettor_id,
+      push_applied_operation(betting_market_group_resolved_operation(bettor.bettor_id,
                              betting_market_group.id,
                              resolutions_by_market_id,
-                             payout_amounts,
-                             rake_amount));
+                             bettor.payout_amounts,
+                             bettor.rake_amount));
    }
+   if (rake_to_credit.value)
+      adjust_balance(*rake_account_id, asset(rake_to_credit, betting_market_group.asset_id));
+
+   for (const settled_position& settled : positions)
+      if (settled.position)
+         remove(*settled.position);
 
    // At this point, the betting market group will either be in the "graded" or "canceled" state,
    // if it was graded, mark it as settled.  if it's canceled, let it remain canceled.
@@ -575,6 +623,157 @@ int match_bet(database& db, const bet_object& taker_bet, const bet_object& maker
 }
 
 
+/**
+ *  While a taker bet sweeps makers that it fills completely without running out itself, the changes
+ *  to the taker bet, its bettor's balance and its betting position are only collected here and written
+ *  to the database by flush().  The virtual operations are pushed in the same order and with the same
+ *  contents as match_bet() pushes them, so the result is the same as matching bet by bet.
+ *
+ *  Everything else goes through match_bet(), after a flush().
+ */
+class taker_fill
+{
+public:
+   taker_fill(database& db, const bet_object& taker_bet)
+      : _db(db), _taker_bet(taker_bet), _amount_to_bet(taker_bet.amount_to_bet.amount)
+   {
+      // the balance must exist, or crediting it would create it somewhere in the middle of the matching
+      const auto& balance_idx = db.get_index_type<account_balance_index>().indices().get<by_account_asset>();
+      _can_defer = balance_idx.find(boost::make_tuple(taker_bet.bettor_id, taker_bet.amount_to_bet.asset_id)) != balance_idx.end();
+   }
+
+   /**
+    *  Matches the maker bet if it is filled completely and the taker bet stays on the books.
+    *  @return false, without changing anything, if the bets have to be matched by match_bet()
+    */
+   bool match_maker(const bet_object& maker_bet, share_type back_odds_ratio, share_type lay_odds_ratio)
+   {
+      // a bettor matching their own bet shares the balance and the position with the taker
+      if (!_can_defer || maker_bet.bettor_id == _taker_bet.bettor_id)
+         return false;
+
+      // the same sizing as in match_bet()
+      const share_type& maker_odds_ratio = maker_bet.back_or_lay == bet_type::back ? back_odds_ratio : lay_odds_ratio;
+      const share_type& taker_odds_ratio = maker_bet.back_or_lay == bet_type::back ? lay_odds_ratio : back_odds_ratio;
+
+      share_type maximum_taker_factor = _amount_to_bet / taker_odds_ratio;
+      if (_taker_bet.back_or_lay == bet_type::lay)
+      {
+         share_type maximum_factor_taker_is_willing_to_receive =
+            bet_object::get_exact_matching_amount(_amount_to_bet, _taker_bet.backer_multiplier, bet_type::lay) / maker_odds_ratio;
+         if (maximum_factor_taker_is_willing_to_receive < maximum_taker_factor)
+            maximum_taker_factor = maximum_factor_taker_is_willing_to_receive;
+      }
+      share_type maximum_maker_factor = maker_bet.amount_to_bet.amount / maker_odds_ratio;
+      share_type maximum_factor = std::min(maximum_taker_factor, maximum_maker_factor);
+      share_type maker_amount_to_match = maximum_factor * maker_odds_ratio;
+      share_type taker_amount_to_match = maximum_factor * taker_odds_ratio;
+
+      if (maker_amount_to_match == 0 ||
+          maker_amount_to_match != maker_bet.amount_to_bet.amount ||
+          taker_amount_to_match == _amount_to_bet)
+         return false;
+
+      // the maker bet is filled, what remains of the taker bet is rounded to the taker's odds
+      share_type takers_odds_back_odds_ratio;
+      share_type takers_odds_lay_odds_ratio;
+      std::tie(takers_odds_back_odds_ratio, takers_odds_lay_odds_ratio) = _taker_bet.get_ratio();
+      const share_type& takers_odds_taker_odds_ratio = _taker_bet.back_or_lay == bet_type::back ? takers_odds_back_odds_ratio : takers_odds_lay_odds_ratio;
+      const share_type& takers_odds_maker_odds_ratio = _taker_bet.back_or_lay == bet_type::back ? takers_odds_lay_odds_ratio : takers_odds_back_odds_ratio;
+      share_type taker_remaining_factor;
+      if (_taker_bet.back_or_lay == bet_type::back)
+         taker_remaining_factor = (_amount_to_bet - taker_amount_to_match) / takers_odds_taker_odds_ratio;
+      else
+         taker_remaining_factor = (bet_object::get_exact_matching_amount(_amount_to_bet, _taker_bet.backer_multiplier, bet_type::lay) - maker_amount_to_match) /
+                                  takers_odds_maker_odds_ratio;
+      share_type taker_remaining_bet_amount = taker_remaining_factor * takers_odds_taker_odds_ratio;
+      share_type taker_refund_amount = _amount_to_bet - taker_amount_to_match - taker_remaining_bet_amount;
+
+      // if nothing remains, the taker bet leaves the books
+      if (taker_remaining_bet_amount == 0)
+         return false;
+
+      const asset_id_type asset_id = _taker_bet.amount_to_bet.asset_id;
+      if (taker_refund_amount > share_type())
+      {
+         _amount_to_bet -= taker_refund_amount;
+         _balance_delta += taker_refund_amount;
+         _db.push_applied_operation(bet_adjusted_operation(_taker_bet.bettor_id, _taker_bet.id, asset(taker_refund_amount, asset_id)));
+      }
+
+      share_type guaranteed_winnings_returned = adjust_position(taker_amount_to_match, maker_amount_to_match);
+      _balance_delta += guaranteed_winnings_returned;
+      _db.push_applied_operation(bet_matched_operation(_taker_bet.bettor_id, _taker_bet.id,
+                                                       asset(taker_amount_to_match, asset_id),
+                                                       maker_bet.backer_multiplier,
+                                                       guaranteed_winnings_returned));
+      _amount_to_bet -= taker_amount_to_match;
+      _pending = true;
+
+      bool maker_removed = bet_was_matched(_db, maker_bet, maker_amount_to_match, taker_amount_to_match, maker_bet.backer_multiplier, false);
+      assert(maker_removed);
+      (void)maker_removed;
+      return true;
+   }
+
+   /// Writes the collected changes, must be called before the taker bet is used anywhere else
+   void flush()
+   {
+      if (!_pending)
+         return;
+      _pending = false;
+
+      _db.modify(_taker_bet, [this](bet_object& bet_obj) {
+         bet_obj.amount_to_bet.amount = _amount_to_bet;
+      });
+      _db.adjust_balance(_taker_bet.bettor_id, asset(_balance_delta, _taker_bet.amount_to_bet.asset_id));
+      _balance_delta = 0;
+      if (_position)
+      {
+         _db.modify(_db.get<betting_market_position_object>(_position->id), [this](betting_market_position_object& position) {
+            position.pay_if_payout_condition = _position->pay_if_payout_condition;
+            position.pay_if_not_payout_condition = _position->pay_if_not_payout_condition;
+            position.pay_if_canceled = _position->pay_if_canceled;
+            position.pay_if_not_canceled = _position->pay_if_not_canceled;
+         });
+         _position.reset();
+      }
+   }
+
+private:
+   /// adjust_betting_position() for the taker, on a copy of the position once it exists
+   share_type adjust_position(share_type bet_amount, share_type matched_amount)
+   {
+      if (!_position)
+      {
+         const auto& index = _db.get_index_type<betting_market_position_index>().indices().get<by_bettor_betting_market>();
+         auto itr = index.find(boost::make_tuple(_taker_bet.bettor_id, _taker_bet.betting_market_id));
+         if (itr == index.end())
+         {
+            // created right away, it gets its id before the maker's position
+            share_type guaranteed_winnings_returned = adjust_betting_position(_db, _taker_bet.bettor_id, _taker_bet.betting_market_id,
+                                                                              _taker_bet.back_or_lay, bet_amount, matched_amount);
+            _position = *index.find(boost::make_tuple(_taker_bet.bettor_id, _taker_bet.betting_market_id));
+            return guaranteed_winnings_returned;
+         }
+         _position = *itr;
+      }
+      _position->pay_if_payout_condition += _taker_bet.back_or_lay == bet_type::back ? bet_amount + matched_amount : 0;
+      _position->pay_if_not_payout_condition += _taker_bet.back_or_lay == bet_type::lay ? bet_amount + matched_amount : 0;
+      _position->pay_if_canceled += bet_amount;
+      return _position->reduce();
+   }
+
+   database&                                  _db;
+   const bet_object&                          _taker_bet;
+   share_type                                 _amount_to_bet;
+   share_type                                 _balance_delta;
+   optional<betting_market_position_object>   _position;
+   bool                                       _can_defer = false;
+   bool                                       _pending = false;
+};
+
+
 // called from the bet_place_evaluator
 bool database::place_bet(const bet_object& new_bet_object)
 {
@@ -612,29 +811,48 @@ bool database::place_bet(const bet_object& new_bet_object)
    }
 
    const auto& bet_odds_idx = get_index_type<bet_object_index>().indices().get<by_odds>();
+   const auto& bet_idx = dynamic_cast<const primary_index<bet_object_index>&>(get_index_type<bet_object_index>());
+   const bet_price_level_index& price_levels = bet_idx.get_secondary_index<bet_price_level_index>();
 
    bet_type bet_type_to_match = new_bet_object.back_or_lay == bet_type::back ? bet_type::lay : bet_type::back;
-   auto book_itr = bet_odds_idx.lower_bound(std::make_tuple(new_bet_object.betting_market_id, bet_type_to_match));
-   auto book_end = bet_odds_idx.upper_bound(std::make_tuple(new_bet_object.betting_market_id, bet_type_to_match, new_bet_object.backer_multiplier));
-
-   // fc_ilog(fc::logger::get("betting"), "");
-   // fc_ilog(fc::logger::get("betting"), "------------  order book ------------------");
-   // for (auto itr = book_itr; itr != book_end; ++itr)
-   //    fc_idump(fc::logger::get("betting"), (*itr));
-   // fc_ilog(fc::logger::get("betting"), "------------  order book ------------------");
+   auto level_itr = price_levels.get_levels(new_bet_object.betting_market_id, bet_type_to_match).first;
+   auto levels_end = price_levels.next_level(bet_price_level_index::level_key{new_bet_object.betting_market_id, bet_type_to_match,
+                                                                               new_bet_object.backer_multiplier});
 
+   // walk the matching levels best odds first, and the bets of each level in the order of the by_odds index
+   taker_fill fill(*this, new_bet_object);
    int orders_matched_flags = 0;
    bool finished = false;
-   while (!finished && book_itr != book_end)
+   while (!finished && level_itr != levels_end)
    {
-      auto old_book_itr = book_itr;
-      ++book_itr;
+      const bet_price_level_index::level_key level = level_itr->first;
+      share_type back_odds_ratio;
+      share_type lay_odds_ratio;
+      std::tie(back_odds_ratio, lay_odds_ratio) = bet_object::get_ratio(level.backer_multiplier);
+
+      auto book_itr = bet_odds_idx.lower_bound(std::make_tuple(level.betting_market_id, level.back_or_lay, level.backer_multiplier));
+      auto book_end = bet_odds_idx.upper_bound(std::make_tuple(level.betting_market_id, level.back_or_lay, level.backer_multiplier));
+      while (!finished && book_itr != book_end)
+      {
+         auto old_book_itr = book_itr;
+         ++book_itr;
+
+         if (fill.match_maker(*old_book_itr, back_odds_ratio, lay_odds_ratio))
+            continue;
 
-      orders_matched_flags = match_bet(*this, new_bet_object, *old_book_itr);
+         fill.flush();
+         orders_matched_flags = match_bet(*this, new_bet_object, *old_book_itr);
+
+         // we continue if the maker bet was completely consumed AND the taker bet was not
+         finished = orders_matched_flags != 2;
+      }
 
-      // we continue if the maker bet was completely consumed AND the taker bet was not
-      finished = orders_matched_flags != 2;
+      // the level may be gone now, and so may the end of the range if it was the taker's own level
+      level_itr = price_levels.next_level(level);
+      levels_end = price_levels.next_level(bet_price_level_index::level_key{new_bet_object.betting_market_id, bet_type_to_match,
+                                                                             new_bet_object.backer_multiplier});
    }
+   fill.flush();
    if (!(orders_matched_flags & 1))
       fc_ddump(fc::logger::get("betting"), (new_bet_object));
 
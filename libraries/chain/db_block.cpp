@@ -29,6 +29,7 @@
 #include <graphene/chain/protocol/operations.hpp>
 #include <graphene/chain/protocol/betting_market.hpp>
 
+#include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/block_summary_object.hpp>
 #include <graphene/chain/global_property_object.hpp>
 #include <graphene/chain/operation_history_object.hpp>
@@ -39,7 +40,11 @@
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/evaluator.hpp>
+
+#include <graphene/utilities/thread_pool.hpp>
+
 #include <fc/crypto/digest.hpp>
+#include <fc/thread/non_preemptable_scope_check.hpp>
 
 #include <fc/smart_ref_impl.hpp>
 
@@ -65,6 +70,11 @@ block_id_type  database::get_block_id_for_num( uint32_t block_num )const
    return _block_id_to_block.fetch_block_id( block_num );
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
+uint32_t database::first_retained_block_num()const
+{
+   return _block_id_to_block.first_retained_block_num();
+}
+
 optional<signed_block> database::fetch_block_by_id( const block_id_type& id )const
 {
    auto b = _fork_db.fetch_block( id );
@@ -73,6 +83,18 @@ optional<signed_block> database::fetch_block_by_id( const block_id_type& id )con
    return b->data;
 }
 
+std::shared_ptr<const vector<char>> database::fetch_packed_block_by_id( const block_id_type& id )const
+{
+   auto packed = _block_id_to_block.fetch_packed( id );
+   if( !packed )
+   {
+      auto b = _fork_db.fetch_block( id );
+      if( b )
+         packed = std::make_shared<vector<char>>( fc::raw::pack( b->data ) );
+   }
+   return packed;
+}
+
 optional<signed_block> database::fetch_block_by_number( uint32_t num )const
 {
    auto results = _fork_db.fetch_block_by_number(num);
@@ -118,15 +140,28 @@ std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of
 bool database::push_block(const signed_block& new_block, uint32_t skip)
 {
 //   idump((new_block.block_num())(new_block.id())(new_block.timestamp)(new_block.previous));
+   read_write_lock::write_guard write( _read_write_lock );
+   const block_id_type old_head_id = head_block_id();
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
-      detail::without_pending_transactions( *this, std::move(_pending_tx),
-      [&]()
-      {
-         result = _push_block(new_block);
-      });
+      detail::pending_transactions_restorer restorer( *this, std::move(_pending_tx) );
+      result = _push_block(new_block);
+      // after a fork switch the pending transactions were checked against the other fork
+      restorer.set_authorities_unchanged( !result && !head_block_changed_authorities() );
    });
+   // a block stored on a side fork leaves the head, and its checkpoint, where they were
+   if( _state_checkpoint_interval > 0 && head_block_id() != old_head_id &&
+       head_block_num() % _state_checkpoint_interval == 0 )
+   {
+      try {
+         // the checkpoint may be at any block up to the head, they must be on disk first
+         _block_id_to_block.flush();
+         save_checkpoint();
+      } catch( const fc::exception& e ) {
+         elog( "Unable to save a state checkpoint: ${e}", ("e", e.to_detail_string()) );
+      }
+   }
    return result;
 }
 
@@ -222,6 +257,7 @@ bool database::_push_block(const signed_block& new_block)
  */
 processed_transaction database::push_transaction( const signed_transaction& trx, uint32_t skip )
 { try {
+   read_write_lock::write_guard write( _read_write_lock );
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -242,11 +278,32 @@ processed_transaction database::_push_transaction( const signed_transaction& trx
    // _apply_transaction fails.  If we make it to merge(), we
    // apply the changes.
 
+   // Recover the signing keys once and remember them, so they don't have to be recovered again
+   // when the transaction is re-applied by _generate_block() or arrives inside a block.  If that
+   // fails, _apply_transaction() reports the error.
+   uint32_t skip = get_node_properties().skip_flags;
+   optional< flat_set<public_key_type> > signature_keys;
+   if( !(skip & (skip_transaction_signatures | skip_authority_check)) )
+   {
+      try
+      {
+         signature_keys = trx.get_signature_keys( get_chain_id(), _signature_key_cache, true );
+      }
+      catch( const fc::exception& )
+      {
+      }
+   }
+
    auto temp_session = _undo_db.start_undo_session();
-   auto processed_trx = _apply_transaction( trx );
-   _pending_tx.push_back(processed_trx);
+   auto processed_trx = _apply_transaction( trx, signature_keys.valid() ? &*signature_keys : nullptr );
+   const uint32_t packed_size = fc::raw::pack_size( processed_trx );
+   const bool added = _pending_tx.add( processed_trx, packed_size, pending_fee_per_kb( processed_trx, packed_size ),
+                                       !(skip & (skip_transaction_signatures | skip_authority_check)) );
+   FC_ASSERT( added, "The pending transaction pool is full and the transaction pays a lower fee per byte than any in it",
+              ("max_size", _pending_tx.max_size()) );
 
    // notify_changed_objects();
+   notify_pending_objects_changed();
    // The transaction applied successfully. Merge its changes into the pending block session.
    temp_session.merge();
 
@@ -255,8 +312,72 @@ processed_transaction database::_push_transaction( const signed_transaction& trx
    return processed_trx;
 }
 
+processed_transaction database::_push_pending_transaction( const pending_transaction_pool::entry& e,
+                                                           bool authorities_unchanged )
+{
+   uint32_t skip = get_node_properties().skip_flags;
+   if( !authorities_unchanged || !e.authority_checked || (skip & (skip_transaction_signatures | skip_authority_check)) )
+      return _push_transaction( e.trx );
+
+   if( !_pending_tx_session.valid() )
+      _pending_tx_session = _undo_db.start_undo_session();
+
+   auto temp_session = _undo_db.start_undo_session();
+   processed_transaction processed_trx;
+   detail::with_skip_flags( *this, skip | skip_transaction_signatures | skip_authority_check, [&]()
+   {
+      processed_trx = _apply_transaction( e.trx, nullptr, &e.id );
+   });
+   const uint32_t packed_size = fc::raw::pack_size( processed_trx );
+   const bool added = _pending_tx.add( processed_trx, packed_size, e.fee_per_kb, true );
+   FC_ASSERT( added, "The pending transaction pool is full and the transaction pays a lower fee per byte than any in it",
+              ("max_size", _pending_tx.max_size()) );
+   notify_pending_objects_changed();
+   temp_session.merge();
+
+   on_pending_transaction( e.trx );
+   return processed_trx;
+}
+
+uint64_t database::pending_fee_per_kb( const signed_transaction& trx, uint32_t packed_size )const
+{
+   return pending_transaction_pool::fee_per_kb( trx, packed_size, [this]( const asset& fee ) -> share_type
+   {
+      if( fee.asset_id == asset_id_type() )
+         return fee.amount;
+      try
+      {
+         return ( fee * fee.asset_id(*this).options.core_exchange_rate ).amount;
+      }
+      catch( const fc::exception& )
+      {
+         return 0;
+      }
+   });
+}
+
+bool database::head_block_changed_authorities()const
+{
+   if( _undo_db.size() == 0 )
+      return true;
+   const object_id_type global_properties = global_property_id_type();
+   auto is_authority = [&]( object_id_type id ) {
+      return id == global_properties || ( id.space() == protocol_ids && id.type() == account_object_type );
+   };
+   const undo_state& head = _undo_db.head();
+   for( const auto& item : head.old_values )
+      if( is_authority( item.first ) )
+         return true;
+   for( const auto& item : head.removed )
+      if( is_authority( item.first ) )
+         return true;
+   return false;
+}
+
 processed_transaction database::validate_transaction( const signed_transaction& trx )
 {
+   // applies the transaction for a moment, readers must not see it
+   read_write_lock::write_guard write( _read_write_lock );
    auto session = _undo_db.start_undo_session();
    return _apply_transaction( trx );
 }
@@ -305,6 +426,7 @@ signed_block database::generate_block(
    uint32_t skip /* = 0 */
    )
 { try {
+   read_write_lock::write_guard write( _read_write_lock );
    signed_block result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -348,41 +470,66 @@ signed_block database::_generate_block(
    // the value of the "when" variable is known, which means we need to
    // re-apply pending transactions in this method.
    //
+   // Transactions are applied by decreasing fee per byte, the ones that
+   // fail are tried once more in arrival order after all others, in case
+   // they depend on a transaction that pays a lower fee.
+   //
+   if( _pending_tx_session.valid() )
+      notify_pending_objects_changed();
    _pending_tx_session.reset();
    _pending_tx_session = _undo_db.start_undo_session();
 
+   const size_t expired_tx_count = _pending_tx.remove_expired( head_block_time() );
+   if( expired_tx_count > 0 )
+      ilog( "Dropped ${n} expired pending transactions", ("n", expired_tx_count) );
+
    uint64_t postponed_tx_count = 0;
-   // pop pending state (reset to head block state)
-   for( const processed_transaction& tx : _pending_tx )
+   std::vector< const pending_transaction_pool::entry* > failed;
+   auto apply_pending = [&]( const pending_transaction_pool::entry& e, bool retry )
    {
-      size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
+      size_t new_total_size = total_block_size + e.packed_size;
 
       // postpone transaction if it would make block too big
       if( new_total_size >= maximum_block_size )
       {
          postponed_tx_count++;
-         continue;
+         return;
       }
 
       try
       {
          auto temp_session = _undo_db.start_undo_session();
-         processed_transaction ptx = _apply_transaction( tx );
+         processed_transaction ptx = _apply_transaction( e.trx, nullptr, &e.id );
          temp_session.merge();
 
-         // We have to recompute pack_size(ptx) because it may be different
-         // than pack_size(tx) (i.e. if one or more results increased
-         // their size)
-         total_block_size += fc::raw::pack_size( ptx );
-         pending_block.transactions.push_back( ptx );
+         // The size of ptx may be different than the cached one
+         // (i.e. if one or more results increased their size)
+         const uint32_t packed_size = fc::raw::pack_size( ptx );
+         total_block_size += packed_size;
+         _pending_tx.update( e, ptx, packed_size );
+         pending_block.transactions.push_back( std::move( ptx ) );
       }
-      catch ( const fc::exception& e )
+      catch ( const fc::exception& ex )
       {
+         if( !retry )
+         {
+            failed.push_back( &e );
+            return;
+         }
          // Do nothing, transaction will not be re-applied
-         wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
-         wlog( "The transaction was ${t}", ("t", tx) );
+         wlog( "Transaction was not processed while generating block due to ${e}", ("e", ex) );
+         wlog( "The transaction was ${t}", ("t", e.trx) );
       }
-   }
+   };
+   for( const auto& e : _pending_tx.entries().get<pending_transaction_pool::by_fee>() )
+      apply_pending( e, false );
+
+   std::sort( failed.begin(), failed.end(), []( const pending_transaction_pool::entry* a,
+                                                const pending_transaction_pool::entry* b ) {
+      return a->sequence < b->sequence;
+   });
+   for( const auto* e : failed )
+      apply_pending( *e, true );
    if( postponed_tx_count > 0 )
    {
       wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
@@ -436,6 +583,9 @@ signed_block database::_generate_block(
  */
 void database::pop_block()
 { try {
+   read_write_lock::write_guard write( _read_write_lock );
+   if( _pending_tx_session.valid() )
+      notify_pending_objects_changed();
    _pending_tx_session.reset();
    auto head_id = head_block_id();
    optional<signed_block> head_block = fetch_block_by_id( head_id );
@@ -443,6 +593,7 @@ void database::pop_block()
 
    _fork_db.pop_block();
    _block_id_to_block.remove( head_id );
+   notify_pending_objects_changed();
    pop_undo();
 
    _popped_tx.insert( _popped_tx.begin(), head_block->transactions.begin(), head_block->transactions.end() );
@@ -451,8 +602,11 @@ void database::pop_block()
 
 void database::clear_pending()
 { try {
+   read_write_lock::write_guard write( _read_write_lock );
    assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
    _pending_tx.clear();
+   if( _pending_tx_session.valid() )
+      notify_pending_objects_changed();
    _pending_tx_session.reset();
 } FC_CAPTURE_AND_RETHROW() }
 
@@ -488,7 +642,18 @@ vector<optional< operation_history_object > >& database::get_applied_operations(
 }
 //////////////////// private methods ////////////////////
 
-void database::apply_block( const signed_block& next_block, uint32_t skip )
+database::block_hashes database::compute_block_hashes( const signed_block& b )
+{
+   block_hashes result;
+   result.block_id = b.id();
+   result.merkle_root = b.calculate_merkle_root();
+   result.transaction_ids.reserve( b.transactions.size() );
+   for( const auto& trx : b.transactions )
+      result.transaction_ids.push_back( trx.id() );
+   return result;
+}
+
+void database::apply_block( const signed_block& next_block, uint32_t skip, const block_hashes* hashes )
 {
    auto block_num = next_block.block_num();
    if( _checkpoints.size() && _checkpoints.rbegin()->second != block_id_type() )
@@ -503,18 +668,22 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
 
    detail::with_skip_flags( *this, skip, [&]()
    {
-      _apply_block( next_block );
+      _apply_block( next_block, hashes );
    } );
    return;
 }
 
-void database::_apply_block( const signed_block& next_block )
+void database::_apply_block( const signed_block& next_block, const block_hashes* hashes )
 { try {
    uint32_t next_block_num = next_block.block_num();
    uint32_t skip = get_node_properties().skip_flags;
    _applied_ops.clear();
+   execution_profiler::block_timer phases( _execution_profiler );
+
+   FC_ASSERT( hashes == nullptr || hashes->transaction_ids.size() == next_block.transactions.size() );
+   const block_id_type next_block_id = hashes ? hashes->block_id : next_block.id();
 
-   FC_ASSERT( (skip & skip_merkle_check) || next_block.transaction_merkle_root == next_block.calculate_merkle_root(), "", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",next_block.calculate_merkle_root())("next_block",next_block)("id",next_block.id()) );
+   FC_ASSERT( (skip & skip_merkle_check) || next_block.transaction_merkle_root == (hashes ? hashes->merkle_root : next_block.calculate_merkle_root()), "", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",next_block.calculate_merkle_root())("next_block",next_block)("id",next_block_id) );
 
    const witness_object& signing_witness = validate_block_header(skip, next_block);
    const auto& global_props = get_global_properties();
@@ -525,6 +694,12 @@ void database::_apply_block( const signed_block& next_block )
    _current_trx_in_block = 0;
    _current_op_in_trx    = 0;
    _current_virtual_op   = 0;
+   phases.mark( execution_profiler::header_validation );
+
+   // Validation and signature recovery don't depend on chain state, so do them for the whole block up front
+   const vector< prepared_transaction > prepared =
+      prepare_transactions( next_block, !(skip & (skip_transaction_signatures | skip_authority_check)) );
+   phases.mark( execution_profiler::transaction_preparation );
 
    for( const auto& trx : next_block.transactions )
    {
@@ -535,7 +710,17 @@ void database::_apply_block( const signed_block& next_block )
        * when building a block.
        */
 
-      apply_transaction( trx, skip );
+      const flat_set<public_key_type>* keys = nullptr;
+      bool validated = false;
+      if( !prepared.empty() )
+      {
+         const prepared_transaction& p = prepared[_current_trx_in_block];
+         if( p.signature_keys.valid() )
+            keys = &*p.signature_keys;
+         validated = p.validated;
+      }
+      // skip flags were already set by apply_block()
+      _apply_transaction( trx, keys, hashes ? &hashes->transaction_ids[_current_trx_in_block] : nullptr, validated );
       // For real operations which are explicitly included in a transaction, virtual_op is 0.
       // For VOPs derived directly from a real op,
       //     use the real op's (block_num,trx_in_block,op_in_trx), virtual_op starts from 1.
@@ -545,28 +730,46 @@ void database::_apply_block( const signed_block& next_block )
       _current_op_in_trx  = 0;
       _current_virtual_op = 0;   
    }
+   phases.mark( execution_profiler::transactions );
 
    if (global_props.parameters.witness_schedule_algorithm == GRAPHENE_WITNESS_SCHEDULED_ALGORITHM)
+   {
        update_witness_schedule(next_block);
-   update_global_dynamic_data(next_block);
+       phases.mark( execution_profiler::witness_schedule );
+   }
+   update_global_dynamic_data(next_block, next_block_id);
    update_signing_witness(signing_witness, next_block);
    update_last_irreversible_block();
+   phases.mark( execution_profiler::global_dynamic_data );
 
    // Are we at the maintenance interval?
    if( maint_needed )
+   {
       perform_chain_maintenance(next_block, global_props);
+      phases.mark( execution_profiler::chain_maintenance );
+   }
    
    check_ending_lotteries();
+   phases.mark( execution_profiler::ending_lotteries );
    
-   create_block_summary(next_block);
+   create_block_summary(next_block, next_block_id);
+   phases.mark( execution_profiler::block_summary );
    place_delayed_bets(); // must happen after update_global_dynamic_data() updates the time
+   phases.mark( execution_profiler::delayed_bets );
    clear_expired_transactions();
+   phases.mark( execution_profiler::expired_transactions );
    clear_expired_proposals();
+   phases.mark( execution_profiler::expired_proposals );
    clear_expired_orders();
+   phases.mark( execution_profiler::expired_orders );
    update_expired_feeds();
+   phases.mark( execution_profiler::expired_feeds );
    update_withdraw_permissions();
+   phases.mark( execution_profiler::withdraw_permissions );
    update_tournaments();
+   phases.mark( execution_profiler::tournaments );
    update_betting_markets(next_block.timestamp);
+   phases.mark( execution_profiler::betting_markets );
 
    // n.b., update_maintenance_flag() happens this late
    // because get_slot_time() / get_slot_at_time() is needed above
@@ -574,16 +777,24 @@ void database::_apply_block( const signed_block& next_block )
    // update_global_dynamic_data() as perhaps these methods only need
    // to be called for header validation?
    update_maintenance_flag( maint_needed );
+   phases.mark( execution_profiler::maintenance_flag );
    if (global_props.parameters.witness_schedule_algorithm == GRAPHENE_WITNESS_SHUFFLED_ALGORITHM)
+   {
         update_witness_schedule();
+        phases.mark( execution_profiler::witness_schedule );
+   }
    if( !_node_property_object.debug_updates.empty() )
       apply_debug_updates();
 
    // notify observers that the block has been applied
    applied_block( next_block ); //emit
    _applied_ops.clear();
+   phases.mark( execution_profiler::applied_block_handlers );
 
    notify_changed_objects();
+   phases.mark( execution_profiler::changed_objects_handlers );
+   phases.finish();
+   _execution_profiler.record_block( next_block_num );
 } FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
 
 
@@ -598,16 +809,57 @@ processed_transaction database::apply_transaction(const signed_transaction& trx,
    return result;
 }
 
-processed_transaction database::_apply_transaction(const signed_transaction& trx)
+vector< database::prepared_transaction > database::prepare_transactions( const signed_block& next_block,
+                                                                        bool recover_keys )const
+{
+   vector< prepared_transaction > result;
+   if( !_thread_pool || next_block.transactions.size() < 2 )
+      return result;
+
+   // runs inside the undo session of the block, other tasks of this thread must not see the state meanwhile
+   ASSERT_TASK_NOT_PREEMPTED();
+   result.resize( next_block.transactions.size() );
+   const chain_id_type chain_id = get_chain_id();
+   _thread_pool->for_each_range( next_block.transactions.size(), [&]( size_t begin, size_t end )
+   {
+      for( size_t i = begin; i < end; ++i )
+      {
+         // leave a step undone if it fails, _apply_transaction() will repeat it and report the error
+         try
+         {
+            next_block.transactions[i].validate();
+            result[i].validated = true;
+         }
+         catch( const fc::exception& )
+         {
+         }
+         if( !recover_keys )
+            continue;
+         try
+         {
+            result[i].signature_keys = next_block.transactions[i].get_signature_keys( chain_id, _signature_key_cache );
+         }
+         catch( const fc::exception& )
+         {
+         }
+      }
+   });
+   return result;
+}
+
+processed_transaction database::_apply_transaction(const signed_transaction& trx,
+                                                   const flat_set<public_key_type>* signature_keys,
+                                                   const transaction_id_type* trx_id_hint,
+                                                   bool validated)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
 
-   if( true || !(skip&skip_validate) )   /* issue #505 explains why this skip_flag is disabled */
+   if( !validated )   /* issue #505 explains why skip_validate is not honored here */
       trx.validate();
 
    auto& trx_idx = get_mutable_index_type<transaction_index>();
    const chain_id_type& chain_id = get_chain_id();
-   auto trx_id = trx.id();
+   auto trx_id = trx_id_hint ? *trx_id_hint : trx.id();
    FC_ASSERT( (skip & skip_transaction_dupe_check) ||
               trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end() );
    transaction_evaluation_state eval_state(this);
@@ -618,7 +870,14 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    {
       auto get_active = [&]( account_id_type id ) { return &id(*this).active; };
       auto get_owner  = [&]( account_id_type id ) { return &id(*this).owner;  };
-      trx.verify_authority( chain_id, get_active, get_owner, get_global_properties().parameters.max_authority_depth );
+      flat_set<public_key_type> recovered_keys;
+      if( signature_keys == nullptr )
+      {
+         recovered_keys = trx.get_signature_keys( chain_id, _signature_key_cache );
+         signature_keys = &recovered_keys;
+      }
+      graphene::chain::verify_authority( trx.operations, *signature_keys, get_active, get_owner,
+                                         get_global_properties().parameters.max_authority_depth );
    }
 
    //Skip all manner of expiration and TaPoS checking if we're on block 1; It's impossible that the transaction is
@@ -680,7 +939,11 @@ operation_result database::apply_operation(transaction_evaluation_state& eval_st
    unique_ptr<op_evaluator>& eval = _operation_evaluators[ u_which ];
    FC_ASSERT( eval, "No registered evaluator for operation ${op}", ("op",op) );
    auto op_id = push_applied_operation( op );
+   const bool profiled = _execution_profiler.enabled();
+   const fc::time_point start = profiled ? fc::time_point::now() : fc::time_point();
    auto result = eval->evaluate( eval_state, op, true );
+   if( profiled )
+      _execution_profiler.record_operation( i_which, fc::time_point::now() - start );
    set_applied_operation_result( op_id, result );
    return result;
 } FC_CAPTURE_AND_RETHROW( (op) ) }
@@ -712,11 +975,11 @@ const witness_object& database::validate_block_header( uint32_t skip, const sign
    return witness;
 }
 
-void database::create_block_summary(const signed_block& next_block)
+void database::create_block_summary(const signed_block& next_block, const block_id_type& next_block_id)
 {
    block_summary_id_type sid(next_block.block_num() & 0xffff );
    modify( sid(*this), [&](block_summary_object& p) {
-         p.block_id = next_block.id();
+         p.block_id = next_block_id;
    });
 }
 
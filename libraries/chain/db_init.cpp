@@ -248,10 +248,12 @@ void database::initialize_evaluators()
 void database::initialize_indexes()
 {
    reset_indexes();
+   _deadline_scheduler.clear();
+   _vote_totals.clear();
    _undo_db.set_max_size( GRAPHENE_MIN_UNDO_HISTORY );
 
    //Protocol object indexes
-   add_index< primary_index<asset_index> >();
+   auto asset_idx = add_index< primary_index<asset_index> >();
    add_index< primary_index<force_settlement_index> >();
 
    auto acnt_index = add_index< primary_index<account_index> >();
@@ -260,14 +262,15 @@ void database::initialize_indexes()
 
    add_index< primary_index<committee_member_index> >();
    add_index< primary_index<witness_index> >();
-   add_index< primary_index<limit_order_index > >();
+   auto limit_order_idx = add_index< primary_index<limit_order_index > >();
    add_index< primary_index<call_order_index > >();
 
    auto prop_index = add_index< primary_index<proposal_index > >();
    prop_index->add_secondary_index<required_approval_index>();
 
-   add_index< primary_index<withdraw_permission_index > >();
-   add_index< primary_index<vesting_balance_index> >();
+   auto withdraw_permission_idx = add_index< primary_index<withdraw_permission_index > >();
+   auto vesting_balance_idx = add_index< primary_index<vesting_balance_index> >();
+   vesting_balance_idx->add_secondary_index<vesting_balance_holder_index>();
    add_index< primary_index<worker_index> >();
    add_index< primary_index<balance_index> >();
    add_index< primary_index<blinded_balance_index> >();
@@ -275,24 +278,25 @@ void database::initialize_indexes()
    add_index< primary_index<event_group_object_index > >();
    add_index< primary_index<event_object_index > >();
    add_index< primary_index<betting_market_rules_object_index > >();
-   add_index< primary_index<betting_market_group_object_index > >();
+   auto betting_market_group_idx = add_index< primary_index<betting_market_group_object_index > >();
    add_index< primary_index<betting_market_object_index > >();
-   add_index< primary_index<bet_object_index > >();
+   auto bet_idx = add_index< primary_index<bet_object_index > >();
+   bet_idx->add_secondary_index<bet_price_level_index>();
 
-   add_index< primary_index<tournament_index> >();
+   auto tournament_idx = add_index< primary_index<tournament_index> >();
    auto tournament_details_idx = add_index< primary_index<tournament_details_index> >();
    tournament_details_idx->add_secondary_index<tournament_players_index>();
    add_index< primary_index<match_index> >();
-   add_index< primary_index<game_index> >();
+   auto game_idx = add_index< primary_index<game_index> >();
 
    //Implementation object indexes
-   add_index< primary_index<transaction_index                             > >();
-   add_index< primary_index<account_balance_index                         > >();
+   auto transaction_idx = add_index< primary_index<transaction_index                             > >();
+   auto account_balance_idx = add_index< primary_index<account_balance_index                         > >();
    add_index< primary_index<asset_bitasset_data_index                     > >();
    add_index< primary_index<asset_dividend_data_object_index              > >();
    add_index< primary_index<simple_index<global_property_object          >> >();
    add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
-   add_index< primary_index<simple_index<account_statistics_object       >> >();
+   auto account_statistics_idx = add_index< primary_index<simple_index<account_statistics_object       >> >();
    add_index< primary_index<simple_index<asset_dynamic_data_object       >> >();
    add_index< primary_index<flat_index<  block_summary_object            >> >();
    add_index< primary_index<simple_index<chain_property_object          > > >();
@@ -311,6 +315,44 @@ void database::initialize_indexes()
    add_index< primary_index<lottery_balance_index                         > >();
    add_index< primary_index<sweeps_vesting_balance_index                  > >();
 
+   // The deadlines must match the conditions under which the tasks act, see deadline_scheduler
+   typedef deadline_scheduler ds;
+   typedef optional<time_point_sec> deadline;
+   // transactions are removed once the head block time has passed their expiration
+   _deadline_scheduler.track<transaction_object>( ds::expired_transactions, *transaction_idx,
+      []( const transaction_object& o ) { return deadline( o.trx.expiration + 1 ); } );
+   _deadline_scheduler.track<bet_object>( ds::delayed_bets, *bet_idx,
+      []( const bet_object& o ) { return o.end_of_delay; } );
+   _deadline_scheduler.track<proposal_object>( ds::expired_proposals, *prop_index,
+      []( const proposal_object& o ) { return deadline( o.expiration_time ); } );
+   _deadline_scheduler.track<limit_order_object>( ds::expired_limit_orders, *limit_order_idx,
+      []( const limit_order_object& o ) { return deadline( o.expiration ); } );
+   _deadline_scheduler.track<withdraw_permission_object>( ds::expired_withdraw_permissions, *withdraw_permission_idx,
+      []( const withdraw_permission_object& o ) { return deadline( o.expiration ); } );
+   _deadline_scheduler.track<tournament_object>( ds::tournament_deadlines, *tournament_idx,
+      []( const tournament_object& o ) -> deadline {
+         switch( o.get_state() )
+         {
+            case tournament_state::accepting_registrations:
+               return deadline( o.options.registration_deadline );
+            case tournament_state::awaiting_start:
+               return o.start_time;
+            default:
+               return deadline();
+         }
+      } );
+   _deadline_scheduler.track<game_object>( ds::game_timeouts, *game_idx,
+      []( const game_object& o ) { return o.next_timeout; } );
+   _deadline_scheduler.track<betting_market_group_object>( ds::betting_market_group_settlements, *betting_market_group_idx,
+      []( const betting_market_group_object& o ) { return o.settling_time; } );
+   _deadline_scheduler.track<asset_object>( ds::lottery_end_dates, *asset_idx,
+      []( const asset_object& o ) -> deadline {
+         if( o.is_lottery() && o.lottery_options->is_active )
+            return deadline( o.lottery_options->end_date );
+         return deadline();
+      } );
+
+   _vote_totals.track( *this, *acnt_index, *account_statistics_idx, *account_balance_idx, *vesting_balance_idx );
 }
 
 void database::init_genesis(const genesis_state_type& genesis_state)
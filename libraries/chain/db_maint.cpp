@@ -25,6 +25,7 @@
 #include <boost/multiprecision/integer.hpp>
 
 #include <fc/smart_ref_impl.hpp>
+#include <fc/thread/non_preemptable_scope_check.hpp>
 #include <fc/uint128.hpp>
 
 #include <graphene/chain/database.hpp>
@@ -44,11 +45,12 @@
 #include <graphene/chain/special_authority_object.hpp>
 #include <graphene/chain/vesting_balance_object.hpp>
 #include <graphene/chain/vote_count.hpp>
+#include <graphene/chain/vote_tally.hpp>
 #include <graphene/chain/witness_object.hpp>
 #include <graphene/chain/witness_schedule_object.hpp>
 #include <graphene/chain/worker_object.hpp>
 
-#define USE_VESTING_OBJECT_BY_ASSET_BALANCE_INDEX // vesting_balance_object by_asset_balance index needed
+#include <graphene/utilities/thread_pool.hpp>
 
 namespace graphene { namespace chain {
 
@@ -725,6 +727,12 @@ void deprecate_annual_members( database& db )
    return;
 }
 
+static const vesting_balance_holder_index& get_vesting_holder_index(const database& db)
+{
+   const auto& idx = dynamic_cast<const primary_index<vesting_balance_index>&>(db.get_index_type<vesting_balance_index>());
+   return idx.get_secondary_index<vesting_balance_holder_index>();
+}
+
 // Schedules payouts from a dividend distribution account to the current holders of the
 // dividend-paying asset.  This takes any deposits made to the dividend distribution account
 // since the last time it was called, and distributes them to the current owners of the
@@ -734,7 +742,7 @@ void schedule_pending_dividend_balances(database& db,
                                         const asset_dividend_data_object& dividend_data,
                                         const fc::time_point_sec& current_head_block_time, 
                                         const account_balance_index& balance_index,
-                                        const vesting_balance_index& vesting_index,
+                                        const vesting_balance_holder_index& vesting_holder_index,
                                         const total_distributed_dividend_balance_object_index& distributed_dividend_balance_index,
                                         const pending_dividend_payout_balance_for_holder_object_index& pending_payout_balance_index)
 { try {
@@ -760,34 +768,8 @@ void schedule_pending_dividend_balances(database& db,
    // the fee, in BTS, for distributing each asset in the account
    uint64_t total_fee_per_asset_in_core = distribution_base_fee + holder_account_count * (uint64_t)distribution_fee_per_holder;
 
-   std::map<account_id_type, share_type> vesting_amounts;
-#ifdef USE_VESTING_OBJECT_BY_ASSET_BALANCE_INDEX
-   // get only once a collection of accounts that hold nonzero vesting balances of the dividend asset
-   auto vesting_balances_begin =
-      vesting_index.indices().get<by_asset_balance>().lower_bound(boost::make_tuple(dividend_holder_asset_obj.id));
-   auto vesting_balances_end =
-      vesting_index.indices().get<by_asset_balance>().upper_bound(boost::make_tuple(dividend_holder_asset_obj.id, share_type()));
-   for (const vesting_balance_object& vesting_balance_obj : boost::make_iterator_range(vesting_balances_begin, vesting_balances_end))
-   {
-        vesting_amounts[vesting_balance_obj.owner] += vesting_balance_obj.balance.amount;
-        //dlog("Vesting balance for account: ${owner}, amount: ${amount}",
-        //     ("owner", vesting_balance_obj.owner(db).name)
-        //     ("amount", vesting_balance_obj.balance.amount));
-   }
-#else
-   // get only once a collection of accounts that hold nonzero vesting balances of the dividend asset
-   const auto& vesting_balances = vesting_index.indices().get<by_id>();
-   for (const vesting_balance_object& vesting_balance_obj : vesting_balances)
-   {
-        if (vesting_balance_obj.balance.asset_id == dividend_holder_asset_obj.id && vesting_balance_obj.balance.amount)
-        {
-            vesting_amounts[vesting_balance_obj.owner] += vesting_balance_obj.balance.amount;
-            dlog("Vesting balance for account: ${owner}, amount: ${amount}",
-                 ("owner", vesting_balance_obj.owner(db).name)
-                 ("amount", vesting_balance_obj.balance.amount));
-        }
-   }
-#endif
+   // the accounts that hold nonzero vesting balances of the dividend asset
+   const vesting_balance_holder_index::holder_map& vesting_amounts = vesting_holder_index.get_holders(dividend_holder_asset_obj.id);
 
    auto current_distribution_account_balance_iter = current_distribution_account_balance_range.first;
    auto previous_distribution_account_balance_iter = previous_distribution_account_balance_range.first;
@@ -970,11 +952,6 @@ void schedule_pending_dividend_balances(database& db,
                   }
                }
 
-               for (const auto& pending_payout : pending_payout_balance_index.indices())
-                  if (pending_payout.pending_balance.value)
-                      dlog("Pending payout: ${account_name}   ->   ${amount}",
-                           ("account_name", pending_payout.owner(db).name)
-                           ("amount", asset(pending_payout.pending_balance, pending_payout.dividend_payout_asset_type)));
                dlog("Remaining balance not paid out: ${amount}", 
                     ("amount", asset(remaining_amount_to_distribute, payout_asset_type)));
 
@@ -1066,7 +1043,7 @@ void process_dividend_assets(database& db)
    ilog("In process_dividend_assets time ${time}", ("time", db.head_block_time()));
 
    const account_balance_index& balance_index = db.get_index_type<account_balance_index>();
-   const vesting_balance_index& vbalance_index = db.get_index_type<vesting_balance_index>();
+   const vesting_balance_holder_index& vesting_holder_index = get_vesting_holder_index(db);
    const total_distributed_dividend_balance_object_index& distributed_dividend_balance_index = db.get_index_type<total_distributed_dividend_balance_object_index>();
    const pending_dividend_payout_balance_for_holder_object_index& pending_payout_balance_index = db.get_index_type<pending_dividend_payout_balance_for_holder_object_index>();
 
@@ -1080,7 +1057,7 @@ void process_dividend_assets(database& db)
          fc::time_point_sec current_head_block_time = db.head_block_time();
 
          schedule_pending_dividend_balances(db, dividend_holder_asset_obj, dividend_data, current_head_block_time,
-                                            balance_index, vbalance_index, distributed_dividend_balance_index, pending_payout_balance_index);
+                                            balance_index, vesting_holder_index, distributed_dividend_balance_index, pending_payout_balance_index);
          if (dividend_data.options.next_payout_time &&
              db.head_block_time() >= *dividend_data.options.next_payout_time)
          {
@@ -1231,48 +1208,45 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
 
    process_dividend_assets(*this);
 
+   if( _verify_vote_totals && !_vote_totals.matches_recount() )
+      elog( "The running vote totals do not match a recount at block ${b}", ("b", next_block.block_num()) );
+
+   /**
+    * The stake of an account is read right before the fees of the account are processed, as the fees of
+    * the accounts before it (by name) may have been paid to its cashback balance.  Everything else that
+    * is summed up does not change during the account maintenance, so it is gathered on the worker threads
+    * before, and the votes are added up on them after it.
+    */
    struct vote_tally_helper {
       database& d;
       const global_property_object& props;
-      std::map<account_id_type, share_type> vesting_amounts;
+      const vesting_balance_holder_index::holder_map& vesting_amounts;
+      vector<const account_object*> accounts;
+      vector<vote_tally::voter> voters;
+      size_t next = 0;
 
-      vote_tally_helper(database& d, const global_property_object& gpo)
-         : d(d), props(gpo)
+      vote_tally_helper(database& d, const global_property_object& gpo, graphene::utilities::thread_pool* pool)
+         : d(d), props(gpo), vesting_amounts(get_vesting_holder_index(d).get_holders(asset_id_type()))
       {
-         d._vote_tally_buffer.resize(props.next_available_vote_id);
-         d._witness_count_histogram_buffer.resize(props.parameters.maximum_witness_count / 2 + 1);
-         d._committee_count_histogram_buffer.resize(props.parameters.maximum_committee_count / 2 + 1);
-         d._total_voting_stake = 0;
-
-         const vesting_balance_index& vesting_index = d.get_index_type<vesting_balance_index>();
-#ifdef USE_VESTING_OBJECT_BY_ASSET_BALANCE_INDEX
-         auto vesting_balances_begin =
-              vesting_index.indices().get<by_asset_balance>().lower_bound(boost::make_tuple(asset_id_type()));
-         auto vesting_balances_end =
-              vesting_index.indices().get<by_asset_balance>().upper_bound(boost::make_tuple(asset_id_type(), share_type()));
-         for (const vesting_balance_object& vesting_balance_obj : boost::make_iterator_range(vesting_balances_begin, vesting_balances_end))
-         {
-            vesting_amounts[vesting_balance_obj.owner] += vesting_balance_obj.balance.amount;
-            //dlog("Vesting balance for account: ${owner}, amount: ${amount}",
-            //     ("owner", vesting_balance_obj.owner(d).name)
-            //     ("amount", vesting_balance_obj.balance.amount));
-         }
-#else
-         const auto& vesting_balances = vesting_index.indices().get<by_id>();
-         for (const vesting_balance_object& vesting_balance_obj : vesting_balances)
-         {
-            if (vesting_balance_obj.balance.asset_id == asset_id_type() && vesting_balance_obj.balance.amount)
-            {
-                vesting_amounts[vesting_balance_obj.owner] += vesting_balance_obj.balance.amount;
-                dlog("Vesting balance for account: ${owner}, amount: ${amount}",
-                     ("owner", vesting_balance_obj.owner(d).name)
-                     ("amount", vesting_balance_obj.balance.amount));
-            }
-         }
-#endif
+         const auto& by_name_idx = d.get_index_type<account_index>().indices().get<by_name>();
+         accounts.reserve( by_name_idx.size() );
+         for( const account_object& a : by_name_idx )
+            accounts.push_back( &a );
+         voters.resize( accounts.size() );
+
+         // the workers read the state of the block being applied, no other task may run meanwhile
+         ASSERT_TASK_NOT_PREEMPTED();
+         auto prepare = [this]( size_t begin, size_t end ) {
+            for( size_t i = begin; i < end; ++i )
+               prepare_voter( *accounts[i], voters[i] );
+         };
+         if( pool )
+            pool->for_each_range( accounts.size(), prepare );
+         else
+            prepare( 0, accounts.size() );
       }
 
-      void operator()(const account_object& stake_account) {
+      void prepare_voter(const account_object& stake_account, vote_tally::voter& v)const {
          if( props.parameters.count_non_member_votes || stake_account.is_member(d.head_block_time()) )
          {
             // There may be a difference between the account whose stake is voting and the one specifying opinions.
@@ -1286,51 +1260,35 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
             if( !opinion_account_ptr ) // skip non-exist account
                return;
 
-            const account_object& opinion_account = *opinion_account_ptr;
-
             const auto& stats = stake_account.statistics(d);
-            uint64_t voting_stake = stats.total_core_in_orders.value
-                  + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value: 0)
+            v.opinion = &opinion_account_ptr->options;
+            v.stake = stats.total_core_in_orders.value
                   + d.get_balance(stake_account.get_id(), asset_id_type()).amount.value;
 
             auto itr = vesting_amounts.find(stake_account.id);
             if (itr != vesting_amounts.end())
-                voting_stake += itr->second.value;
-            for( vote_id_type id : opinion_account.options.votes )
-            {
-               uint32_t offset = id.instance();
-               // if they somehow managed to specify an illegal offset, ignore it.
-               if( offset < d._vote_tally_buffer.size() )
-                  d._vote_tally_buffer[offset] += voting_stake;
-            }
+                v.stake += itr->second.value;
+         }
+      }
 
-            if( opinion_account.options.num_witness <= props.parameters.maximum_witness_count )
-            {
-               uint16_t offset = std::min(size_t(opinion_account.options.num_witness/2),
-                                          d._witness_count_histogram_buffer.size() - 1);
-               // votes for a number greater than maximum_witness_count
-               // are turned into votes for maximum_witness_count.
-               //
-               // in particular, this takes care of the case where a
-               // member was voting for a high number, then the
-               // parameter was lowered.
-               d._witness_count_histogram_buffer[offset] += voting_stake;
-            }
-            if( opinion_account.options.num_committee <= props.parameters.maximum_committee_count )
-            {
-               uint16_t offset = std::min(size_t(opinion_account.options.num_committee/2),
-                                          d._committee_count_histogram_buffer.size() - 1);
-               // votes for a number greater than maximum_committee_count
-               // are turned into votes for maximum_committee_count.
-               //
-               // same rationale as for witnesses
-               d._committee_count_histogram_buffer[offset] += voting_stake;
-            }
+      void operator()(const account_object& stake_account) {
+         assert( accounts[next] == &stake_account );
+         vote_tally::voter& v = voters[next++];
+         if( v.opinion && stake_account.cashback_vb.valid() )
+            v.stake += (*stake_account.cashback_vb)(d).balance.amount.value;
+      }
 
-            d._total_voting_stake += voting_stake;
-         }
+      void finish(graphene::utilities::thread_pool* pool) {
+         ASSERT_TASK_NOT_PREEMPTED();
+         vote_tally tally( props.next_available_vote_id, props.parameters.maximum_witness_count,
+                           props.parameters.maximum_committee_count );
+         tally.tally( voters, pool );
+         d._vote_tally_buffer.swap( tally.votes() );
+         d._witness_count_histogram_buffer.swap( tally.witness_histogram() );
+         d._committee_count_histogram_buffer.swap( tally.committee_histogram() );
+         d._total_voting_stake = tally.total_stake();
       }
-   } tally_helper(*this, gpo);
+   } tally_helper(*this, gpo, _thread_pool.get());
    struct process_fees_helper {
       database& d;
       const global_property_object& props;
@@ -1347,6 +1305,7 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
       tally_helper,
       fee_helper
       ));
+   tally_helper.finish(_thread_pool.get());
 
    struct clear_canary {
       clear_canary(vector<uint64_t>& target): target(target){}
@@ -27,7 +27,10 @@
 #include <graphene/chain/operation_history_object.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
+#include <graphene/utilities/thread_pool.hpp>
+
 #include <fc/io/fstream.hpp>
+#include <fc/smart_ref_impl.hpp>
 
 #include <fstream>
 #include <functional>
@@ -35,6 +38,135 @@
 
 namespace graphene { namespace chain {
 
+namespace detail {
+
+   /**
+    * Feeds blocks to reindex().  With a worker pool, blocks are read, unpacked and hashed on the
+    * worker threads a batch ahead of the block being applied, so the chain thread only applies
+    * them.  The mapped block_database backend is safe to read concurrently and is shared by all
+    * workers; with the stream backend each worker reads through its own block_database, so readers
+    * never share a stream position with each other or with the chain thread.
+    */
+   class block_prefetcher
+   {
+      public:
+         struct item
+         {
+            optional<signed_block>             block;
+            optional<database::block_hashes>   hashes;
+         };
+
+         block_prefetcher( graphene::utilities::thread_pool* pool, const block_database& blocks,
+                           const fc::path& block_dir, uint32_t first_block_num, uint32_t last_block_num )
+            : _pool( pool ), _blocks( blocks ), _last_block_num( last_block_num ), _next_block_num( first_block_num ),
+              _readers( std::make_shared< vector< unique_ptr<block_database> > >() )
+         {
+            if( _pool == nullptr )
+               return;
+            if( _blocks.backend() == block_database::stream_backend )
+            {
+               for( uint32_t i = 0; i < _pool->size(); ++i )
+               {
+                  _readers->emplace_back( new block_database( block_database::stream_backend ) );
+                  _readers->back()->open( block_dir );
+               }
+            }
+            prefetch_next_batch();
+         }
+
+         ~block_prefetcher()
+         {
+            try
+            {
+               stop();
+            }
+            catch( const fc::exception& e )
+            {
+               wlog( "error while prefetching blocks: ${e}", ("e", e.to_detail_string()) );
+            }
+         }
+
+         /// @return the next block, which remains valid until the next call
+         const item& next()
+         {
+            if( _pool == nullptr )
+            {
+               _current.resize( 1 );
+               _current[0].block = _blocks.read_by_number( _next_block_num++ );
+               return _current[0];
+            }
+            if( _position == _current.size() )
+            {
+               FC_ASSERT( _pending, "no more blocks to prefetch" );
+               wait_for_pending();
+               _current = std::move( *_pending );
+               _pending.reset();
+               _position = 0;
+               prefetch_next_batch();
+            }
+            return _current[_position++];
+         }
+
+         /// Waits for outstanding reads, after which the block files may be modified again
+         void stop()
+         {
+            wait_for_pending();
+            _pending.reset();
+         }
+
+      private:
+         void prefetch_next_batch()
+         {
+            const uint32_t batch_size = 1000;
+            if( _next_block_num > _last_block_num )
+               return;
+            const uint32_t first = _next_block_num;
+            const uint32_t count = std::min( batch_size, _last_block_num - first + 1 );
+            _next_block_num += count;
+
+            auto batch = std::make_shared< vector<item> >( count );
+            auto readers = _readers;
+            const uint32_t ranges = std::min<uint32_t>( count, _pool->size() );
+            for( uint32_t r = 0; r < ranges; ++r )
+            {
+               const uint32_t begin = count * r / ranges;
+               const uint32_t end   = count * (r + 1) / ranges;
+               const block_database* reader = readers->empty() ? &_blocks : (*readers)[r].get();
+               _pending_reads.push_back( _pool->async( [batch,readers,reader,first,begin,end]()
+               {
+                  for( uint32_t i = begin; i < end; ++i )
+                  {
+                     item& it = (*batch)[i];
+                     it.block = reader->read_by_number( first + i );
+                     if( it.block.valid() )
+                        it.hashes = database::compute_block_hashes( *it.block );
+                  }
+               }, "prefetch blocks" ) );
+            }
+            _pending = batch;
+         }
+
+         void wait_for_pending()
+         {
+            vector< fc::future<void> > reads = std::move( _pending_reads );
+            _pending_reads.clear();
+            graphene::utilities::thread_pool::wait_all( reads );
+         }
+
+         graphene::utilities::thread_pool*                       _pool;
+         const block_database&                                   _blocks;
+         const uint32_t                                          _last_block_num;
+         uint32_t                                                _next_block_num;
+         std::shared_ptr< vector< unique_ptr<block_database> > > _readers;
+
+         vector<item>                                            _current;
+         size_t                                                  _position = 0;
+         std::shared_ptr< vector<item> >                         _pending;
+         vector< fc::future<void> >                              _pending_reads;
+   };
+
+} // detail
+
 database::database() :
    _random_number_generator(fc::ripemd160().data())
 {
@@ -50,33 +182,51 @@ database::~database()
 void database::reindex(fc::path data_dir, const genesis_state_type& initial_allocation)
 { try {
    ilog( "reindexing blockchain" );
+   // check before wipe(), the state is all that is left of the blocks a pruned block log has deleted
+   {
+      const bool was_open = _block_id_to_block.is_open();
+      if( !was_open )
+         _block_id_to_block.open( data_dir / "database" / "block_num_to_block" );
+      const uint32_t first_retained = _block_id_to_block.first_retained_block_num();
+      if( !was_open )
+         _block_id_to_block.close();
+      FC_ASSERT( first_retained <= 1, "Unable to replay a pruned block log, blocks before ${n} have been deleted",
+                 ("n", first_retained) );
+   }
    wipe(data_dir, false);
-   open(data_dir, [&initial_allocation]{return initial_allocation;});
 
    auto start = fc::time_point::now();
-   auto last_block = _block_id_to_block.last();
-   if( !last_block ) {
+   // open() replays the whole block log onto the genesis state
+   open(data_dir, [&initial_allocation]{return initial_allocation;});
+   if( !_block_id_to_block.last() ) {
       elog( "!no last block" );
-      edump((last_block));
       return;
    }
+   auto end = fc::time_point::now();
+   ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
+} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
-   const auto last_block_num = last_block->block_num();
-
+void database::replay_blocks( const fc::path& data_dir, uint32_t first_block_num, uint32_t last_block_num )
+{ try {
    ilog( "Replaying blocks..." );
    // Right now, we leave undo_db enabled when replaying when the bookie plugin is 
    // enabled.  It depends on new/changed/removed object notifications, and those are 
    // only fired when the undo_db is enabled
    if (!_slow_replays)
       _undo_db.disable();
-   for( uint32_t i = 1; i <= last_block_num; ++i )
+   detail::block_prefetcher prefetcher( _thread_pool.get(), _block_id_to_block,
+                                        data_dir / "database" / "block_num_to_block",
+                                        first_block_num, last_block_num );
+   for( uint32_t i = first_block_num; i <= last_block_num; ++i )
    {
-      if( i == 1 || 
+      if( i == first_block_num || 
           i % 10000 == 0 ) 
          std::cerr << "   " << double(i*100)/last_block_num << "%   "<< i << " of " <<last_block_num<<"   \n";
-      fc::optional< signed_block > block = _block_id_to_block.fetch_by_number(i);
+      const auto& prefetched = prefetcher.next();
+      const fc::optional< signed_block >& block = prefetched.block;
       if( !block.valid() )
       {
+         prefetcher.stop();
          wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
          uint32_t dropped_count = 0;
          while( true )
@@ -108,13 +258,12 @@ void database::reindex(fc::path data_dir, const genesis_state_type& initial_allo
                              skip_transaction_dupe_check |
                              skip_tapos_check |
                              skip_witness_schedule_check |
-                             skip_authority_check);
+                             skip_authority_check,
+                     prefetched.hashes.valid() ? &*prefetched.hashes : nullptr);
    }
    if (!_slow_replays)
      _undo_db.enable();
-   auto end = fc::time_point::now();
-   ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
-} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+} FC_CAPTURE_AND_RETHROW( (data_dir)(first_block_num)(last_block_num) ) }
 
 void database::wipe(const fc::path& data_dir, bool include_blocks)
 {
@@ -141,6 +290,20 @@ void database::open(
       fc::optional<signed_block> last_block = _block_id_to_block.last();
       if( last_block.valid() )
       {
+         // The state is a checkpoint saved before an unclean shutdown, or the genesis state if there was no
+         // usable checkpoint or the state was wiped by reindex(): catch up with the block log
+         if( last_block->block_num() > head_block_num() )
+         {
+            FC_ASSERT( _block_id_to_block.first_retained_block_num() <= head_block_num() + 1,
+                       "The block log has been pruned past the saved state, blocks before ${n} have been deleted",
+                       ("n", _block_id_to_block.first_retained_block_num()) );
+            FC_ASSERT( head_block_num() == 0 || _block_id_to_block.fetch_block_id( head_block_num() ) == head_block_id(),
+                       "The block log is on a different fork than the saved state" );
+            ilog( "Replaying blocks ${f} to ${l} after the saved state",
+                  ("f", head_block_num() + 1)("l", last_block->block_num()) );
+            replay_blocks( data_dir, head_block_num() + 1, last_block->block_num() );
+            last_block = _block_id_to_block.last();
+         }
          _fork_db.start_block( *last_block );
          if( last_block->id() != head_block_id() )
          {
@@ -154,6 +317,8 @@ void database::open(
 
 void database::close(bool rewind)
 {
+   // readers on other threads must not use the block log or the fork database while they are closed
+   read_write_lock::write_guard write( _read_write_lock );
    // TODO:  Save pending tx's on close()
    clear_pending();
 
@@ -200,6 +365,38 @@ void database::close(bool rewind)
    _fork_db.reset();
 }
 
+void database::set_worker_threads( uint32_t num_threads )
+{
+   if( num_threads > 1 )
+   {
+      ilog( "using ${n} worker threads", ("n", num_threads) );
+      _thread_pool.reset( new graphene::utilities::thread_pool( num_threads, "chain-worker" ) );
+   }
+   else
+      _thread_pool.reset();
+   set_thread_pool( _thread_pool.get() );
+}
+
+void database::set_block_log_retain( uint32_t num_blocks )
+{
+   FC_ASSERT( num_blocks == 0 || num_blocks >= GRAPHENE_MAX_UNDO_HISTORY,
+              "must retain at least ${n} blocks", ("n", GRAPHENE_MAX_UNDO_HISTORY) );
+   if( num_blocks > 0 )
+   {
+      ilog( "keeping only the last ${n} blocks", ("n", num_blocks) );
+      _block_id_to_block.enable_segments( num_blocks );
+   }
+}
+
+void database::set_state_checkpoint_interval( uint32_t num_blocks )
+{
+   if( num_blocks > 0 )
+      ilog( "saving a state checkpoint every ${n} blocks", ("n", num_blocks) );
+   _state_checkpoint_interval = num_blocks;
+   if( num_blocks > 0 )
+      set_incremental_save( true );
+}
+
 void database::force_slow_replays()
 {
    ilog("enabling slow replays");
@@ -208,16 +405,20 @@ void database::force_slow_replays()
 
 void database::check_ending_lotteries()
 {
+   if( !_deadline_scheduler.is_due( deadline_scheduler::lottery_end_dates, head_block_time() ) )
+      return;
    try {
-      const auto& lotteries_idx = get_index_type<asset_index>().indices().get<active_lotteries>();      
-      for( auto checking_asset: lotteries_idx )
-      {
-         FC_ASSERT( checking_asset.is_lottery() );
-         FC_ASSERT( checking_asset.lottery_options->is_active );
-         FC_ASSERT( checking_asset.lottery_options->end_date != time_point_sec() );
-         if( checking_asset.lottery_options->end_date > head_block_time() ) continue;
-         checking_asset.end_lottery(*this);
-      }
+      // Active lotteries are sorted by decreasing end date, so this is the one that ends last of those
+      // whose end date has arrived.  Ending it moves it out of the active lotteries, the others are
+      // ended in the following blocks.
+      const auto& lotteries_idx = get_index_type<asset_index>().indices().get<active_lotteries>();
+      auto itr = lotteries_idx.lower_bound( head_block_time() );
+      if( itr == lotteries_idx.end() || !itr->is_lottery() || !itr->lottery_options->is_active )
+         return;
+      FC_ASSERT( itr->lottery_options->end_date != time_point_sec() );
+      // end_lottery() adjusts the winning tickets of the object it is called on
+      asset_object checking_asset = *itr;
+      checking_asset.end_lottery(*this);
    } catch( ... ) {}
 }
 
@@ -400,6 +400,11 @@ void get_relevant_accounts( const object* obj, flat_set<account_id_type>& accoun
               assert( aobj != nullptr );
               accounts.insert( aobj->owner );
               break;
+           } case impl_pending_dividend_payout_balance_for_holder_object_type:{
+              const auto& aobj = dynamic_cast<const pending_dividend_payout_balance_for_holder_object*>(obj);
+              assert( aobj != nullptr );
+              accounts.insert( aobj->owner );
+              break;
            } case impl_transaction_object_type:{
               const auto& aobj = dynamic_cast<const transaction_object*>(obj);
               assert( aobj != nullptr );
@@ -433,6 +438,19 @@ void get_relevant_accounts( const object* obj, flat_set<account_id_type>& accoun
 
 namespace graphene { namespace chain {
 
+const flat_set<account_id_type>& impacted_account_set::get()const
+{
+   if( !_accounts.valid() )
+   {
+      flat_set<account_id_type> accounts;
+      for( const object* obj : _objects )
+         if( obj != nullptr )
+            get_relevant_accounts( obj, accounts );
+      _accounts = std::move( accounts );
+   }
+   return *_accounts;
+}
+
 void database::notify_changed_objects()
 { try {
    if( _undo_db.enabled() ) 
@@ -443,30 +461,28 @@ void database::notify_changed_objects()
       if( !new_objects.empty() )
       {
         vector<object_id_type> new_ids;  new_ids.reserve(head_undo.new_ids.size());
-        flat_set<account_id_type> new_accounts_impacted;
+        vector<const object*> new_objs;  new_objs.reserve(head_undo.new_ids.size());
         for( const auto& item : head_undo.new_ids )
         {
-          new_ids.push_back(item);
-          auto obj = find_object(item);
-          if(obj != nullptr)
-            get_relevant_accounts(obj, new_accounts_impacted);
+          new_ids.push_back(item.first);
+          new_objs.push_back(find_object(item.first));
         }
 
-        new_objects(new_ids, new_accounts_impacted);
+        new_objects(new_ids, impacted_account_set(std::move(new_objs)));
       }
 
       // Changed
       if( !changed_objects.empty() )
       {
         vector<object_id_type> changed_ids;  changed_ids.reserve(head_undo.old_values.size());
-        flat_set<account_id_type> changed_accounts_impacted;
+        vector<const object*> old_values;    old_values.reserve(head_undo.old_values.size());
         for( const auto& item : head_undo.old_values )
         {
           changed_ids.push_back(item.first);
-          get_relevant_accounts(item.second.get(), changed_accounts_impacted);
+          old_values.push_back(item.second.get());
         }
 
-        changed_objects(changed_ids, changed_accounts_impacted);
+        changed_objects(changed_ids, impacted_account_set(std::move(old_values)));
       }
 
       // Removed
@@ -474,18 +490,36 @@ void database::notify_changed_objects()
       {
         vector<object_id_type> removed_ids; removed_ids.reserve( head_undo.removed.size() );
         vector<const object*> removed; removed.reserve( head_undo.removed.size() );
-        flat_set<account_id_type> removed_accounts_impacted;
         for( const auto& item : head_undo.removed )
         {
           removed_ids.emplace_back( item.first );
-          auto obj = item.second.get();
-          removed.emplace_back( obj );
-          get_relevant_accounts(obj, removed_accounts_impacted);
+          removed.emplace_back( item.second.get() );
         }
 
-        removed_objects(removed_ids, removed, removed_accounts_impacted);
+        removed_objects(removed_ids, removed, impacted_account_set(vector<const object*>(removed)));
       }
    }
 } FC_CAPTURE_AND_LOG( (0) ) }
 
+void database::notify_pending_objects_changed()
+{ try {
+   if( pending_objects_changed.empty() || !_undo_db.enabled() )
+      return;
+
+   const auto& head_undo = _undo_db.head();
+   vector<const object*> objs;
+   for( const auto& item : head_undo.new_ids )
+      objs.push_back( find_object( item.first ) );
+   // a changed object impacts the accounts of its old and of its new value, e.g. the old and the new issuer
+   for( const auto& item : head_undo.old_values )
+   {
+      objs.push_back( item.second.get() );
+      objs.push_back( find_object( item.first ) );
+   }
+   for( const auto& item : head_undo.removed )
+      objs.push_back( item.second.get() );
+
+   pending_objects_changed( impacted_account_set( std::move( objs ) ) );
+} FC_CAPTURE_AND_LOG( (0) ) }
+
 } }
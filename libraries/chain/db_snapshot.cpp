@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/snapshot.hpp>
+
+#include <graphene/utilities/thread_pool.hpp>
+
+#include <fc/interprocess/file_mapping.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/thread/non_preemptable_scope_check.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+namespace graphene { namespace chain {
+
+void database::save_snapshot( const fc::path& dest )const
+{ try {
+   ASSERT_TASK_NOT_PREEMPTED();
+   auto start = fc::time_point::now();
+   const vector<const graphene::db::index*> indexes = get_indexes();
+
+   snapshot_header header;
+   header.chain_id = get_chain_id();
+   auto head_block = fetch_block_by_id( head_block_id() );
+   FC_ASSERT( head_block.valid(), "Unable to find the head block" );
+   header.head_block = std::move( *head_block );
+   header.section_count = indexes.size();
+
+   struct section
+   {
+      snapshot_section_header header;
+      vector<char>            data;
+   };
+   vector<section> sections( indexes.size() );
+   auto pack_section = [&indexes,&sections]( size_t i )
+   {
+      section& s = sections[i];
+      s.header.space_id = indexes[i]->object_space_id();
+      s.header.type_id  = indexes[i]->object_type_id();
+      s.data            = indexes[i]->pack_snapshot( s.header.object_count );
+      s.header.size     = s.data.size();
+      s.header.checksum = fc::sha256::hash( s.data.data(), s.data.size() );
+   };
+
+   // Pack a batch of sections on the worker threads, write it out in order, then move on to the next batch.
+   // for_each_range() blocks this thread without yielding, so no block or transaction is applied to the
+   // indexes while they are packed and the memory held is bounded by one batch.
+   const size_t batch_size = _thread_pool ? _thread_pool->size() : 1;
+   const fc::path tmp = dest.generic_string() + ".tmp";
+   std::ofstream out( tmp.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+   FC_ASSERT( out, "Unable to open ${f}", ("f", tmp) );
+   fc::raw::pack( out, header );
+   for( size_t first = 0; first < sections.size(); first += batch_size )
+   {
+      const size_t count = std::min( batch_size, sections.size() - first );
+      auto pack_range = [&pack_section,first]( size_t begin, size_t end )
+      {
+         for( size_t i = begin; i < end; ++i )
+            pack_section( first + i );
+      };
+      if( _thread_pool )
+         _thread_pool->for_each_range( count, pack_range );
+      else
+         pack_range( 0, count );
+      for( size_t i = first; i < first + count; ++i )
+      {
+         fc::raw::pack( out, sections[i].header );
+         out.write( sections[i].data.data(), sections[i].data.size() );
+         vector<char>().swap( sections[i].data );
+      }
+   }
+   out.close();
+   FC_ASSERT( out, "Error writing ${f}", ("f", tmp) );
+   fc::rename( tmp, dest );
+
+   ilog( "Wrote snapshot of ${n} indexes at block ${b} to ${d} in ${t} ms",
+         ("n", sections.size())("b", header.head_block.block_num())("d", dest)
+         ("t", (fc::time_point::now() - start).count() / 1000) );
+} FC_CAPTURE_AND_RETHROW( (dest) ) }
+
+void database::open_from_snapshot( const fc::path& data_dir, const fc::path& snapshot )
+{ try {
+   ilog( "Bootstrapping from snapshot ${s}", ("s", snapshot) );
+   auto start = fc::time_point::now();
+
+   wipe( data_dir, false );
+   object_database::open( data_dir );
+   FC_ASSERT( !find( global_property_id_type() ), "Object database was not wiped" );
+
+   fc::file_mapping fm( snapshot.generic_string().c_str(), fc::read_only );
+   fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size( snapshot ) );
+   fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
+
+   snapshot_header header;
+   fc::raw::unpack( ds, header );
+   FC_ASSERT( header.magic == snapshot_header::current_magic, "Not a snapshot, or written in an unsupported format" );
+
+   vector< std::pair<snapshot_section_header,const char*> > sections;
+   sections.reserve( header.section_count );
+   for( uint32_t i = 0; i < header.section_count; ++i )
+   {
+      snapshot_section_header section;
+      fc::raw::unpack( ds, section );
+      FC_ASSERT( ds.remaining() >= section.size, "Snapshot is truncated" );
+      sections.emplace_back( section, ds.pos() );
+      ds.skip( section.size );
+   }
+
+   auto verify = [&sections]( size_t begin, size_t end )
+   {
+      for( size_t i = begin; i < end; ++i )
+         FC_ASSERT( fc::sha256::hash( sections[i].second, sections[i].first.size ) == sections[i].first.checksum,
+                    "Checksum mismatch in snapshot section ${s}.${t}",
+                    ("s", sections[i].first.space_id)("t", sections[i].first.type_id) );
+   };
+   if( _thread_pool )
+      _thread_pool->for_each_range( sections.size(), verify );
+   else
+      verify( 0, sections.size() );
+
+   for( const auto& section : sections )
+   {
+      const auto& h = section.first;
+      const graphene::db::index* idx = nullptr;
+      for( const graphene::db::index* i : get_indexes() )
+         if( i->object_space_id() == h.space_id && i->object_type_id() == h.type_id )
+            idx = i;
+      if( idx == nullptr )
+      {
+         wlog( "Skipping snapshot section ${s}.${t}, no such index is registered", ("s", h.space_id)("t", h.type_id) );
+         continue;
+      }
+      auto loaded = get_mutable_index( h.space_id, h.type_id ).unpack_snapshot( section.second, h.size );
+      FC_ASSERT( loaded == h.object_count, "Snapshot section ${s}.${t} holds ${l} objects instead of ${n}",
+                 ("s", h.space_id)("t", h.type_id)("l", loaded)("n", h.object_count) );
+   }
+   FC_ASSERT( get_chain_id() == header.chain_id, "Snapshot is of another chain" );
+   FC_ASSERT( head_block_id() == header.head_block.id(), "Snapshot state does not match its head block" );
+   ilog( "Loaded state at block ${b} in ${t} ms",
+         ("b", head_block_num())("t", (fc::time_point::now() - start).count() / 1000) );
+   // incremental saves only know about changes made from now on
+   object_database::flush();
+
+   // blocks before the snapshot are not needed any more, so a new block log starts out segmented; an existing
+   // one is kept in its layout, converting it would copy every block
+   const fc::path block_dir = data_dir / "database" / "block_num_to_block";
+   if( _block_id_to_block.backend() != block_database::segmented_backend && !fc::exists( block_dir ) )
+      _block_id_to_block.enable_segments( 0 );
+   _block_id_to_block.open( block_dir );
+   if( !_block_id_to_block.contains( head_block_id() ) )
+      _block_id_to_block.store( head_block_id(), header.head_block );
+
+   auto last_block = _block_id_to_block.last();
+   FC_ASSERT( last_block.valid() );
+   if( last_block->block_num() > head_block_num() )
+   {
+      FC_ASSERT( _block_id_to_block.fetch_block_id( head_block_num() ) == head_block_id(),
+                 "The block log is on a different fork than the snapshot" );
+      replay_blocks( data_dir, head_block_num() + 1, last_block->block_num() );
+      last_block = _block_id_to_block.last();
+   }
+   _fork_db.start_block( *last_block );
+   FC_ASSERT( last_block->id() == head_block_id() );
+
+   ilog( "Done bootstrapping from snapshot, elapsed time: ${t} sec",
+         ("t", double((fc::time_point::now() - start).count()) / 1000000.0) );
+} FC_CAPTURE_AND_RETHROW( (data_dir)(snapshot) ) }
+
+} } // graphene::chain
@@ -43,7 +43,7 @@
 
 namespace graphene { namespace chain {
 
-void database::update_global_dynamic_data( const signed_block& b )
+void database::update_global_dynamic_data( const signed_block& b, const block_id_type& b_id )
 {
    const dynamic_global_property_object& _dgp = dynamic_global_property_id_type(0)(*this);
    const global_property_object& gpo = get_global_properties();
@@ -99,7 +99,7 @@ void database::update_global_dynamic_data( const signed_block& b )
          dgp.recently_missed_count--;
 
       dgp.head_block_number = b.block_num();
-      dgp.head_block_id = b.id();
+      dgp.head_block_id = b_id;
       dgp.time = b.timestamp;
       dgp.current_witness = b.witness;
       dgp.recent_slots_filled = (
@@ -183,10 +183,16 @@ void database::clear_expired_transactions()
 { try {
    //Look for expired transactions in the deduplication list, and remove them.
    //Transactions must have expired by at least two forking windows in order to be removed.
-   auto& transaction_idx = static_cast<transaction_index&>(get_mutable_index(implementation_ids, impl_transaction_object_type));
-   const auto& dedupe_index = transaction_idx.indices().get<by_expiration>();
-   while( (!dedupe_index.empty()) && (head_block_time() > dedupe_index.begin()->trx.expiration) )
-      transaction_idx.remove(*dedupe_index.begin());
+   if( _deadline_scheduler.is_due( deadline_scheduler::expired_transactions, head_block_time() ) )
+   {
+      auto& transaction_idx = static_cast<transaction_index&>(get_mutable_index(implementation_ids, impl_transaction_object_type));
+      const auto& dedupe_index = transaction_idx.indices().get<by_expiration>();
+      while( (!dedupe_index.empty()) && (head_block_time() > dedupe_index.begin()->trx.expiration) )
+         transaction_idx.remove(*dedupe_index.begin());
+   }
+
+   // expired transactions can't be applied anymore, so their recovered signature keys aren't needed either
+   _signature_key_cache.remove_expired( head_block_time() );
 } FC_CAPTURE_AND_RETHROW() }
 
 void database::place_delayed_bets()
@@ -196,6 +202,8 @@ void database::place_delayed_bets()
 
    // Delayed bets are sorted to the beginning of the order book, so if there are any bets that need placing, 
    // they're right at the front of the book
+   if( !_deadline_scheduler.is_due( deadline_scheduler::delayed_bets, head_block_time() ) )
+      return;
    const auto& bet_odds_idx = get_index_type<bet_object_index>().indices().get<by_odds>();
    auto iter = bet_odds_idx.begin();
 
@@ -237,6 +245,8 @@ void database::place_delayed_bets()
 
 void database::clear_expired_proposals()
 {
+   if( !_deadline_scheduler.is_due( deadline_scheduler::expired_proposals, head_block_time() ) )
+      return;
    const auto& proposal_expiration_index = get_index_type<proposal_index>().indices().get<by_expiration>();
    while( !proposal_expiration_index.empty() && proposal_expiration_index.begin()->expiration_time <= head_block_time() )
    {
@@ -325,35 +335,37 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
 
 void database::clear_expired_orders()
 { try {
-   detail::with_skip_flags( *this,
-      get_node_properties().skip_flags | skip_authority_check, [&](){
-         transaction_evaluation_state cancel_context(this);
-
-         //Cancel expired limit orders
-         auto& limit_index = get_index_type<limit_order_index>().indices().get<by_expiration>();
-         while( !limit_index.empty() && limit_index.begin()->expiration <= head_block_time() )
-         {
-            limit_order_cancel_operation canceler;
-            const limit_order_object& order = *limit_index.begin();
-            canceler.fee_paying_account = order.seller;
-            canceler.order = order.id;
-            canceler.fee = current_fee_schedule().calculate_fee( canceler );
-            if( canceler.fee.amount > order.deferred_fee )
+   if( _deadline_scheduler.is_due( deadline_scheduler::expired_limit_orders, head_block_time() ) )
+      detail::with_skip_flags( *this,
+         get_node_properties().skip_flags | skip_authority_check, [&](){
+            transaction_evaluation_state cancel_context(this);
+
+            //Cancel expired limit orders
+            auto& limit_index = get_index_type<limit_order_index>().indices().get<by_expiration>();
+            while( !limit_index.empty() && limit_index.begin()->expiration <= head_block_time() )
             {
-               // Cap auto-cancel fees at deferred_fee; see #549
-               wlog( "At block ${b}, fee for clearing expired order ${oid} was capped at deferred_fee ${fee}", ("b", head_block_num())("oid", order.id)("fee", order.deferred_fee) );
-               canceler.fee = asset( order.deferred_fee, asset_id_type() );
+               limit_order_cancel_operation canceler;
+               const limit_order_object& order = *limit_index.begin();
+               canceler.fee_paying_account = order.seller;
+               canceler.order = order.id;
+               canceler.fee = current_fee_schedule().calculate_fee( canceler );
+               if( canceler.fee.amount > order.deferred_fee )
+               {
+                  // Cap auto-cancel fees at deferred_fee; see #549
+                  wlog( "At block ${b}, fee for clearing expired order ${oid} was capped at deferred_fee ${fee}", ("b", head_block_num())("oid", order.id)("fee", order.deferred_fee) );
+                  canceler.fee = asset( order.deferred_fee, asset_id_type() );
+               }
+               // we know the fee for this op is set correctly since it is set by the chain.
+               // this allows us to avoid a hung chain:
+               // - if #549 case above triggers
+               // - if the fee is incorrect, which may happen due to #435 (although since cancel is a fixed-fee op, it shouldn't)
+               cancel_context.skip_fee_schedule_check = true;
+               apply_operation(cancel_context, canceler);
             }
-            // we know the fee for this op is set correctly since it is set by the chain.
-            // this allows us to avoid a hung chain:
-            // - if #549 case above triggers
-            // - if the fee is incorrect, which may happen due to #435 (although since cancel is a fixed-fee op, it shouldn't)
-            cancel_context.skip_fee_schedule_check = true;
-            apply_operation(cancel_context, canceler);
-         }
-     });
+        });
 
    //Process expired force settlement orders
+   //These are not scheduled by their settlement date, as they are also canceled after a black swan
    auto& settlement_index = get_index_type<force_settlement_index>().indices().get<by_expiration>();
    if( !settlement_index.empty() )
    {
@@ -538,6 +550,8 @@ void database::update_maintenance_flag( bool new_maintenance_flag )
 
 void database::update_withdraw_permissions()
 {
+   if( !_deadline_scheduler.is_due( deadline_scheduler::expired_withdraw_permissions, head_block_time() ) )
+      return;
    auto& permit_index = get_index_type<withdraw_permission_index>().indices().get<by_expiration>();
    while( !permit_index.empty() && permit_index.begin()->expiration <= head_block_time() )
       remove(*permit_index.begin());
@@ -648,11 +662,15 @@ void database::update_tournaments()
    // - Process games
    process_finished_games(*this);
    process_finished_matches(*this);
-   cancel_expired_tournaments(*this);
-   start_fully_registered_tournaments(*this);
+   if( _deadline_scheduler.is_due( deadline_scheduler::tournament_deadlines, head_block_time() ) )
+   {
+      cancel_expired_tournaments(*this);
+      start_fully_registered_tournaments(*this);
+   }
    process_in_progress_tournaments(*this);
    initiate_next_round_of_matches(*this);
-   initiate_next_games(*this);
+   if( _deadline_scheduler.is_due( deadline_scheduler::game_timeouts, head_block_time() ) )
+      initiate_next_games(*this);
 }
 
 void process_settled_betting_markets(database& db, fc::time_point_sec current_block_time)
@@ -676,7 +694,8 @@ void process_settled_betting_markets(database& db, fc::time_point_sec current_bl
 
 void database::update_betting_markets(fc::time_point_sec current_block_time)
 {
-   process_settled_betting_markets(*this, current_block_time);
+   if( _deadline_scheduler.is_due( deadline_scheduler::betting_market_group_settlements, current_block_time ) )
+      process_settled_betting_markets(*this, current_block_time);
    remove_completed_events();
 }
 
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/deadline_scheduler.hpp>
+
+namespace graphene { namespace chain {
+
+namespace {
+   void erase_one( std::multiset<time_point_sec>& deadlines, time_point_sec deadline )
+   {
+      auto itr = deadlines.find( deadline );
+      assert( itr != deadlines.end() );
+      if( itr != deadlines.end() )
+         deadlines.erase( itr );
+   }
+}
+
+void deadline_index::object_inserted( const object& obj )
+{
+   auto deadline = _deadline_of( obj );
+   if( deadline.valid() )
+      _deadlines.insert( *deadline );
+}
+
+void deadline_index::object_removed( const object& obj )
+{
+   auto deadline = _deadline_of( obj );
+   if( deadline.valid() )
+      erase_one( _deadlines, *deadline );
+}
+
+void deadline_index::about_to_modify( const object& before )
+{
+   _before_modify[before.id] = _deadline_of( before );
+}
+
+void deadline_index::object_modified( const object& after )
+{
+   auto itr = _before_modify.find( after.id );
+   assert( itr != _before_modify.end() );
+   if( itr == _before_modify.end() )
+      return;
+   const optional<time_point_sec> before = itr->second;
+   _before_modify.erase( itr );
+
+   auto deadline = _deadline_of( after );
+   if( deadline.valid() == before.valid() && ( !deadline.valid() || *deadline == *before ) )
+      return;
+   if( before.valid() )
+      erase_one( _deadlines, *before );
+   if( deadline.valid() )
+      _deadlines.insert( *deadline );
+}
+
+optional<time_point_sec> deadline_index::next_deadline()const
+{
+   if( _deadlines.empty() )
+      return optional<time_point_sec>();
+   return *_deadlines.begin();
+}
+
+void deadline_scheduler::clear()
+{
+   for( auto& indexes : _tasks )
+      indexes.clear();
+}
+
+optional<time_point_sec> deadline_scheduler::next_deadline( task t )const
+{
+   optional<time_point_sec> result;
+   for( const deadline_index* idx : _tasks[t] )
+   {
+      auto next = idx->next_deadline();
+      if( next.valid() && ( !result.valid() || *next < *result ) )
+         result = next;
+   }
+   return result;
+}
+
+} } // graphene::chain
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/execution_profiler.hpp>
+#include <graphene/chain/protocol/operations.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace chain {
+
+namespace {
+
+   const char* const block_phase_names[] = {
+      "header_validation",
+      "transaction_preparation",
+      "transactions",
+      "witness_schedule",
+      "global_dynamic_data",
+      "chain_maintenance",
+      "ending_lotteries",
+      "block_summary",
+      "delayed_bets",
+      "expired_transactions",
+      "expired_proposals",
+      "expired_orders",
+      "expired_feeds",
+      "withdraw_permissions",
+      "tournaments",
+      "betting_markets",
+      "maintenance_flag",
+      "applied_block_handlers",
+      "changed_objects_handlers"
+   };
+   static_assert( sizeof(block_phase_names) / sizeof(block_phase_names[0]) == execution_profiler::block_phase_count,
+                  "every block phase needs a name" );
+
+   struct operation_name_visitor
+   {
+      typedef string result_type;
+
+      template<typename Op>
+      string operator()( const Op& )const
+      {
+         string name = fc::get_typename<Op>::name();
+         auto pos = name.rfind( ':' );
+         return pos == string::npos ? name : name.substr( pos + 1 );
+      }
+   };
+
+   void log_histograms( const char* what, vector<execution_histogram>& entries, size_t max_entries )
+   {
+      std::sort( entries.begin(), entries.end(), []( const execution_histogram& a, const execution_histogram& b ) {
+         return a.total_us > b.total_us;
+      });
+      if( entries.size() > max_entries )
+         entries.resize( max_entries );
+      for( const auto& e : entries )
+         ilog( "   ${what} ${name}: ${count} runs, ${total} ms total, ${avg} us average, ${max} us max",
+               ("what",what)("name",e.name)("count",e.count)("total",e.total_us / 1000)
+               ("avg",e.total_us / e.count)("max",e.max_us) );
+   }
+
+} // anonymous namespace
+
+void execution_profiler::histogram::clear()
+{
+   count.store( 0, std::memory_order_relaxed );
+   total_us.store( 0, std::memory_order_relaxed );
+   max_us.store( 0, std::memory_order_relaxed );
+   for( auto& b : buckets )
+      b.store( 0, std::memory_order_relaxed );
+}
+
+void execution_profiler::histogram::add( int64_t us )
+{
+   const uint64_t value = us > 0 ? uint64_t( us ) : 0;
+   size_t bucket = 0;
+   while( bucket + 1 < bucket_count && (uint64_t(1) << bucket) <= value )
+      ++bucket;
+
+   count.fetch_add( 1, std::memory_order_relaxed );
+   total_us.fetch_add( value, std::memory_order_relaxed );
+   buckets[bucket].fetch_add( 1, std::memory_order_relaxed );
+   uint64_t old_max = max_us.load( std::memory_order_relaxed );
+   while( value > old_max && !max_us.compare_exchange_weak( old_max, value, std::memory_order_relaxed ) )
+      ;
+}
+
+execution_histogram execution_profiler::histogram::get( const string& name )const
+{
+   execution_histogram result;
+   result.name     = name;
+   result.count    = count.load( std::memory_order_relaxed );
+   result.total_us = total_us.load( std::memory_order_relaxed );
+   result.max_us   = max_us.load( std::memory_order_relaxed );
+   result.buckets.reserve( bucket_count );
+   for( const auto& b : buckets )
+      result.buckets.push_back( b.load( std::memory_order_relaxed ) );
+   while( !result.buckets.empty() && result.buckets.back() == 0 )
+      result.buckets.pop_back();
+   return result;
+}
+
+execution_profiler::block_timer::block_timer( execution_profiler& profiler )
+   : _profiler( profiler.enabled() ? &profiler : nullptr )
+{
+   if( _profiler )
+   {
+      _last = fc::time_point::now();
+      _elapsed_us.fill( -1 );
+   }
+}
+
+void execution_profiler::block_timer::mark( block_phase phase )
+{
+   if( !_profiler )
+      return;
+   const fc::time_point now = fc::time_point::now();
+   const int64_t elapsed = (now - _last).count();
+   _elapsed_us[phase] = std::max<int64_t>( _elapsed_us[phase], 0 ) + elapsed;
+   _last = now;
+}
+
+void execution_profiler::block_timer::finish()
+{
+   if( !_profiler )
+      return;
+   for( size_t i = 0; i < block_phase_count; ++i )
+      if( _elapsed_us[i] >= 0 )
+         _profiler->_block_phases[i].add( _elapsed_us[i] );
+   _profiler = nullptr;
+}
+
+execution_profiler::execution_profiler()
+   : _enabled( false ), _blocks( 0 ), _since_sec( fc::time_point_sec( fc::time_point::now() ).sec_since_epoch() )
+{
+   operation op;
+   operation_name_visitor vtor;
+   _operation_names.resize( op.count() );
+   for( int i = 0; i < op.count(); ++i )
+   {
+      op.set_which( i );
+      _operation_names[i] = op.visit( vtor );
+   }
+   _operations.reset( new histogram[ _operation_names.size() ] );
+}
+
+execution_profiler::~execution_profiler() {}
+
+void execution_profiler::enable( bool enabled )
+{
+   if( enabled && !this->enabled() )
+      reset();
+   _enabled.store( enabled, std::memory_order_relaxed );
+}
+
+void execution_profiler::reset()
+{
+   for( size_t i = 0; i < _operation_names.size(); ++i )
+      _operations[i].clear();
+   for( auto& h : _block_phases )
+      h.clear();
+   _blocks.store( 0, std::memory_order_relaxed );
+   _since_sec.store( fc::time_point_sec( fc::time_point::now() ).sec_since_epoch(), std::memory_order_relaxed );
+}
+
+void execution_profiler::record_operation( int which, fc::microseconds elapsed )
+{
+   if( which >= 0 && size_t( which ) < _operation_names.size() )
+      _operations[which].add( elapsed.count() );
+}
+
+void execution_profiler::record_block( uint32_t block_num )
+{
+   if( !enabled() )
+      return;
+   _blocks.fetch_add( 1, std::memory_order_relaxed );
+   if( _log_interval > 0 && block_num % _log_interval == 0 )
+      log_summary();
+}
+
+execution_profile execution_profiler::get_profile()const
+{
+   execution_profile result;
+   result.enabled = enabled();
+   result.since   = fc::time_point_sec( uint32_t( _since_sec.load( std::memory_order_relaxed ) ) );
+   result.blocks  = _blocks.load( std::memory_order_relaxed );
+   for( size_t i = 0; i < _operation_names.size(); ++i )
+      if( _operations[i].count.load( std::memory_order_relaxed ) > 0 )
+         result.operations.push_back( _operations[i].get( _operation_names[i] ) );
+   for( size_t i = 0; i < block_phase_count; ++i )
+      if( _block_phases[i].count.load( std::memory_order_relaxed ) > 0 )
+         result.block_phases.push_back( _block_phases[i].get( block_phase_names[i] ) );
+   return result;
+}
+
+void execution_profiler::log_summary()const
+{
+   execution_profile profile = get_profile();
+   ilog( "Execution profile of ${n} blocks since ${t}:", ("n",profile.blocks)("t",profile.since) );
+   log_histograms( "phase", profile.block_phases, profile.block_phases.size() );
+   log_histograms( "operation", profile.operations, 10 );
+}
+
+} } // graphene::chain
@@ -263,6 +263,16 @@ namespace graphene { namespace chain {
          if ( lhs.lottery_options->is_active && ( !rhs.is_lottery() || !rhs.lottery_options->is_active ) ) return true;
          return lhs.get_lottery_expiration() > rhs.get_lottery_expiration();
       }
+
+      // compare with an active lottery ending at the given time
+      bool operator()(const asset_object& lhs, time_point_sec rhs) const
+      {
+         return lhs.is_lottery() && lhs.lottery_options->is_active && lhs.get_lottery_expiration() > rhs;
+      }
+      bool operator()(time_point_sec lhs, const asset_object& rhs) const
+      {
+         return !rhs.is_lottery() || !rhs.lottery_options->is_active || lhs > rhs.get_lottery_expiration();
+      }
    };
 
    struct by_symbol;
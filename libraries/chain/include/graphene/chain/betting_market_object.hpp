@@ -606,6 +606,77 @@ typedef multi_index_container<
       ordered_unique< tag<by_bettor_and_odds>, identity<bet_object>, compare_bet_by_bettor_then_odds > > > bet_object_multi_index_type;
 typedef generic_index<bet_object, bet_object_multi_index_type> bet_object_index;
 
+/**
+ * This secondary index on the bet_object_index keeps the liquidity on the books of every betting
+ * market aggregated by side and odds.  Delayed bets are not on the books and are left out.
+ *
+ * The levels of one side are ordered like the by_odds index orders the bets, so the first level of a
+ * side is the one a taker from the other side matches first.  Within a level, the by_odds index holds
+ * the bets in the order they are matched.
+ */
+class bet_price_level_index : public graphene::db::secondary_index
+{
+   public:
+      struct level_key
+      {
+         betting_market_id_type betting_market_id;
+         bet_type               back_or_lay;
+         bet_multiplier_type    backer_multiplier;
+      };
+
+      struct price_level
+      {
+         share_type amount_to_bet;
+         uint32_t   bet_count = 0;
+      };
+
+      struct compare_level_keys
+      {
+         bool operator()(const level_key& lhs, const level_key& rhs) const
+         {
+            if (lhs.betting_market_id != rhs.betting_market_id)
+               return lhs.betting_market_id < rhs.betting_market_id;
+            if (lhs.back_or_lay != rhs.back_or_lay)
+               return lhs.back_or_lay < rhs.back_or_lay;
+            if (lhs.back_or_lay == bet_type::back)
+               return lhs.backer_multiplier < rhs.backer_multiplier;
+            return lhs.backer_multiplier > rhs.backer_multiplier;
+         }
+      };
+
+      typedef std::map<level_key, price_level, compare_level_keys> level_map;
+      typedef std::pair<level_map::const_iterator, level_map::const_iterator> level_range;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      /// @return the levels on both sides of the book, back levels first
+      level_range get_levels(betting_market_id_type betting_market_id) const;
+      /// @return the levels on one side of the book, best odds for a taker first
+      level_range get_levels(betting_market_id_type betting_market_id, bet_type back_or_lay) const;
+      /// @return the first level after the given one, which need not exist any more
+      level_map::const_iterator next_level(const level_key& key) const { return _levels.upper_bound(key); }
+
+      const level_map& levels() const { return _levels; }
+
+   private:
+      /// the fields of a bet the levels depend on, saved instead of the whole bet while it is modified
+      struct bet_level
+      {
+         level_key  key;
+         share_type amount_to_bet;
+         bool       delayed = false;
+      };
+
+      static bet_level level_of(const bet_object& bet);
+      void adjust(const bet_level& bet, bool add);
+
+      level_map  _levels;
+      bet_level  _before;
+};
+
 struct by_bettor_betting_market{};
 struct by_betting_market_bettor{};
 typedef multi_index_container<
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/block.hpp>
+
+#include <fc/thread/mutex.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include <memory>
+
+namespace graphene { namespace chain {
+   using boost::multi_index_container;
+   using namespace boost::multi_index;
+
+   /**
+    * @brief keeps the most recently stored or requested blocks in memory
+    *
+    * Peers syncing from us and API clients mostly ask for the last few thousand
+    * blocks.  This cache sits in front of the block_database and keeps both the
+    * unpacked block and its packed bytes, so serving a recent block neither
+    * touches the disk nor unpacks and hashes it again.
+    *
+    * There is at most one entry per block number; storing a block replaces the
+    * entry of any other block with the same number.  The least recently used
+    * entry is dropped when the cache is full.  Every method is thread safe.
+    */
+   class block_cache
+   {
+      public:
+         struct entry
+         {
+            uint32_t                              block_num = 0;
+            block_id_type                         block_id;
+            std::shared_ptr<const signed_block>   block;
+            std::shared_ptr<const vector<char>>   packed;
+         };
+
+         struct stats
+         {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint32_t size = 0;
+            uint32_t max_size = 0;
+         };
+
+         explicit block_cache( uint32_t max_size = 2000 ) : _max_size( max_size ) {}
+
+         /// @return the cached entry for block id, counting a hit or a miss
+         optional<entry> find( const block_id_type& id )const;
+         /// @return the cached entry for block number num, counting a hit or a miss
+         optional<entry> find( uint32_t num )const;
+
+         void insert( const block_id_type& id, std::shared_ptr<const signed_block> block,
+                      std::shared_ptr<const vector<char>> packed );
+         /// Drops the entry of block id, if there is one
+         void remove( const block_id_type& id );
+         void clear();
+
+         stats    get_stats()const;
+         uint32_t max_size()const { return _max_size; }
+         void     set_max_size( uint32_t max_size );
+
+      private:
+         struct by_num;
+         typedef multi_index_container<
+            entry,
+            indexed_by<
+               sequenced<>,
+               hashed_unique< tag<by_num>, member< entry, uint32_t, &entry::block_num > >
+            >
+         > entry_index_type;
+
+         optional<entry> find_locked( uint32_t num, const block_id_type* id )const;
+         void shrink_to( uint32_t max_size );
+
+         mutable fc::mutex        _mutex;
+         mutable entry_index_type _entries;
+         uint32_t                 _max_size;
+         mutable uint64_t         _hits = 0;
+         mutable uint64_t         _misses = 0;
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::block_cache::stats, (hits)(misses)(size)(max_size) )
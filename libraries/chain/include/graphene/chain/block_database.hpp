@@ -23,12 +23,48 @@
  */
 #pragma once
 #include <fstream>
+#include <memory>
 #include <graphene/chain/protocol/block.hpp>
+#include <graphene/chain/block_cache.hpp>
 
 namespace graphene { namespace chain {
-   class block_database 
+   namespace detail { class block_database_impl; }
+
+   class block_database
    {
       public:
+         /**
+          * Both backends read and write the same on-disk format.
+          *
+          * stream_backend keeps the index and the blocks in two std::fstreams and seeks before every
+          * access, so all callers share one stream position.
+          *
+          * mapped_backend memory maps the index and reads blocks with pread(), lookups do not move any
+          * shared cursor and may run concurrently with each other and with the (single) writer.
+          *
+          * segmented_backend splits the log into directories of a fixed number of blocks, each laid out
+          * like the mapped backend, and can drop the oldest ones, see enable_segments().
+          */
+         enum backend_type
+         {
+            stream_backend,
+            mapped_backend,
+            segmented_backend
+         };
+
+         block_database( backend_type backend = mapped_backend );
+         ~block_database();
+
+         /// Must be called while closed.  A segmented block log is always opened as such.
+         void set_backend( backend_type backend );
+
+         /**
+          * Switches to a segmented block log that keeps at least the last retain_blocks blocks
+          * (0 keeps all of them) and deletes segments holding only older ones.  Must be called while
+          * closed; an existing block log in the old layout is converted when it is opened.
+          */
+         void enable_segments( uint32_t retain_blocks, uint32_t blocks_per_segment = 1000000 );
+
          void open( const fc::path& dbdir );
          bool is_open()const;
          void flush();
@@ -41,10 +77,27 @@ namespace graphene { namespace chain {
          block_id_type          fetch_block_id( uint32_t block_num )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
+         /// Like fetch_by_number() but bypasses the cache, for scans such as a replay that would evict the recent blocks
+         optional<signed_block> read_by_number( uint32_t block_num )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
+
+         /// @return the lowest block number that has not been pruned
+         uint32_t               first_retained_block_num()const;
+
+         /// @return the block as packed by fc::raw::pack, or null if block id is not stored
+         std::shared_ptr<const vector<char>> fetch_packed( const block_id_type& id )const;
+
+         backend_type backend()const { return _backend; }
+
+         /// Recently stored and fetched blocks, see @ref block_cache
+         block_cache&       get_cache()      { return _cache; }
+         const block_cache& get_cache()const { return _cache; }
       private:
-         mutable std::fstream _blocks;
-         mutable std::fstream _block_num_to_pos;
+         backend_type                                _backend;
+         uint32_t                                    _retain_blocks = 0;
+         uint32_t                                    _blocks_per_segment = 1000000;
+         std::unique_ptr<detail::block_database_impl> my;
+         mutable block_cache                         _cache;
    };
 } }
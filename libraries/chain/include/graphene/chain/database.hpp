@@ -30,6 +30,12 @@
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/chain/evaluator.hpp>
+#include <graphene/chain/signature_key_cache.hpp>
+#include <graphene/chain/execution_profiler.hpp>
+#include <graphene/chain/deadline_scheduler.hpp>
+#include <graphene/chain/pending_transaction_pool.hpp>
+#include <graphene/chain/vote_totals.hpp>
+#include <graphene/chain/read_write_lock.hpp>
 
 #include <graphene/db/object_database.hpp>
 #include <graphene/db/object.hpp>
@@ -44,6 +50,8 @@
 
 #include <map>
 
+namespace graphene { namespace utilities { class thread_pool; } }
+
 namespace graphene { namespace chain {
    using graphene::db::abstract_object;
    using graphene::db::object;
@@ -52,6 +60,23 @@ namespace graphene { namespace chain {
 
    struct budget_record;
 
+   /**
+    * The accounts impacted by the objects of one new_objects, changed_objects or removed_objects notification.
+    * They are only computed the first time a listener asks for them and shared by all listeners after that.
+    * Only valid while the notification is being delivered.
+    */
+   class impacted_account_set
+   {
+      public:
+         explicit impacted_account_set( vector<const object*>&& objects ) : _objects( std::move( objects ) ) {}
+
+         const flat_set<account_id_type>& get()const;
+
+      private:
+         vector<const object*>                       _objects;
+         mutable optional< flat_set<account_id_type> > _accounts;
+   };
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -104,6 +129,22 @@ namespace graphene { namespace chain {
           */
          void reindex(fc::path data_dir, const genesis_state_type& initial_allocation = genesis_state_type());
 
+         /**
+          * @brief Rebuild the object graph from a binary state snapshot and open the database
+          *
+          * Replaces the object database in data_dir with the contents of snapshot and then replays only the
+          * blocks in the block log that follow the snapshot's head block.  Older blocks are not needed, so
+          * the block log is kept segmented from then on.
+          */
+         void open_from_snapshot( const fc::path& data_dir, const fc::path& snapshot );
+
+         /**
+          * @brief Write a binary snapshot of the current state to dest, see @ref snapshot_header
+          *
+          * The indexes are packed in parallel on the worker threads.
+          */
+         void save_snapshot( const fc::path& dest )const;
+
          /**
           * @brief wipe Delete database from disk, and potentially the raw chain as well.
           * @param include_blocks If true, delete the raw chain as well as the database.
@@ -113,6 +154,52 @@ namespace graphene { namespace chain {
          void wipe(const fc::path& data_dir, bool include_blocks);
          void close(bool rewind = true);
 
+         /**
+          * @brief Set the number of threads used for CPU bound work that can run off the chain thread,
+          * such as recovering the signing keys of the transactions in a block or saving and loading
+          * the object database
+          * @param num_threads Number of worker threads; 0 or 1 does all work on the calling thread
+          */
+         void set_worker_threads( uint32_t num_threads );
+
+         /**
+          * @brief Keep only the most recent blocks on disk, must be called before open()
+          * @param num_blocks Number of blocks to retain, at least GRAPHENE_MAX_UNDO_HISTORY; 0 keeps all blocks
+          *
+          * The block log is split into segments and whole segments are deleted once all of their blocks
+          * fall out of the retained range.  A pruned block log cannot be replayed.
+          */
+         void set_block_log_retain( uint32_t num_blocks );
+
+         /**
+          * @brief Save the changed objects every num_blocks blocks, must be called before open()
+          * @param num_blocks Blocks between two state checkpoints; 0 disables them
+          *
+          * Enables incremental saves (see object_database::set_incremental_save()).  Each checkpoint
+          * holds the state that can no longer be undone, open() loads the latest one and replays the
+          * blocks after it, so an unclean shutdown does not require a reindex.
+          */
+         void set_state_checkpoint_interval( uint32_t num_blocks );
+         uint32_t state_checkpoint_interval()const { return _state_checkpoint_interval; }
+
+         const signature_key_cache& get_signature_key_cache()const { return _signature_key_cache; }
+         block_cache&               get_block_cache()             { return _block_id_to_block.get_cache(); }
+         const block_cache&         get_block_cache()const        { return _block_id_to_block.get_cache(); }
+
+         /// Times operations and the steps of applying a block while enabled, see @ref execution_profiler
+         execution_profiler&        get_execution_profiler()      { return _execution_profiler; }
+         const execution_profiler&  get_execution_profiler()const { return _execution_profiler; }
+
+         /// Earliest deadlines of the tasks run at the end of each block, see @ref deadline_scheduler
+         const deadline_scheduler&  get_deadline_scheduler()const { return _deadline_scheduler; }
+         /// The stake behind every vote id as of the current state, see @ref vote_totals
+         const vote_totals&         get_vote_totals()const { return _vote_totals; }
+         /// Taken for writing by push_block(), push_transaction(), generate_block(), pop_block() and
+         /// clear_pending(); readers on other threads must hold it for reading, see @ref read_write_lock
+         read_write_lock&           get_read_write_lock()const    { return _read_write_lock; }
+         /// Compare the running vote totals with a full recount at every maintenance and log differences
+         void set_verify_vote_totals( bool verify ) { _verify_vote_totals = verify; }
+
          //////////////////// db_block.cpp ////////////////////
 
          /**
@@ -122,8 +209,12 @@ namespace graphene { namespace chain {
          bool                       is_known_block( const block_id_type& id )const;
          bool                       is_known_transaction( const transaction_id_type& id )const;
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
+         /// @return the number of the oldest block that has not been pruned from the block log
+         uint32_t                   first_retained_block_num()const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+         /// @return the block packed by fc::raw::pack, or null if it is unknown
+         std::shared_ptr<const vector<char>> fetch_packed_block_by_id( const block_id_type& id )const;
          const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
@@ -141,6 +232,12 @@ namespace graphene { namespace chain {
          processed_transaction push_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          bool _push_block( const signed_block& b );
          processed_transaction _push_transaction( const signed_transaction& trx );
+         /**
+          * Pushes a transaction that was pending before a block was applied.  If authorities_unchanged,
+          * the block did not change anything its signatures and authorities were checked against, so
+          * they are not checked again.
+          */
+         processed_transaction _push_pending_transaction( const pending_transaction_pool::entry& e, bool authorities_unchanged );
 
          ///@throws fc::exception if the proposed transaction fails to apply.
          processed_transaction push_proposal( const proposal_object& proposal );
@@ -160,6 +257,16 @@ namespace graphene { namespace chain {
          void pop_block();
          void clear_pending();
 
+         const pending_transaction_pool& get_pending_transactions()const { return _pending_tx; }
+         /// Limits the number of pending transactions, the ones with the lowest fee per byte are dropped
+         void set_max_pending_transactions( size_t max_size ) { _pending_tx.set_max_size( max_size ); }
+
+         /**
+          * @return true if the last applied block changed an account or the chain parameters, so the
+          * signatures and authorities of transactions have to be checked again
+          */
+         bool head_block_changed_authorities()const;
+
          /**
           *  This method is used to track appied operations during the evaluation of a block, these
           *  operations should include any operation actually included in a transaction as well
@@ -205,18 +312,25 @@ namespace graphene { namespace chain {
           *  Emitted After a block has been applied and committed.  The callback
           *  should not yield and should execute quickly.
           */
-         fc::signal<void(const vector<object_id_type>&, const flat_set<account_id_type>&)> new_objects;
+         fc::signal<void(const vector<object_id_type>&, const impacted_account_set&)> new_objects;
 
          /**
           *  Emitted After a block has been applied and committed.  The callback
           *  should not yield and should execute quickly.
           */
-         fc::signal<void(const vector<object_id_type>&, const flat_set<account_id_type>&)> changed_objects;
+         fc::signal<void(const vector<object_id_type>&, const impacted_account_set&)> changed_objects;
 
          /** this signal is emitted any time an object is removed and contains a
           * pointer to the last value of every object that was removed.
           */
-         fc::signal<void(const vector<object_id_type>&, const vector<const object*>&, const flat_set<account_id_type>&)>  removed_objects;
+         fc::signal<void(const vector<object_id_type>&, const vector<const object*>&, const impacted_account_set&)>  removed_objects;
+
+         /**
+          *  Emitted with the objects changed by a transaction added to the pending state, and with the objects of
+          *  the pending state or of a popped block right before their changes are undone.  Together with the
+          *  three signals above this reports every change that readers of the database could have seen.
+          */
+         fc::signal<void(const impacted_account_set&)>   pending_objects_changed;
 
          //////////////////// db_witness_schedule.cpp ////////////////////
 
@@ -460,6 +574,8 @@ namespace graphene { namespace chain {
          //Mark pop_undo() as protected -- we do not want outside calling pop_undo(); it should call pop_block() instead
          void pop_undo() { object_database::pop_undo(); }
          void notify_changed_objects();
+         /// Reports the objects of the newest undo state through pending_objects_changed
+         void notify_pending_objects_changed();
 
       private:
          optional<undo_database::session>       _pending_tx_session;
@@ -471,23 +587,58 @@ namespace graphene { namespace chain {
          //////////////////// db_block.cpp ////////////////////
 
        public:
+         /**
+          * Hashes of a block that are needed to apply it.  They only depend on the block itself,
+          * so they can be computed ahead of time on another thread, e.g. while replaying.
+          */
+         struct block_hashes
+         {
+            block_id_type                 block_id;
+            checksum_type                 merkle_root;
+            vector<transaction_id_type>   transaction_ids;
+         };
+         static block_hashes compute_block_hashes( const signed_block& b );
+
          // these were formerly private, but they have a fairly well-defined API, so let's make them public
-         void                  apply_block( const signed_block& next_block, uint32_t skip = skip_nothing );
+         void                  apply_block( const signed_block& next_block, uint32_t skip = skip_nothing,
+                                            const block_hashes* hashes = nullptr );
          processed_transaction apply_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          operation_result      apply_operation( transaction_evaluation_state& eval_state, const operation& op );
       private:
-         void                  _apply_block( const signed_block& next_block );
-         processed_transaction _apply_transaction( const signed_transaction& trx );
+         void                  _apply_block( const signed_block& next_block, const block_hashes* hashes = nullptr );
+         /// Applies the stored blocks first_block_num to last_block_num without validating them again
+         void                  replay_blocks( const fc::path& data_dir, uint32_t first_block_num, uint32_t last_block_num );
+         /// @param validated trx.validate() was called already
+         processed_transaction _apply_transaction( const signed_transaction& trx,
+                                                   const flat_set<public_key_type>* signature_keys = nullptr,
+                                                   const transaction_id_type* trx_id_hint = nullptr,
+                                                   bool validated = false );
+
+         /// The work of applying a transaction that does not depend on the chain state
+         struct prepared_transaction
+         {
+            /// only recovered when signatures are checked
+            optional< flat_set<public_key_type> > signature_keys;
+            bool                                  validated = false;
+         };
+         /**
+          * Validates every transaction in the block and recovers its signing keys on the worker threads.
+          * Returns an empty vector when there is no worker pool.  Transactions that fail either step are
+          * left unprepared, _apply_transaction() repeats the step and reports the error in block order.
+          */
+         vector< prepared_transaction > prepare_transactions( const signed_block& next_block, bool recover_keys )const;
+         /// Fees of a pending transaction converted to the core asset per kilobyte, 0 for fees that can't be converted
+         uint64_t pending_fee_per_kb( const signed_transaction& trx, uint32_t packed_size )const;
       
          ///Steps involved in applying a new block
          ///@{
 
          const witness_object& validate_block_header( uint32_t skip, const signed_block& next_block )const;
          const witness_object& _validate_block_header( const signed_block& next_block )const;
-         void create_block_summary(const signed_block& next_block);
+         void create_block_summary(const signed_block& next_block, const block_id_type& next_block_id);
 
          //////////////////// db_update.cpp ////////////////////
-         void update_global_dynamic_data( const signed_block& b );
+         void update_global_dynamic_data( const signed_block& b, const block_id_type& b_id );
          void update_signing_witness(const witness_object& signing_witness, const signed_block& new_block);
          void update_last_irreversible_block();
          void clear_expired_transactions();
@@ -519,7 +670,7 @@ namespace graphene { namespace chain {
          ///@}
          ///@}
 
-         vector< processed_transaction >        _pending_tx;
+         pending_transaction_pool               _pending_tx;
          fork_database                          _fork_db;
 
          /**
@@ -556,6 +707,19 @@ namespace graphene { namespace chain {
          node_property_object              _node_property_object;
          fc::hash_ctr_rng<secret_hash_type, 20> _random_number_generator;
          bool                              _slow_replays = false;
+         uint32_t                          _state_checkpoint_interval = 0;
+
+         std::unique_ptr<graphene::utilities::thread_pool> _thread_pool;
+
+         mutable read_write_lock           _read_write_lock;
+
+         /// keys recovered from the signatures of pending transactions, until they expire
+         signature_key_cache               _signature_key_cache;
+
+         execution_profiler                _execution_profiler;
+         deadline_scheduler                _deadline_scheduler;
+         vote_totals                       _vote_totals;
+         bool                              _verify_vote_totals = false;
    };
 
    namespace detail
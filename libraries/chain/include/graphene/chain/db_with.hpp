@@ -68,12 +68,19 @@ struct skip_flags_restorer
  */
 struct pending_transactions_restorer
 {
-   pending_transactions_restorer( database& db, std::vector<processed_transaction>&& pending_transactions )
-      : _db(db), _pending_transactions( std::move(pending_transactions) )
+   pending_transactions_restorer( database& db, pending_transaction_pool&& pending_transactions )
+      : _db(db), _pending_transactions( 0 )
    {
+      _pending_transactions.swap( pending_transactions );
       _db.clear_pending();
    }
 
+   /**
+    * Set when the pushed block did not change any account or chain parameter, the pending
+    * transactions whose signatures and authorities were checked are then not checked again.
+    */
+   void set_authorities_unchanged( bool unchanged ) { _authorities_unchanged = unchanged; }
+
    ~pending_transactions_restorer()
    {
       for( const auto& tx : _db._popped_tx )
@@ -88,18 +95,18 @@ struct pending_transactions_restorer
          }
       }
       _db._popped_tx.clear();
-      for( const processed_transaction& tx : _pending_transactions )
+      for( const auto& entry : _pending_transactions.entries().get<pending_transaction_pool::by_sequence>() )
       {
          try
          {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
+            if( !_db.is_known_transaction( entry.id ) ) {
+               _db._push_pending_transaction( entry, _authorities_unchanged );
             }
          }
          catch( const fc::exception& e )
          {
+            // a transaction checked later may depend on an account this one would have changed
+            _authorities_unchanged = false;
             /*
             wlog( "Pending transaction became invalid after switching to block ${b}  ${t}", ("b", _db.head_block_id())("t",_db.head_block_time()) );
             wlog( "The invalid pending transaction caused exception ${e}", ("e", e.to_detail_string() ) );
@@ -109,7 +116,8 @@ struct pending_transactions_restorer
    }
 
    database& _db;
-   std::vector< processed_transaction > _pending_transactions;
+   pending_transaction_pool _pending_transactions;
+   bool _authorities_unchanged = false;
 };
 
 /**
@@ -139,7 +147,7 @@ void with_skip_flags(
 template< typename Lambda >
 void without_pending_transactions(
    database& db,
-   std::vector<processed_transaction>&& pending_transactions,
+   pending_transaction_pool&& pending_transactions,
    Lambda callback )
 {
     pending_transactions_restorer restorer( db, std::move(pending_transactions) );
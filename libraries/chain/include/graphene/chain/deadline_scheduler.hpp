@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/types.hpp>
+#include <graphene/db/index.hpp>
+
+#include <array>
+#include <functional>
+#include <set>
+
+namespace graphene { namespace chain {
+   using graphene::db::object;
+   using graphene::db::secondary_index;
+
+   /**
+    * @brief tracks the earliest time at which any object of an index has work due
+    *
+    * The deadline of each object is computed by a function set when the index is registered with
+    * the @ref deadline_scheduler; objects without a deadline are not tracked.  The index follows
+    * creation, modification and removal (including undo) of the objects, so next_deadline() is
+    * always current.
+    */
+   class deadline_index : public secondary_index
+   {
+      public:
+         typedef std::function< optional<time_point_sec>( const object& ) > deadline_function;
+
+         void set_deadline_function( deadline_function f ) { _deadline_of = std::move( f ); }
+
+         virtual void object_inserted( const object& obj )override;
+         virtual void object_removed( const object& obj )override;
+         virtual void about_to_modify( const object& before )override;
+         virtual void object_modified( const object& after )override;
+
+         optional<time_point_sec> next_deadline()const;
+         size_t                   size()const { return _deadlines.size(); }
+
+      private:
+         deadline_function                _deadline_of;
+         std::multiset<time_point_sec>    _deadlines;
+         /// deadlines of the objects being modified, a modifier may modify other objects of the index
+         flat_map< object_id_type, optional<time_point_sec> > _before_modify;
+   };
+
+   /**
+    * @brief tells database::_apply_block() which of its periodic tasks have work due
+    *
+    * Each task that runs when the time stored in some objects arrives (expiring transactions,
+    * proposals, orders and withdraw permissions, delayed bets, tournament and game deadlines,
+    * betting market group settlements and lottery end dates) is fed by a @ref deadline_index on the
+    * index of those objects.  A task only needs to run once the block time reaches the earliest
+    * deadline of any of its objects, so blocks with nothing due skip the sweep of that index.
+    *
+    * Work that does not depend on a time stored in an object, such as cancelling force settlements
+    * after a black swan or starting the next matches of a running tournament, is not scheduled here.
+    */
+   class deadline_scheduler
+   {
+      public:
+         enum task
+         {
+            expired_transactions,
+            delayed_bets,
+            expired_proposals,
+            expired_limit_orders,
+            expired_withdraw_permissions,
+            tournament_deadlines,
+            game_timeouts,
+            betting_market_group_settlements,
+            lottery_end_dates,
+            task_count
+         };
+
+         /// Forgets all indexes, called before the indexes of the database are recreated
+         void clear();
+
+         /**
+          * Feeds task with the deadlines of the objects in idx, as computed by deadline_of; must be
+          * called while idx is empty.
+          */
+         template<typename ObjectType, typename PrimaryIndex>
+         void track( task t, PrimaryIndex& idx, std::function< optional<time_point_sec>( const ObjectType& ) > deadline_of )
+         {
+            deadline_index* result = idx.template add_secondary_index<deadline_index>();
+            result->set_deadline_function( [deadline_of]( const object& obj ) {
+               return deadline_of( static_cast<const ObjectType&>( obj ) );
+            });
+            _tasks[t].push_back( result );
+         }
+
+         /// @return the earliest deadline of any object of the task
+         optional<time_point_sec> next_deadline( task t )const;
+
+         /// @return true if the task has an object whose deadline is now or earlier
+         bool is_due( task t, time_point_sec now )const
+         {
+            auto next = next_deadline( t );
+            return next.valid() && *next <= now;
+         }
+
+      private:
+         std::array< vector<const deadline_index*>, task_count > _tasks;
+   };
+
+} } // graphene::chain
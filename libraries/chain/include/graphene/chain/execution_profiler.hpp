@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/types.hpp>
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief execution time of a kind of work, as a histogram with power of two buckets
+    *
+    * buckets[i] counts the runs that took less than 2^i microseconds (and at least 2^(i-1)),
+    * the last bucket also counts all longer runs.  Trailing empty buckets are omitted.
+    */
+   struct execution_histogram
+   {
+      string           name;
+      uint64_t         count    = 0;
+      uint64_t         total_us = 0;
+      uint64_t         max_us   = 0;
+      vector<uint64_t> buckets;
+   };
+
+   struct execution_profile
+   {
+      bool                        enabled = false;
+      fc::time_point_sec          since;
+      uint64_t                    blocks  = 0;
+      /// one entry per operation type that was evaluated at least once
+      vector<execution_histogram> operations;
+      /// one entry per step of database::_apply_block() that ran at least once
+      vector<execution_histogram> block_phases;
+   };
+
+   /**
+    * @brief times operation evaluation and the steps of applying a block
+    *
+    * Profiling is off by default and can be switched on and off at any time.  While it is off
+    * the only cost is a relaxed atomic load per operation and per block; while it is on each
+    * measurement is two clock reads and a few relaxed atomic increments, so the profile may be
+    * read from any thread while the chain thread records into it.
+    *
+    * Operation times are inclusive: an operation executed by a proposal is counted on its own
+    * and again as part of the proposal_update_operation or proposal_create_operation.  Both
+    * pushed transactions and transactions in blocks are counted, failed operations are not.
+    */
+   class execution_profiler
+   {
+      public:
+         /// Steps of database::_apply_block(), in the order they run
+         enum block_phase
+         {
+            header_validation,
+            transaction_preparation,
+            transactions,
+            witness_schedule,
+            global_dynamic_data,
+            chain_maintenance,
+            ending_lotteries,
+            block_summary,
+            delayed_bets,
+            expired_transactions,
+            expired_proposals,
+            expired_orders,
+            expired_feeds,
+            withdraw_permissions,
+            tournaments,
+            betting_markets,
+            maintenance_flag,
+            applied_block_handlers,
+            changed_objects_handlers,
+            block_phase_count
+         };
+
+         /**
+          * Accumulates the time between calls to mark() into the phases of one block and records
+          * them on finish(), so each phase adds at most one sample per block and a block that fails
+          * to apply adds none.
+          */
+         class block_timer
+         {
+            public:
+               explicit block_timer( execution_profiler& profiler );
+
+               /// Accounts the time since the previous mark (or construction) to phase
+               void mark( block_phase phase );
+               /// Records the phases, to be called once the block has been applied
+               void finish();
+
+            private:
+               execution_profiler*                           _profiler;
+               fc::time_point                                _last;
+               std::array<int64_t, block_phase_count>        _elapsed_us;
+         };
+
+         execution_profiler();
+         ~execution_profiler();
+
+         void enable( bool enabled );
+         bool enabled()const { return _enabled.load( std::memory_order_relaxed ); }
+
+         /// Clears all samples, the profile starts over from now
+         void reset();
+
+         /**
+          * Logs the most expensive operations and block phases every num_blocks blocks while
+          * profiling is enabled; 0 disables the summary.
+          */
+         void set_log_interval( uint32_t num_blocks ) { _log_interval = num_blocks; }
+         uint32_t log_interval()const { return _log_interval; }
+
+         void record_operation( int which, fc::microseconds elapsed );
+         void record_block( uint32_t block_num );
+
+         execution_profile get_profile()const;
+
+      private:
+         static const size_t bucket_count = 24;
+
+         struct histogram
+         {
+            std::atomic<uint64_t>                              count;
+            std::atomic<uint64_t>                              total_us;
+            std::atomic<uint64_t>                              max_us;
+            std::array<std::atomic<uint64_t>, bucket_count>    buckets;
+
+            histogram() { clear(); }
+            void clear();
+            void add( int64_t us );
+            execution_histogram get( const string& name )const;
+         };
+
+         void log_summary()const;
+
+         std::atomic<bool>                   _enabled;
+         std::atomic<uint64_t>               _blocks;
+         std::atomic<int64_t>                _since_sec;
+         uint32_t                            _log_interval = 0;
+         vector<string>                      _operation_names;
+         std::unique_ptr<histogram[]>        _operations;
+         std::array<histogram, block_phase_count> _block_phases;
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::execution_histogram, (name)(count)(total_us)(max_us)(buckets) )
+FC_REFLECT( graphene::chain::execution_profile, (enabled)(since)(blocks)(operations)(block_phases) )
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/transaction.hpp>
+
+#include <fc/uint128.hpp>
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
+
+namespace graphene { namespace chain {
+   using boost::multi_index_container;
+   using namespace boost::multi_index;
+
+   namespace detail {
+      struct operation_fee_visitor
+      {
+         typedef asset result_type;
+         template<typename Op>
+         asset operator()( const Op& op )const { return op.fee; }
+      };
+   }
+
+   /**
+    * @brief the transactions a node has accepted but not yet seen in a block
+    *
+    * The pending state of the database is the result of applying these transactions in arrival order
+    * on top of the head block.  A witness builds its block from them by decreasing fee per byte,
+    * see database::_generate_block().
+    *
+    * Each entry remembers the packed size of the transaction as it was last applied, so the block
+    * size limit can be checked without serializing it again, and whether its signatures and
+    * authorities were checked, so a transaction does not need to be checked again as long as no
+    * block changed the accounts or parameters the check depends on.
+    */
+   class pending_transaction_pool
+   {
+      public:
+         struct entry
+         {
+            processed_transaction trx;
+            transaction_id_type   id;
+            time_point_sec        expiration;
+            /// arrival order
+            uint64_t              sequence = 0;
+            uint32_t              packed_size = 0;
+            /// fees paid, converted to the core asset, per kilobyte of packed transaction
+            uint64_t              fee_per_kb = 0;
+            bool                  authority_checked = false;
+         };
+
+         struct by_id;
+         struct by_sequence;
+         struct by_fee;
+         struct by_expiration;
+         typedef multi_index_container<
+            entry,
+            indexed_by<
+               ordered_unique< tag<by_sequence>, member< entry, uint64_t, &entry::sequence > >,
+               // not unique: with skip_transaction_dupe_check the same transaction may be pushed twice
+               hashed_non_unique< tag<by_id>, member< entry, transaction_id_type, &entry::id >, std::hash<transaction_id_type> >,
+               ordered_unique< tag<by_fee>,
+                  composite_key< entry,
+                     member< entry, uint64_t, &entry::fee_per_kb >,
+                     member< entry, uint64_t, &entry::sequence >
+                  >,
+                  composite_key_compare< std::greater<uint64_t>, std::less<uint64_t> >
+               >,
+               ordered_non_unique< tag<by_expiration>, member< entry, time_point_sec, &entry::expiration > >
+            >
+         > entry_index_type;
+
+         explicit pending_transaction_pool( size_t max_size = 100000 ) : _max_size( max_size ) {}
+
+         /**
+          * Appends trx, if the pool is full the entry with the lowest fee per byte is evicted first.  The
+          * changes of an evicted transaction stay in the pending state until the next block is applied.
+          * @param packed_size fc::raw::pack_size( trx )
+          * @return false if trx itself has the lowest fee per byte of a full pool and was not added
+          */
+         bool add( const processed_transaction& trx, uint32_t packed_size, uint64_t fee_per_kb, bool authority_checked );
+
+         /// Remembers the results and size of the transaction as applied again, they may have changed
+         void update( const entry& e, const processed_transaction& applied, uint32_t packed_size );
+
+         /// Removes the transactions that expired before now, they can not be applied anymore
+         size_t remove_expired( time_point_sec now );
+
+         void   clear() { _entries.clear(); }
+         /// Exchanges the transactions of both pools, each keeps its own size limit
+         void   swap( pending_transaction_pool& other );
+         bool   empty()const { return _entries.empty(); }
+         size_t size()const  { return _entries.size(); }
+
+         size_t max_size()const { return _max_size; }
+         void   set_max_size( size_t max_size );
+
+         bool contains( const transaction_id_type& id )const;
+
+         const entry_index_type& entries()const { return _entries; }
+
+         /// @return the fees of trx converted by to_core, per kilobyte of packed_size
+         template<typename ToCore>
+         static uint64_t fee_per_kb( const signed_transaction& trx, uint32_t packed_size, ToCore to_core );
+
+      private:
+         void shrink_to( size_t max_size );
+
+         entry_index_type _entries;
+         uint64_t         _next_sequence = 0;
+         size_t           _max_size;
+   };
+
+   template<typename ToCore>
+   uint64_t pending_transaction_pool::fee_per_kb( const signed_transaction& trx, uint32_t packed_size, ToCore to_core )
+   {
+      fc::uint128 fees = 0;
+      for( const auto& op : trx.operations )
+      {
+         const share_type core_fee = to_core( op.visit( detail::operation_fee_visitor() ) );
+         if( core_fee > 0 )
+            fees += uint64_t( core_fee.value );
+      }
+      fees *= 1024;
+      fees /= std::max<uint32_t>( packed_size, 1 );
+      return fees.hi == 0 ? fees.to_uint64() : std::numeric_limits<uint64_t>::max();
+   }
+
+} } // graphene::chain
@@ -29,6 +29,8 @@
 
 namespace graphene { namespace chain {
 
+   class signature_key_cache;
+
    /**
     * @defgroup transactions Transactions
     *
@@ -167,6 +169,14 @@ namespace graphene { namespace chain {
 
       flat_set<public_key_type> get_signature_keys( const chain_id_type& chain_id )const;
 
+      /**
+       * Same as above, but only recovers the keys of signatures which are not in cache.
+       * If remember is true, newly recovered keys are added to cache until this transaction expires.
+       */
+      flat_set<public_key_type> get_signature_keys( const chain_id_type& chain_id,
+                                                    signature_key_cache& cache,
+                                                    bool remember = false )const;
+
       vector<signature_type> signatures;
 
       /// Removes all operations and signatures
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/thread/mutex.hpp>
+#include <fc/thread/thread_specific.hpp>
+
+#include <condition_variable>
+#include <mutex>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief lets other threads read the chain database while blocks are applied on the chain thread
+    *
+    * Everything that modifies the database takes the write side.  It is owned by one fc task at a time: the
+    * owner may take it again, nested, while a second writer is blocked until the owner let go of it, so two
+    * writers never interleave even when one of them yields.  A writer waits for the readers to drain by
+    * sleeping its fc task, so the other tasks of the chain thread keep running in the meantime.
+    *
+    * Threads reading the database take the read side, which waits while a write is pending or in progress.
+    * The chain thread must never take the read side.
+    */
+   class read_write_lock
+   {
+      public:
+         void lock();
+         void unlock();
+         void lock_shared();
+         void unlock_shared();
+
+         class write_guard
+         {
+            public:
+               explicit write_guard( read_write_lock& l ) : _lock( l ) { _lock.lock(); }
+               ~write_guard() { _lock.unlock(); }
+            private:
+               read_write_lock& _lock;
+         };
+
+         class read_guard
+         {
+            public:
+               explicit read_guard( read_write_lock& l ) : _lock( l ) { _lock.lock_shared(); }
+               ~read_guard() { _lock.unlock_shared(); }
+            private:
+               read_write_lock& _lock;
+         };
+
+      private:
+         void wait_for_readers();
+
+         /// held by the owner of the write side, fc::mutex does not support nesting
+         fc::mutex                          _writer;
+         /// how often the current task holds the write side
+         fc::task_specific_ptr<uint32_t>    _write_depth;
+
+         std::mutex              _mutex;
+         std::condition_variable _readers_may_enter;
+         uint32_t                _readers = 0;
+         bool                    _writing = false;
+   };
+
+} } // graphene::chain
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/types.hpp>
+
+#include <fc/thread/mutex.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
+
+namespace graphene { namespace chain {
+   using boost::multi_index_container;
+   using namespace boost::multi_index;
+
+   /**
+    * @brief remembers the public keys recovered from transaction signatures
+    *
+    * A transaction is usually seen several times by a node: when it is pushed to
+    * the pending state, again when a witness re-applies pending transactions in
+    * _generate_block(), and once more when it arrives inside a block.  Recovering
+    * a key from a compact signature is by far the most expensive part of checking
+    * a transaction's authorities, so the result is kept here until the
+    * transaction expires.
+    *
+    * Entries are keyed by both the signature digest and the signature, as the key
+    * recovered from a signature depends on the digest it signs.
+    *
+    * The cache is shared by the chain thread and the database worker threads, so
+    * every method is thread safe.
+    */
+   class signature_key_cache
+   {
+      public:
+         explicit signature_key_cache( size_t max_size = 100000 ) : _max_size( max_size ) {}
+
+         /// @return the key recovered from sig over digest if it is cached
+         optional<public_key_type> find( const digest_type& digest, const signature_type& sig )const;
+
+         /**
+          * Remembers that sig over digest was made by key until expiration.  If the cache
+          * is full, the entries closest to their expiration are dropped to make room.
+          */
+         void insert( const digest_type& digest, const signature_type& sig,
+                      const public_key_type& key, fc::time_point_sec expiration );
+
+         /// Drops all entries of transactions that expired before now
+         void remove_expired( fc::time_point_sec now );
+         void clear();
+
+         size_t size()const;
+         size_t max_size()const { return _max_size; }
+         void   set_max_size( size_t max_size );
+
+      private:
+         struct entry
+         {
+            digest_type        digest;
+            signature_type     signature;
+            public_key_type    key;
+            fc::time_point_sec expiration;
+         };
+
+         struct by_signature;
+         struct by_expiration;
+         typedef multi_index_container<
+            entry,
+            indexed_by<
+               ordered_unique< tag<by_signature>,
+                  composite_key< entry,
+                     member< entry, digest_type, &entry::digest >,
+                     member< entry, signature_type, &entry::signature >
+                  >
+               >,
+               ordered_non_unique< tag<by_expiration>, member< entry, fc::time_point_sec, &entry::expiration > >
+            >
+         > entry_index_type;
+
+         void shrink_to( size_t max_size );
+
+         mutable fc::mutex _mutex;
+         entry_index_type  _entries;
+         size_t            _max_size;
+   };
+
+} } // graphene::chain
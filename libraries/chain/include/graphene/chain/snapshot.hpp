@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/block.hpp>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief layout of a binary state snapshot written by database::save_snapshot()
+    *
+    * A snapshot file holds a snapshot_header followed by header.section_count sections.  Every
+    * section is a snapshot_section_header followed by section.size bytes produced by
+    * graphene::db::index::pack_snapshot() for the index identified by space_id and type_id.
+    * Everything is packed with fc::raw.
+    */
+   struct snapshot_header
+   {
+      /// "PPYSNAP" followed by a format version byte
+      static const uint64_t current_magic = 0x505059534e415001ull;
+
+      uint64_t       magic = current_magic;
+      chain_id_type  chain_id;
+      /// the head block at the time the snapshot was taken, the chain continues from it
+      signed_block   head_block;
+      uint32_t       section_count = 0;
+   };
+
+   struct snapshot_section_header
+   {
+      uint8_t     space_id = 0;
+      uint8_t     type_id = 0;
+      uint64_t    object_count = 0;
+      uint64_t    size = 0;
+      /// sha256 of the section payload
+      fc::sha256  checksum;
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::snapshot_header, (magic)(chain_id)(head_block)(section_count) )
+FC_REFLECT( graphene::chain::snapshot_section_header, (space_id)(type_id)(object_count)(size)(checksum) )
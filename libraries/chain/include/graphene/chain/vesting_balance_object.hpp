@@ -185,20 +185,21 @@ namespace graphene { namespace chain {
          ordered_non_unique< tag<by_account>,
             member<vesting_balance_object, account_id_type, &vesting_balance_object::owner>
          >,
-        ordered_non_unique< tag<by_asset_balance>,
-           composite_key<
-              vesting_balance_object,
-              member_offset<vesting_balance_object, asset_id_type, (size_t) (offsetof(vesting_balance_object,balance) + offsetof(asset,asset_id))>,
-              member_offset<vesting_balance_object, share_type, (size_t) (offsetof(vesting_balance_object,balance) + offsetof(asset,amount))>
-              //member<vesting_balance_object, account_id_type, &vesting_balance_object::owner>
-              //member_offset<vesting_balance_object, account_id_type, (size_t) (offset_s(vesting_balance_object,owner))>
-           >,
-           composite_key_compare<
-              std::less< asset_id_type >,
-              std::greater< share_type >
-              //std::less< account_id_type >
-           >
-        >
+         ordered_unique< tag<by_asset_balance>,
+            composite_key<
+               vesting_balance_object,
+               const_mem_fun<vesting_balance_object, asset_id_type, &vesting_balance_object::get_asset_id>,
+               const_mem_fun<vesting_balance_object, share_type, &vesting_balance_object::get_asset_amount>,
+               member<vesting_balance_object, account_id_type, &vesting_balance_object::owner>,
+               member<object, object_id_type, &object::id>
+            >,
+            composite_key_compare<
+               std::less< asset_id_type >,
+               std::greater< share_type >,
+               std::less< account_id_type >,
+               std::less< object_id_type >
+            >
+         >
       >
    > vesting_balance_multi_index_type;
    /**
@@ -206,6 +207,34 @@ namespace graphene { namespace chain {
     */
    typedef generic_index<vesting_balance_object, vesting_balance_multi_index_type> vesting_balance_index;
 
+   /**
+    *  @brief This secondary index keeps, for every asset, the sum of the vesting balances of each account
+    *  holding a nonzero vesting balance in it.
+    *
+    *  Dividend distribution and the vote tally need these sums for a single asset, reading them here costs
+    *  as much as the number of holders of that asset rather than the number of vesting balances on chain.
+    */
+   class vesting_balance_holder_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+         typedef map< account_id_type, share_type > holder_map;
+
+         /** @return the accounts holding a nonzero vesting balance in the asset, with the amount they hold */
+         const holder_map& get_holders( asset_id_type asset_id )const;
+
+      private:
+         void adjust( account_id_type owner, const asset& delta );
+
+         map< asset_id_type, holder_map > _holders;
+         asset                            _before_balance;
+         account_id_type                  _before_owner;
+   };
+
 } } // graphene::chain
 
 FC_REFLECT(graphene::chain::linear_vesting_policy,
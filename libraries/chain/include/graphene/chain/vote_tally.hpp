@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/account.hpp>
+
+#include <vector>
+
+namespace graphene { namespace utilities { class thread_pool; } }
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief sums the stake behind every vote id and the witness and committee count opinions
+    *
+    * Used by database::perform_chain_maintenance().  The voters are split into contiguous ranges, one
+    * per worker thread, each of which accumulates into its own buffers; the buffers are added up
+    * afterwards.  As the sums are integer additions the result does not depend on how the voters were
+    * split, so it is the same with any number of threads.
+    */
+   class vote_tally
+   {
+      public:
+         struct voter
+         {
+            /// the options of the account specifying the opinions, which may not be the one whose stake
+            /// is voting, or null if the stake does not vote
+            const account_options* opinion = nullptr;
+            uint64_t               stake = 0;
+         };
+
+         vote_tally( uint32_t next_available_vote_id, uint16_t maximum_witness_count,
+                     uint16_t maximum_committee_count );
+
+         /// Adds up the votes of all voters, on the threads of pool if it is not null, without yielding
+         void tally( const std::vector<voter>& voters, graphene::utilities::thread_pool* pool );
+
+         std::vector<uint64_t>& votes()               { return _votes; }
+         std::vector<uint64_t>& witness_histogram()   { return _witness_histogram; }
+         std::vector<uint64_t>& committee_histogram() { return _committee_histogram; }
+         uint64_t               total_stake()const    { return _total_stake; }
+
+      private:
+         struct buffers
+         {
+            std::vector<uint64_t> votes;
+            std::vector<uint64_t> witness_histogram;
+            std::vector<uint64_t> committee_histogram;
+            uint64_t              total_stake = 0;
+         };
+
+         void tally_range( const std::vector<voter>& voters, size_t begin, size_t end, buffers& out )const;
+
+         uint16_t              _maximum_witness_count;
+         uint16_t              _maximum_committee_count;
+         std::vector<uint64_t> _votes;
+         std::vector<uint64_t> _witness_histogram;
+         std::vector<uint64_t> _committee_histogram;
+         uint64_t              _total_stake = 0;
+   };
+
+} } // graphene::chain
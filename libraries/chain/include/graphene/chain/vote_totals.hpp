@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/account.hpp>
+#include <graphene/db/index.hpp>
+
+#include <vector>
+
+namespace graphene { namespace chain {
+   class database;
+   using graphene::db::object;
+   using graphene::db::secondary_index;
+
+   /**
+    * @brief the stake behind every vote id, kept current as the chain state changes
+    *
+    * The stake of an account is counted the way database::perform_chain_maintenance() counts it: the
+    * core balance, the core in open orders, the core vesting balances and the cashback balance.  It
+    * counts towards the votes of the account's voting_account, or of the account itself when it votes
+    * for itself.
+    *
+    * The totals are updated by secondary indexes on the accounts, account statistics, account balances
+    * and vesting balances, so they follow every change including undo.  They are provisional: the
+    * maintenance still recounts the votes, which also excludes non-members if count_non_member_votes
+    * is off and sees the fees paid out during the maintenance in a different order.  matches_recount()
+    * checks them.
+    */
+   class vote_totals
+   {
+      public:
+         /// Forgets all indexes and totals, called before the indexes of the database are recreated
+         void clear();
+
+         /// Follows the objects of the given indexes, which must be empty
+         template<typename AccountIndex, typename StatisticsIndex, typename BalanceIndex, typename VestingIndex>
+         void track( const database& db, AccountIndex& accounts, StatisticsIndex& statistics,
+                     BalanceIndex& balances, VestingIndex& vesting_balances )
+         {
+            _db = &db;
+            accounts.template add_secondary_index<watcher>()->set_owner( this, watcher::accounts );
+            statistics.template add_secondary_index<watcher>()->set_owner( this, watcher::statistics );
+            balances.template add_secondary_index<watcher>()->set_owner( this, watcher::balances );
+            vesting_balances.template add_secondary_index<watcher>()->set_owner( this, watcher::vesting_balances );
+         }
+
+         /// @return the stake voting for id
+         uint64_t votes( vote_id_type id )const;
+         /// @return the stake of all accounts whose opinion account exists
+         uint64_t total_stake()const { return _total_stake; }
+
+         /**
+          * Counts the votes again from all accounts and balances and logs every vote id whose running
+          * total differs.
+          * @return true if all totals match the recount
+          */
+         bool matches_recount()const;
+
+         class watcher : public secondary_index
+         {
+            public:
+               enum kind { accounts, statistics, balances, vesting_balances };
+
+               void set_owner( vote_totals* owner, kind k ) { _owner = owner; _kind = k; }
+
+               virtual void object_inserted( const object& obj )override;
+               virtual void object_removed( const object& obj )override;
+               virtual void about_to_modify( const object& before )override;
+               virtual void object_modified( const object& after )override;
+
+            private:
+               vote_totals* _owner = nullptr;
+               kind         _kind = accounts;
+               int64_t      _stake_before = 0;
+               account_id_type                        _voting_before;
+               flat_set<vote_id_type>                 _votes_before;
+               optional<vesting_balance_id_type>      _cashback_before;
+         };
+
+      private:
+         /// The fields of an account that its contribution to the totals depends on
+         struct voting_fields
+         {
+            account_id_type                    voting_account;
+            const flat_set<vote_id_type>*      votes;
+            optional<vesting_balance_id_type>  cashback_vb;
+         };
+
+         void add_account( account_id_type id, const voting_fields& fields, int64_t sign );
+         void add_stake( account_id_type owner, int64_t delta );
+         void add_votes( const flat_set<vote_id_type>& votes, int64_t delta );
+         int64_t vesting_balance_amount( const optional<vesting_balance_id_type>& id )const;
+         /// the amount that a vesting balance adds to the stake of its owner
+         int64_t vesting_stake( const object& obj )const;
+
+         int64_t& stake_of( account_id_type id );
+         int64_t& delegated_to( account_id_type id );
+
+         const database*       _db = nullptr;
+         /// indexed by account instance: the stake of the account, counted only if the account exists
+         std::vector<int64_t>  _stake;
+         /// indexed by account instance: the stake of the existing accounts voting with its opinions
+         std::vector<int64_t>  _delegated;
+         /// indexed by vote id instance
+         std::vector<int64_t>  _votes;
+         uint64_t              _total_stake = 0;
+   };
+
+} } // graphene::chain
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/pending_transaction_pool.hpp>
+
+namespace graphene { namespace chain {
+
+bool pending_transaction_pool::add( const processed_transaction& trx, uint32_t packed_size, uint64_t fee_per_kb,
+                                    bool authority_checked )
+{
+   if( _max_size == 0 )
+      return false;
+   if( _entries.size() >= _max_size )
+   {
+      const auto& by_fee_idx = _entries.get<by_fee>();
+      if( std::prev( by_fee_idx.end() )->fee_per_kb >= fee_per_kb )
+         return false;
+      shrink_to( _max_size - 1 );
+   }
+
+   entry e;
+   e.trx               = trx;
+   e.id                = trx.id();
+   e.expiration        = trx.expiration;
+   e.sequence          = _next_sequence++;
+   e.packed_size       = packed_size;
+   e.fee_per_kb        = fee_per_kb;
+   e.authority_checked = authority_checked;
+   _entries.insert( std::move( e ) );
+   return true;
+}
+
+void pending_transaction_pool::update( const entry& e, const processed_transaction& applied, uint32_t packed_size )
+{
+   auto itr = _entries.iterator_to( e );
+   _entries.modify( itr, [&]( entry& changed ) {
+      changed.trx.operation_results = applied.operation_results;
+      changed.packed_size = packed_size;
+   });
+}
+
+size_t pending_transaction_pool::remove_expired( time_point_sec now )
+{
+   auto& by_expiration_idx = _entries.get<by_expiration>();
+   auto end = by_expiration_idx.lower_bound( now );
+   const size_t removed = std::distance( by_expiration_idx.begin(), end );
+   by_expiration_idx.erase( by_expiration_idx.begin(), end );
+   return removed;
+}
+
+void pending_transaction_pool::swap( pending_transaction_pool& other )
+{
+   _entries.swap( other._entries );
+   std::swap( _next_sequence, other._next_sequence );
+}
+
+void pending_transaction_pool::set_max_size( size_t max_size )
+{
+   _max_size = max_size;
+   shrink_to( _max_size );
+}
+
+bool pending_transaction_pool::contains( const transaction_id_type& id )const
+{
+   const auto& by_id_idx = _entries.get<by_id>();
+   return by_id_idx.find( id ) != by_id_idx.end();
+}
+
+void pending_transaction_pool::shrink_to( size_t max_size )
+{
+   auto& by_fee_idx = _entries.get<by_fee>();
+   while( _entries.size() > max_size )
+      by_fee_idx.erase( std::prev( by_fee_idx.end() ) );
+}
+
+} } // graphene::chain
@@ -23,6 +23,7 @@
  */
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
+#include <graphene/chain/signature_key_cache.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/bitutil.hpp>
 #include <fc/smart_ref_impl.hpp>
@@ -311,7 +312,28 @@ flat_set<public_key_type> signed_transaction::get_signature_keys( const chain_id
    return result;
 } FC_CAPTURE_AND_RETHROW() }
 
-
+flat_set<public_key_type> signed_transaction::get_signature_keys( const chain_id_type& chain_id,
+                                                                  signature_key_cache& cache,
+                                                                  bool remember )const
+{ try {
+   auto d = sig_digest( chain_id );
+   flat_set<public_key_type> result;
+   for( const auto&  sig : signatures )
+   {
+      optional<public_key_type> key = cache.find( d, sig );
+      if( !key.valid() )
+      {
+         key = public_key_type( fc::ecc::public_key(sig,d) );
+         if( remember )
+            cache.insert( d, sig, *key, expiration );
+      }
+      GRAPHENE_ASSERT(
+         result.insert( *key ).second,
+         tx_duplicate_sig,
+         "Duplicate Signature detected" );
+   }
+   return result;
+} FC_CAPTURE_AND_RETHROW() }
 
 set<public_key_type> signed_transaction::get_required_signatures(
    const chain_id_type& chain_id,
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/read_write_lock.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include <cassert>
+
+namespace graphene { namespace chain {
+
+void read_write_lock::lock()
+{
+   uint32_t* depth = _write_depth.get();
+   if( depth != nullptr && *depth > 0 )
+   {
+      ++*depth;
+      return;
+   }
+
+   // blocks the task while another one owns the write side
+   _writer.lock();
+   try
+   {
+      wait_for_readers();
+   }
+   catch( ... )
+   {
+      {
+         std::lock_guard<std::mutex> guard( _mutex );
+         _writing = false;
+      }
+      _readers_may_enter.notify_all();
+      _writer.unlock();
+      throw;
+   }
+   if( depth == nullptr )
+      _write_depth.reset( new uint32_t( 1 ) );
+   else
+      *depth = 1;
+}
+
+void read_write_lock::unlock()
+{
+   uint32_t* depth = _write_depth.get();
+   assert( depth != nullptr && *depth > 0 );
+   if( --*depth > 0 )
+      return;
+   {
+      std::lock_guard<std::mutex> guard( _mutex );
+      _writing = false;
+   }
+   _readers_may_enter.notify_all();
+   _writer.unlock();
+}
+
+void read_write_lock::wait_for_readers()
+{
+   {
+      std::lock_guard<std::mutex> guard( _mutex );
+      _writing = true;
+      if( _readers == 0 )
+         return;
+   }
+   // new readers are held back now, wait for the ones inside to leave
+   for( ;; )
+   {
+      fc::usleep( fc::microseconds( 100 ) );
+      std::lock_guard<std::mutex> guard( _mutex );
+      if( _readers == 0 )
+         return;
+   }
+}
+
+void read_write_lock::lock_shared()
+{
+   std::unique_lock<std::mutex> guard( _mutex );
+   _readers_may_enter.wait( guard, [this]() { return !_writing; } );
+   ++_readers;
+}
+
+void read_write_lock::unlock_shared()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   --_readers;
+}
+
+} } // graphene::chain
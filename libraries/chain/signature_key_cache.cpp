@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/signature_key_cache.hpp>
+
+#include <fc/thread/scoped_lock.hpp>
+
+namespace graphene { namespace chain {
+
+optional<public_key_type> signature_key_cache::find( const digest_type& digest, const signature_type& sig )const
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   const auto& idx = _entries.get<by_signature>();
+   auto itr = idx.find( boost::make_tuple( digest, sig ) );
+   if( itr == idx.end() )
+      return optional<public_key_type>();
+   return itr->key;
+}
+
+void signature_key_cache::insert( const digest_type& digest, const signature_type& sig,
+                                  const public_key_type& key, fc::time_point_sec expiration )
+{
+   if( _max_size == 0 )
+      return;
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   auto& idx = _entries.get<by_signature>();
+   auto itr = idx.find( boost::make_tuple( digest, sig ) );
+   if( itr != idx.end() )
+   {
+      if( itr->expiration < expiration )
+         idx.modify( itr, [&]( entry& e ) { e.expiration = expiration; } );
+      return;
+   }
+   shrink_to( _max_size - 1 );
+   _entries.insert( entry{ digest, sig, key, expiration } );
+}
+
+void signature_key_cache::remove_expired( fc::time_point_sec now )
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   auto& idx = _entries.get<by_expiration>();
+   idx.erase( idx.begin(), idx.lower_bound( now ) );
+}
+
+void signature_key_cache::clear()
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   _entries.clear();
+}
+
+size_t signature_key_cache::size()const
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   return _entries.size();
+}
+
+void signature_key_cache::set_max_size( size_t max_size )
+{
+   fc::scoped_lock<fc::mutex> lock( _mutex );
+   _max_size = max_size;
+   shrink_to( _max_size );
+}
+
+void signature_key_cache::shrink_to( size_t max_size )
+{
+   auto& idx = _entries.get<by_expiration>();
+   while( idx.size() > max_size )
+      idx.erase( idx.begin() );
+}
+
+} } // graphene::chain
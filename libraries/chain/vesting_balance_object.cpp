@@ -237,4 +237,64 @@ asset vesting_balance_object::get_allowed_withdraw(const time_point_sec& now)con
    return policy.visit(get_allowed_withdraw_visitor(balance, now, amount));
 }
 
+void vesting_balance_holder_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const vesting_balance_object*>(&obj) );
+   const vesting_balance_object& vbo = static_cast<const vesting_balance_object&>(obj);
+   adjust( vbo.owner, vbo.balance );
+}
+
+void vesting_balance_holder_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const vesting_balance_object*>(&obj) );
+   const vesting_balance_object& vbo = static_cast<const vesting_balance_object&>(obj);
+   adjust( vbo.owner, -vbo.balance );
+}
+
+void vesting_balance_holder_index::about_to_modify( const object& before )
+{
+   assert( dynamic_cast<const vesting_balance_object*>(&before) );
+   const vesting_balance_object& vbo = static_cast<const vesting_balance_object&>(before);
+   _before_owner = vbo.owner;
+   _before_balance = vbo.balance;
+}
+
+void vesting_balance_holder_index::object_modified( const object& after )
+{
+   assert( dynamic_cast<const vesting_balance_object*>(&after) );
+   const vesting_balance_object& vbo = static_cast<const vesting_balance_object&>(after);
+   if( vbo.owner == _before_owner && vbo.balance.asset_id == _before_balance.asset_id )
+   {
+      if( vbo.balance.amount != _before_balance.amount )
+         adjust( vbo.owner, vbo.balance - _before_balance );
+      return;
+   }
+   adjust( _before_owner, -_before_balance );
+   adjust( vbo.owner, vbo.balance );
+}
+
+void vesting_balance_holder_index::adjust( account_id_type owner, const asset& delta )
+{
+   if( delta.amount == 0 )
+      return;
+   holder_map& holders = _holders[delta.asset_id];
+   auto itr = holders.find( owner );
+   if( itr == holders.end() )
+      itr = holders.emplace( owner, share_type() ).first;
+   itr->second += delta.amount;
+   if( itr->second == 0 )
+   {
+      holders.erase( itr );
+      if( holders.empty() )
+         _holders.erase( delta.asset_id );
+   }
+}
+
+const vesting_balance_holder_index::holder_map& vesting_balance_holder_index::get_holders( asset_id_type asset_id )const
+{
+   static const holder_map empty;
+   auto itr = _holders.find( asset_id );
+   return itr == _holders.end() ? empty : itr->second;
+}
+
 } } // graphene::chain
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/vote_tally.hpp>
+
+#include <graphene/utilities/thread_pool.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace chain {
+
+vote_tally::vote_tally( uint32_t next_available_vote_id, uint16_t maximum_witness_count,
+                        uint16_t maximum_committee_count )
+   : _maximum_witness_count( maximum_witness_count ),
+     _maximum_committee_count( maximum_committee_count ),
+     _votes( next_available_vote_id ),
+     _witness_histogram( maximum_witness_count / 2 + 1 ),
+     _committee_histogram( maximum_committee_count / 2 + 1 )
+{
+}
+
+void vote_tally::tally_range( const std::vector<voter>& voters, size_t begin, size_t end, buffers& out )const
+{
+   for( size_t i = begin; i < end; ++i )
+   {
+      if( voters[i].opinion == nullptr )
+         continue;
+      const account_options& opinion = *voters[i].opinion;
+      const uint64_t stake = voters[i].stake;
+      for( vote_id_type id : opinion.votes )
+      {
+         uint32_t offset = id.instance();
+         // if they somehow managed to specify an illegal offset, ignore it.
+         if( offset < out.votes.size() )
+            out.votes[offset] += stake;
+      }
+
+      if( opinion.num_witness <= _maximum_witness_count )
+      {
+         // votes for a number greater than maximum_witness_count
+         // are turned into votes for maximum_witness_count.
+         //
+         // in particular, this takes care of the case where a
+         // member was voting for a high number, then the
+         // parameter was lowered.
+         size_t offset = std::min( size_t(opinion.num_witness/2), out.witness_histogram.size() - 1 );
+         out.witness_histogram[offset] += stake;
+      }
+      if( opinion.num_committee <= _maximum_committee_count )
+      {
+         // same rationale as for witnesses
+         size_t offset = std::min( size_t(opinion.num_committee/2), out.committee_histogram.size() - 1 );
+         out.committee_histogram[offset] += stake;
+      }
+
+      out.total_stake += stake;
+   }
+}
+
+void vote_tally::tally( const std::vector<voter>& voters, graphene::utilities::thread_pool* pool )
+{
+   buffers total;
+   total.votes.swap( _votes );
+   total.witness_histogram.swap( _witness_histogram );
+   total.committee_histogram.swap( _committee_histogram );
+   total.total_stake = _total_stake;
+
+   const size_t ranges = pool ? std::min<size_t>( pool->size(), voters.size() / 1024 ) : 0;
+   if( ranges < 2 )
+      tally_range( voters, 0, voters.size(), total );
+   else
+   {
+      // one range of voters per worker, the first one accumulates directly into total
+      std::vector<buffers> partial( ranges - 1 );
+      for( auto& b : partial )
+      {
+         b.votes.resize( total.votes.size() );
+         b.witness_histogram.resize( total.witness_histogram.size() );
+         b.committee_histogram.resize( total.committee_histogram.size() );
+      }
+      pool->for_each_range( ranges, [&]( size_t first, size_t last )
+      {
+         for( size_t r = first; r < last; ++r )
+            tally_range( voters, voters.size() * r / ranges, voters.size() * (r + 1) / ranges,
+                         r == 0 ? total : partial[r - 1] );
+      });
+      for( const auto& b : partial )
+      {
+         for( size_t i = 0; i < b.votes.size(); ++i )
+            total.votes[i] += b.votes[i];
+         for( size_t i = 0; i < b.witness_histogram.size(); ++i )
+            total.witness_histogram[i] += b.witness_histogram[i];
+         for( size_t i = 0; i < b.committee_histogram.size(); ++i )
+            total.committee_histogram[i] += b.committee_histogram[i];
+         total.total_stake += b.total_stake;
+      }
+   }
+
+   _votes.swap( total.votes );
+   _witness_histogram.swap( total.witness_histogram );
+   _committee_histogram.swap( total.committee_histogram );
+   _total_stake = total.total_stake;
+}
+
+} } // graphene::chain
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/vote_totals.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/vesting_balance_object.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace chain {
+
+namespace {
+   account_id_type opinion_account_of( account_id_type id, account_id_type voting_account )
+   {
+      return voting_account == GRAPHENE_PROXY_TO_SELF_ACCOUNT ? id : voting_account;
+   }
+
+   template<typename T>
+   T& grow_to( std::vector<T>& v, size_t i )
+   {
+      if( i >= v.size() )
+         v.resize( std::max( i + 1, v.size() * 2 ) );
+      return v[i];
+   }
+}
+
+void vote_totals::clear()
+{
+   _db = nullptr;
+   _stake.clear();
+   _delegated.clear();
+   _votes.clear();
+   _total_stake = 0;
+}
+
+uint64_t vote_totals::votes( vote_id_type id )const
+{
+   return id.instance() < _votes.size() ? uint64_t( _votes[id.instance()] ) : 0;
+}
+
+int64_t& vote_totals::stake_of( account_id_type id )
+{
+   return grow_to( _stake, id.instance.value );
+}
+
+int64_t& vote_totals::delegated_to( account_id_type id )
+{
+   return grow_to( _delegated, id.instance.value );
+}
+
+void vote_totals::add_votes( const flat_set<vote_id_type>& votes, int64_t delta )
+{
+   for( vote_id_type id : votes )
+      grow_to( _votes, id.instance() ) += delta;
+   _total_stake += delta;
+}
+
+void vote_totals::add_stake( account_id_type owner, int64_t delta )
+{
+   if( delta == 0 )
+      return;
+   stake_of( owner ) += delta;
+   const account_object* account = _db->find( owner );
+   if( account == nullptr )
+      return;
+   const account_id_type opinion_id = opinion_account_of( owner, account->options.voting_account );
+   delegated_to( opinion_id ) += delta;
+   const account_object* opinion = opinion_id == owner ? account : _db->find( opinion_id );
+   if( opinion != nullptr )
+      add_votes( opinion->options.votes, delta );
+}
+
+void vote_totals::add_account( account_id_type id, const voting_fields& fields, int64_t sign )
+{
+   // Inserting adds the stake voting with the account's opinions first, then the account's own stake,
+   // so its own stake is not counted twice when it votes for itself.  Removing goes the other way.
+   auto add_opinions = [&]() {
+      add_votes( *fields.votes, sign * delegated_to( id ) );
+   };
+   auto add_own_stake = [&]() {
+      const account_id_type opinion_id = opinion_account_of( id, fields.voting_account );
+      const int64_t stake = sign * stake_of( id );
+      delegated_to( opinion_id ) += stake;
+      if( opinion_id == id )
+         add_votes( *fields.votes, stake );
+      else if( const account_object* opinion = _db->find( opinion_id ) )
+         add_votes( opinion->options.votes, stake );
+   };
+
+   if( sign > 0 )
+   {
+      add_opinions();
+      stake_of( id ) += vesting_balance_amount( fields.cashback_vb );
+      add_own_stake();
+   }
+   else
+   {
+      add_own_stake();
+      stake_of( id ) -= vesting_balance_amount( fields.cashback_vb );
+      add_opinions();
+   }
+}
+
+int64_t vote_totals::vesting_balance_amount( const optional<vesting_balance_id_type>& id )const
+{
+   if( !id.valid() )
+      return 0;
+   const vesting_balance_object* vbo = _db->find( *id );
+   return vbo != nullptr ? vbo->balance.amount.value : 0;
+}
+
+int64_t vote_totals::vesting_stake( const object& obj )const
+{
+   const auto& vbo = static_cast<const vesting_balance_object&>( obj );
+   int64_t result = vbo.balance.asset_id == asset_id_type() ? vbo.balance.amount.value : 0;
+   // the cashback balance is counted on its own as well
+   const account_object* owner = _db->find( vbo.owner );
+   if( owner != nullptr && owner->cashback_vb.valid() && *owner->cashback_vb == vbo.id )
+      result += vbo.balance.amount.value;
+   return result;
+}
+
+void vote_totals::watcher::object_inserted( const object& obj )
+{
+   switch( _kind )
+   {
+      case accounts:
+      {
+         const auto& a = static_cast<const account_object&>( obj );
+         _owner->add_account( a.id, { a.options.voting_account, &a.options.votes, a.cashback_vb }, 1 );
+         break;
+      }
+      case statistics:
+      {
+         const auto& s = static_cast<const account_statistics_object&>( obj );
+         _owner->add_stake( s.owner, s.total_core_in_orders.value );
+         break;
+      }
+      case balances:
+      {
+         const auto& b = static_cast<const account_balance_object&>( obj );
+         if( b.asset_type == asset_id_type() )
+            _owner->add_stake( b.owner, b.balance.value );
+         break;
+      }
+      case vesting_balances:
+         _owner->add_stake( static_cast<const vesting_balance_object&>( obj ).owner, _owner->vesting_stake( obj ) );
+         break;
+   }
+}
+
+void vote_totals::watcher::object_removed( const object& obj )
+{
+   switch( _kind )
+   {
+      case accounts:
+      {
+         const auto& a = static_cast<const account_object&>( obj );
+         _owner->add_account( a.id, { a.options.voting_account, &a.options.votes, a.cashback_vb }, -1 );
+         break;
+      }
+      case statistics:
+      {
+         const auto& s = static_cast<const account_statistics_object&>( obj );
+         _owner->add_stake( s.owner, -s.total_core_in_orders.value );
+         break;
+      }
+      case balances:
+      {
+         const auto& b = static_cast<const account_balance_object&>( obj );
+         if( b.asset_type == asset_id_type() )
+            _owner->add_stake( b.owner, -b.balance.value );
+         break;
+      }
+      case vesting_balances:
+         _owner->add_stake( static_cast<const vesting_balance_object&>( obj ).owner, -_owner->vesting_stake( obj ) );
+         break;
+   }
+}
+
+void vote_totals::watcher::about_to_modify( const object& before )
+{
+   switch( _kind )
+   {
+      case accounts:
+      {
+         const auto& a = static_cast<const account_object&>( before );
+         _voting_before = a.options.voting_account;
+         _votes_before = a.options.votes;
+         _cashback_before = a.cashback_vb;
+         break;
+      }
+      case statistics:
+         _stake_before = static_cast<const account_statistics_object&>( before ).total_core_in_orders.value;
+         break;
+      case balances:
+      {
+         const auto& b = static_cast<const account_balance_object&>( before );
+         _stake_before = b.asset_type == asset_id_type() ? b.balance.value : 0;
+         break;
+      }
+      case vesting_balances:
+         _stake_before = _owner->vesting_stake( before );
+         break;
+   }
+}
+
+void vote_totals::watcher::object_modified( const object& after )
+{
+   switch( _kind )
+   {
+      case accounts:
+      {
+         const auto& a = static_cast<const account_object&>( after );
+         if( a.options.voting_account == _voting_before && a.options.votes == _votes_before
+             && a.cashback_vb == _cashback_before )
+            break;
+         _owner->add_account( a.id, { _voting_before, &_votes_before, _cashback_before }, -1 );
+         _owner->add_account( a.id, { a.options.voting_account, &a.options.votes, a.cashback_vb }, 1 );
+         break;
+      }
+      case statistics:
+      {
+         const auto& s = static_cast<const account_statistics_object&>( after );
+         _owner->add_stake( s.owner, s.total_core_in_orders.value - _stake_before );
+         break;
+      }
+      case balances:
+      {
+         const auto& b = static_cast<const account_balance_object&>( after );
+         if( b.asset_type == asset_id_type() )
+            _owner->add_stake( b.owner, b.balance.value - _stake_before );
+         break;
+      }
+      case vesting_balances:
+         _owner->add_stake( static_cast<const vesting_balance_object&>( after ).owner,
+                            _owner->vesting_stake( after ) - _stake_before );
+         break;
+   }
+}
+
+bool vote_totals::matches_recount()const
+{
+   std::vector<int64_t> recounted( _votes.size() );
+   const auto& vesting_by_owner = _db->get_index_type<vesting_balance_index>().indices().get<by_account>();
+   for( const account_object& account : _db->get_index_type<account_index>().indices() )
+   {
+      const account_id_type opinion_id = opinion_account_of( account.id, account.options.voting_account );
+      const account_object* opinion = _db->find( opinion_id );
+      if( opinion == nullptr )
+         continue;
+
+      int64_t stake = account.statistics( *_db ).total_core_in_orders.value
+                    + _db->get_balance( account.id, asset_id_type() ).amount.value
+                    + vesting_balance_amount( account.cashback_vb );
+      auto range = vesting_by_owner.equal_range( account.id );
+      for( auto itr = range.first; itr != range.second; ++itr )
+         if( itr->balance.asset_id == asset_id_type() )
+            stake += itr->balance.amount.value;
+
+      for( vote_id_type id : opinion->options.votes )
+         grow_to( recounted, id.instance() ) += stake;
+   }
+
+   bool result = true;
+   recounted.resize( std::max( recounted.size(), _votes.size() ) );
+   for( size_t i = 0; i < recounted.size(); ++i )
+   {
+      const int64_t running = i < _votes.size() ? _votes[i] : 0;
+      if( running != recounted[i] )
+      {
+         elog( "Vote total of vote id instance ${i} is ${r}, the recount gives ${c}",
+               ("i", i)("r", running)("c", recounted[i]) );
+         result = false;
+      }
+   }
+   return result;
+}
+
+} } // graphene::chain
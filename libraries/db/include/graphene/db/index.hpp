@@ -28,6 +28,7 @@
 #include <fc/io/json.hpp>
 #include <fc/crypto/sha256.hpp>
 #include <fstream>
+#include <unordered_set>
 
 namespace graphene { namespace db {
    class object_database;
@@ -49,6 +50,20 @@ namespace graphene { namespace db {
          virtual void on_modify( const object& obj ){}
    };
 
+   /**
+    *  The objects of one index that changed between two saves, see object_database::save_checkpoint()
+    */
+   struct index_changes
+   {
+      uint8_t                          space_id = 0;
+      uint8_t                          type_id  = 0;
+      object_id_type                   next_id;
+      /** objects created or modified, packed */
+      std::vector< std::vector<char> > objects;
+      /** instances of the objects removed */
+      std::vector< uint64_t >          removed;
+   };
+
    /**
     *  @class index
     *  @brief abstract base class for accessing objects indexed in various ways.
@@ -96,6 +111,40 @@ namespace graphene { namespace db {
          virtual void open( const fc::path& db ) = 0;
          virtual void save( const fc::path& db ) = 0;
 
+         /**
+          *  open() split in two: read_objects() unpacks the file into a buffer owned by this index and
+          *  may run concurrently with other indexes, insert_read_objects() then inserts the buffered
+          *  objects and must run on the thread that owns the database.
+          */
+         virtual void read_objects( const fc::path& db ) = 0;
+         virtual void insert_read_objects() = 0;
+
+         /**
+          *  Packs the next id and every object of the index, in the format used by save(), into a
+          *  state snapshot section.
+          *  @param object_count set to the number of objects packed
+          */
+         virtual std::vector<char> pack_snapshot( uint64_t& object_count )const = 0;
+         /**
+          *  Loads a section packed by pack_snapshot() into this (empty) index
+          *  @return the number of objects loaded
+          */
+         virtual uint64_t          unpack_snapshot( const char* data, size_t size ) = 0;
+
+         /**
+          *  While change tracking is enabled the index remembers the objects it creates, modifies
+          *  or removes until they are saved by save() or pack_changes().
+          */
+         virtual void              enable_change_tracking( bool enable ) = 0;
+         /**
+          *  Packs the objects changed since they were last saved, as they are now or, if undo_base is
+          *  set, as they were before the states in the undo history were applied.  Objects that differ
+          *  from what was packed stay marked as changed.
+          */
+         virtual index_changes     pack_changes( bool undo_base ) = 0;
+         /** Applies changes packed by pack_changes(), used while loading */
+         virtual void              apply_changes( const index_changes& changes ) = 0;
+
 
 
          /** @return the object with id or nullptr if not found */
@@ -164,6 +213,9 @@ namespace graphene { namespace db {
          /** called just after obj is modified */
          void on_modify( const object& obj );
 
+         /** called by the undo history before it restores a removed object */
+         void on_restore( const object& obj );
+
          template<typename T>
          T* add_secondary_index()
          {
@@ -183,9 +235,17 @@ namespace graphene { namespace db {
          }
 
       protected:
+         void mark_changed( object_id_type id ) { if( _track_changes ) _changed.insert( id ); }
+         /** @see undo_database::find_original() */
+         bool find_original( object_id_type id, const object*& value )const;
+         bool find_original_next_id( object_id_type& next_id )const;
+
          vector< shared_ptr<index_observer> >   _observers;
          vector< unique_ptr<secondary_index> >  _sindex;
 
+         bool                                   _track_changes = false;
+         std::unordered_set<object_id_type>     _changed;
+
       private:
          object_database& _db;
    };
@@ -224,7 +284,14 @@ namespace graphene { namespace db {
          }
 
          virtual void open( const path& db )override
-         { 
+         {
+            read_objects( db );
+            insert_read_objects();
+         }
+
+         virtual void read_objects( const path& db )override
+         {
+            _read_objects.clear();
             if( !fc::exists( db ) ) return;
             fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
             fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
@@ -235,13 +302,30 @@ namespace graphene { namespace db {
             fc::raw::unpack(ds, open_ver);
             FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
             try {
-               vector<char> tmp;
-               while( true ) 
+               while( ds.remaining() > 0 )
                {
-                  fc::raw::unpack( ds, tmp );
-                  load( tmp );
+                  // each object is stored as a packed vector<char>, unpack it in place
+                  fc::unsigned_int size;
+                  fc::raw::unpack( ds, size );
+                  FC_ASSERT( ds.remaining() >= size.value );
+                  fc::datastream<const char*> obj_ds( ds.pos(), size.value );
+                  object_type obj;
+                  fc::raw::unpack( obj_ds, obj );
+                  _read_objects.emplace_back( std::move( obj ) );
+                  ds.skip( size.value );
                }
-            } catch ( const fc::exception&  ){}
+            } catch ( const fc::exception&  ){} // a truncated trailing object is dropped, as before
+         }
+
+         virtual void insert_read_objects()override
+         {
+            for( auto& obj : _read_objects )
+            {
+               const auto& result = DerivedIndex::insert( std::move( obj ) );
+               for( const auto& item : _sindex )
+                  item->object_inserted( result );
+            }
+            std::vector<object_type>().swap( _read_objects );
          }
 
          virtual void save( const path& db ) override 
@@ -252,11 +336,127 @@ namespace graphene { namespace db {
             auto ver  = get_object_version();
             fc::raw::pack( out, _next_id );
             fc::raw::pack( out, ver );
+            std::vector<char> vec;
+            this->inspect_all_objects( [&]( const object& o ) {
+                // same bytes as fc::raw::pack( vec ), without the second copy
+                const auto& obj = static_cast<const object_type&>(o);
+                vec.resize( fc::raw::pack_size( obj ) );
+                fc::datastream<char*> ds( vec.data(), vec.size() );
+                fc::raw::pack( ds, obj );
+                fc::raw::pack( out, fc::unsigned_int( vec.size() ) );
+                out.write( vec.data(), vec.size() );
+            });
+            _changed.clear();
+         }
+
+         virtual void enable_change_tracking( bool enable )override
+         {
+            _track_changes = enable;
+            _changed.clear();
+         }
+
+         virtual index_changes pack_changes( bool undo_base )override
+         {
+            index_changes result;
+            result.space_id = object_type::space_id;
+            result.type_id  = object_type::type_id;
+            result.next_id  = _next_id;
+            if( undo_base )
+               find_original_next_id( result.next_id );
+
+            std::unordered_set<object_id_type> still_changed;
+            for( const auto& id : _changed )
+            {
+               const object* value = this->find( id );
+               if( undo_base && find_original( id, value ) )
+                  still_changed.insert( id );
+               if( value != nullptr )
+                  result.objects.emplace_back( fc::raw::pack( static_cast<const object_type&>( *value ) ) );
+               else
+                  result.removed.push_back( id.instance() );
+            }
+            _changed.swap( still_changed );
+            return result;
+         }
+
+         virtual void apply_changes( const index_changes& changes )override
+         {
+            FC_ASSERT( changes.space_id == object_type::space_id && changes.type_id == object_type::type_id );
+            _next_id = changes.next_id;
+
+            std::vector<object_type> objects;
+            objects.reserve( changes.objects.size() );
+            for( const auto& packed : changes.objects )
+               objects.emplace_back( fc::raw::unpack<object_type>( packed ) );
+
+            // take out every old version first, a new one may reuse the unique keys of another
+            auto take_out = [&]( object_id_type id ) {
+               const object* existing = this->find( id );
+               if( existing == nullptr )
+                  return;
+               for( const auto& item : _sindex )
+                  item->object_removed( *existing );
+               DerivedIndex::remove( *existing );
+            };
+            for( const auto& instance : changes.removed )
+               take_out( object_id_type( object_type::space_id, object_type::type_id, instance ) );
+            for( const auto& obj : objects )
+               take_out( obj.id );
+
+            for( auto& obj : objects )
+            {
+               const auto& result = DerivedIndex::insert( std::move( obj ) );
+               for( const auto& item : _sindex )
+                  item->object_inserted( result );
+            }
+         }
+
+         virtual std::vector<char> pack_snapshot( uint64_t& object_count )const override
+         {
+            std::vector< std::vector<char> > objects;
             this->inspect_all_objects( [&]( const object& o ) {
-                auto vec = fc::raw::pack( static_cast<const object_type&>(o) );
-                auto packed_vec = fc::raw::pack( vec );
-                out.write( packed_vec.data(), packed_vec.size() );
+                objects.emplace_back( fc::raw::pack( static_cast<const object_type&>(o) ) );
             });
+            object_count = objects.size();
+
+            auto ver = get_object_version();
+            fc::datastream<size_t> sizer;
+            fc::raw::pack( sizer, _next_id );
+            fc::raw::pack( sizer, ver );
+            fc::raw::pack( sizer, objects );
+            std::vector<char> result( sizer.tellp() );
+            fc::datastream<char*> ds( result.data(), result.size() );
+            fc::raw::pack( ds, _next_id );
+            fc::raw::pack( ds, ver );
+            fc::raw::pack( ds, objects );
+            return result;
+         }
+
+         virtual uint64_t unpack_snapshot( const char* data, size_t size )override
+         {
+            fc::datastream<const char*> ds( data, size );
+            fc::sha256 open_ver;
+            fc::raw::unpack( ds, _next_id );
+            fc::raw::unpack( ds, open_ver );
+            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+            fc::unsigned_int count;
+            fc::raw::unpack( ds, count );
+            std::vector<char> tmp;
+            for( uint64_t i = 0; i < count.value; ++i )
+            {
+               fc::raw::unpack( ds, tmp );
+               load( tmp );
+            }
+            return count.value;
+         }
+
+         virtual const object&  insert( object&& obj )override
+         {
+            on_restore( obj );
+            const object& result = DerivedIndex::insert( std::move( obj ) );
+            for( const auto& item : _sindex )
+               item->object_inserted( result );
+            return result;
          }
 
          virtual const object&  load( const std::vector<char>& data )override
@@ -320,7 +520,10 @@ namespace graphene { namespace db {
          }
 
       private:
-         object_id_type _next_id;
+         object_id_type              _next_id;
+         std::vector<object_type>    _read_objects;
    };
 
 } } // graphene::db
+
+FC_REFLECT( graphene::db::index_changes, (space_id)(type_id)(next_id)(objects)(removed) )
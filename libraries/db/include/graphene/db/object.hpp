@@ -27,8 +27,66 @@
 #include <fc/crypto/city.hpp>
 #include <fc/uint128.hpp>
 
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <vector>
+
 namespace graphene { namespace db {
 
+   class object;
+
+   /** Destroys objects made by object::clone_pooled() */
+   struct pooled_object_deleter
+   {
+      void operator()( object* obj )const;
+   };
+   typedef std::unique_ptr<object, pooled_object_deleter> pooled_object_ptr;
+
+   /**
+    *  Per thread free list of memory blocks for objects of type T.  The undo history copies objects
+    *  before every first change in every session and drops the copies as soon as the session is
+    *  merged or undone; recycling their memory keeps that off the general purpose allocator.
+    */
+   template<typename T>
+   class object_pool
+   {
+      public:
+         static void* allocate()
+         {
+            auto& blocks = free_list().blocks;
+            if( blocks.empty() )
+               return ::operator new( sizeof(T) );
+            void* block = blocks.back();
+            blocks.pop_back();
+            return block;
+         }
+
+         static void release( void* block )
+         {
+            auto& blocks = free_list().blocks;
+            if( blocks.size() < max_free_blocks() )
+               blocks.push_back( block );
+            else
+               ::operator delete( block );
+         }
+
+      private:
+         /// keep about 1 MiB per type and thread
+         static size_t max_free_blocks() { return std::max<size_t>( 16, (1 << 20) / sizeof(T) ); }
+
+         struct blocks_list
+         {
+            ~blocks_list() { for( void* block : blocks ) ::operator delete( block ); }
+            std::vector<void*> blocks;
+         };
+         static blocks_list& free_list()
+         {
+            static thread_local blocks_list list;
+            return list;
+         }
+   };
+
    /**
     *  @brief base for all database objects
     *
@@ -72,6 +130,10 @@ namespace graphene { namespace db {
 
          /// these methods are implemented for derived classes by inheriting abstract_object<DerivedClass>
          virtual unique_ptr<object> clone()const = 0;
+         /// like clone(), but the copy is allocated from an @ref object_pool
+         virtual pooled_object_ptr  clone_pooled()const { return pooled_object_ptr( clone().release() ); }
+         /// destroys an object made by clone_pooled()
+         virtual void               destroy_pooled() { delete this; }
          virtual void               move_from( object& obj ) = 0;
          virtual variant            to_variant()const  = 0;
          virtual vector<char>       pack()const = 0;
@@ -94,6 +156,24 @@ namespace graphene { namespace db {
             return unique_ptr<object>(new DerivedClass( *static_cast<const DerivedClass*>(this) ));
          }
 
+         virtual pooled_object_ptr clone_pooled()const
+         {
+            void* block = object_pool<DerivedClass>::allocate();
+            try {
+               return pooled_object_ptr( new (block) DerivedClass( *static_cast<const DerivedClass*>(this) ) );
+            } catch( ... ) {
+               object_pool<DerivedClass>::release( block );
+               throw;
+            }
+         }
+
+         virtual void    destroy_pooled()
+         {
+            DerivedClass* self = static_cast<DerivedClass*>(this);
+            self->~DerivedClass();
+            object_pool<DerivedClass>::release( self );
+         }
+
          virtual void    move_from( object& obj )
          {
             static_cast<DerivedClass&>(*this) = std::move( static_cast<DerivedClass&>(obj) );
@@ -106,6 +186,12 @@ namespace graphene { namespace db {
          }
    };
 
+   inline void pooled_object_deleter::operator()( object* obj )const
+   {
+      if( obj != nullptr )
+         obj->destroy_pooled();
+   }
+
    typedef flat_map<uint8_t, object_id_type> annotation_map;
 
    /**
@@ -27,10 +27,14 @@
 #include <graphene/db/undo_database.hpp>
 
 #include <fc/log/logger.hpp>
+#include <fc/thread/future.hpp>
 
 #include <map>
 
+namespace graphene { namespace utilities { class thread_pool; } }
+
 namespace graphene { namespace db {
+   namespace detail { class changes_log; }
 
    /**
     *   @class object_database
@@ -47,9 +51,35 @@ namespace graphene { namespace db {
          void open(const fc::path& data_dir );
 
          /**
-          * Saves the complete state of the object_database to disk, this could take a while
+          *  Index files are independent of each other: when a pool is set, open() reads and unpacks
+          *  them on its threads (objects are still inserted on the calling thread) and flush() saves
+          *  them in parallel.  The pool is not owned and may be null.
+          */
+         void set_thread_pool( graphene::utilities::thread_pool* pool ) { _thread_pool = pool; }
+
+         /**
+          *  With incremental saves the indexes remember which objects they create, modify or remove,
+          *  and flush() appends only those objects to object_database/changes.log.  Every index is
+          *  rewritten instead once the log has grown to half the size of the index files.  Must be
+          *  set before open().
+          */
+         void set_incremental_save( bool enable ) { _incremental_save = enable; }
+         bool incremental_save()const { return _incremental_save; }
+
+         /**
+          * Saves the state of the object_database to disk, this could take a while unless incremental
+          * saves are enabled.  Index files are replaced all at once, so that an interrupted flush()
+          * leaves the previous state in place.
           */
          void flush();
+
+         /**
+          *  Appends the objects changed since the last save to the changes log, as they were before
+          *  the states in the undo history were applied.  The log thus always describes a state that
+          *  can no longer be undone and may be loaded by open() after an unclean shutdown.  The file
+          *  is written on the thread pool when there is one.  Requires incremental saves.
+          */
+         void save_checkpoint();
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
@@ -75,6 +105,9 @@ namespace graphene { namespace db {
          const index&  get_index()const { return get_index(T::space_id,T::type_id); }
          const index&  get_index(uint8_t space_id, uint8_t type_id)const;
          const index&  get_index(object_id_type id)const { return get_index(id.space(),id.type()); }
+
+         /// @return every registered index, ordered by space and type
+         vector<const index*> get_indexes()const;
          /// @}
 
          const object& get_object( object_id_type id )const;
@@ -164,8 +197,18 @@ namespace graphene { namespace db {
          void save_undo_add( const object& obj );
          void save_undo_remove( const object& obj );
 
+         vector<index_changes> pack_changes( bool undo_base );
+         /** @return false if writing the changes log has failed since the last full flush() */
+         bool wait_for_changes();
+
          fc::path                                                  _data_dir;
          vector< vector< unique_ptr<index> > >                     _index;
+         graphene::utilities::thread_pool*                         _thread_pool = nullptr;
+
+         bool                                                      _incremental_save = false;
+         std::shared_ptr<detail::changes_log>                      _changes_log;
+         fc::future<void>                                          _changes_write;
+         bool                                                      _changes_failed = false;
    };
 
 } } // graphene::db
@@ -24,6 +24,9 @@
 #pragma once
 #include <graphene/db/object.hpp>
 #include <deque>
+#include <algorithm>
+#include <iterator>
+#include <vector>
 #include <fc/exception/exception.hpp>
 
 namespace graphene { namespace db {
@@ -32,12 +35,180 @@ namespace graphene { namespace db {
    using fc::flat_set;
    class object_database;
 
+   /**
+    *  Map from object id to Value used by undo_state, kept in sorted vectors rather than hash nodes.
+    *
+    *  New ids go to a small sorted buffer which is merged into the main vector once it holds more than
+    *  about sqrt(size()) entries, so n inserts cost O(n sqrt n) element moves at worst and no allocation
+    *  per entry.  Erased entries of the main vector are only marked until the next merge.  Iterating
+    *  merges the buffer first, so begin()/end() walk a single vector in id order.
+    */
+   template<typename Value>
+   class undo_map
+   {
+      public:
+         struct value_type
+         {
+            value_type( object_id_type id, Value&& v ) : first( id ), second( std::move( v ) ) {}
+
+            object_id_type first;
+            Value          second;
+            bool           erased = false;
+         };
+         typedef typename std::vector<value_type>::iterator       iterator;
+         typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+         size_t size()const  { return _main.size() + _recent.size() - _erased; }
+         bool   empty()const { return size() == 0; }
+         size_t count( object_id_type id )const { return find( id ) != nullptr ? 1 : 0; }
+
+         Value* find( object_id_type id )
+         {
+            value_type* entry = find_entry( id );
+            return entry != nullptr && !entry->erased ? &entry->second : nullptr;
+         }
+         const Value* find( object_id_type id )const
+         {
+            return const_cast<undo_map*>( this )->find( id );
+         }
+
+         /** Inserts id unless it is present already, @return the value stored for id */
+         Value& emplace( object_id_type id, Value&& v )
+         {
+            value_type* entry = find_entry( id );
+            if( entry != nullptr )
+            {
+               if( entry->erased )
+               {
+                  entry->erased = false;
+                  entry->second = std::move( v );
+                  --_erased;
+               }
+               return entry->second;
+            }
+            auto itr = std::lower_bound( _recent.begin(), _recent.end(), id, id_less() );
+            itr = _recent.insert( itr, value_type( id, std::move( v ) ) );
+            if( _recent.size() <= _recent_limit )
+               return itr->second;
+            compact();
+            return *find( id );
+         }
+
+         Value& operator[]( object_id_type id )
+         {
+            Value* v = find( id );
+            return v != nullptr ? *v : emplace( id, Value() );
+         }
+
+         /**
+          *  Inserts entries sorted by id, none of which may be present yet, in one linear merge if
+          *  there are too many of them for the buffer
+          */
+         void insert_sorted( std::vector<value_type>&& entries )
+         {
+            if( _recent.size() + entries.size() <= _recent_limit )
+            {
+               for( auto& entry : entries )
+                  emplace( entry.first, std::move( entry.second ) );
+               return;
+            }
+            compact();
+            std::vector<value_type> merged;
+            merged.reserve( _main.size() + entries.size() );
+            std::merge( std::make_move_iterator( _main.begin() ), std::make_move_iterator( _main.end() ),
+                        std::make_move_iterator( entries.begin() ), std::make_move_iterator( entries.end() ),
+                        std::back_inserter( merged ), id_less() );
+            _main.swap( merged );
+            update_limit();
+         }
+
+         void erase( object_id_type id )
+         {
+            auto itr = std::lower_bound( _recent.begin(), _recent.end(), id, id_less() );
+            if( itr != _recent.end() && itr->first == id )
+            {
+               _recent.erase( itr );
+               return;
+            }
+            itr = std::lower_bound( _main.begin(), _main.end(), id, id_less() );
+            if( itr != _main.end() && itr->first == id && !itr->erased )
+            {
+               itr->erased = true;
+               itr->second = Value();
+               ++_erased;
+            }
+         }
+
+         iterator       begin()       { compact(); return _main.begin(); }
+         iterator       end()         { compact(); return _main.end();   }
+         const_iterator begin()const  { compact(); return _main.begin(); }
+         const_iterator end()const    { compact(); return _main.end();   }
+
+      private:
+         struct id_less
+         {
+            bool operator()( const value_type& a, object_id_type b )const    { return a.first < b; }
+            bool operator()( object_id_type a, const value_type& b )const    { return a < b.first; }
+            bool operator()( const value_type& a, const value_type& b )const { return a.first < b.first; }
+         };
+
+         /** @return the entry for id, which may be marked as erased, or nullptr */
+         value_type* find_entry( object_id_type id )const
+         {
+            auto itr = std::lower_bound( _main.begin(), _main.end(), id, id_less() );
+            if( itr != _main.end() && itr->first == id )
+               return &*itr;
+            itr = std::lower_bound( _recent.begin(), _recent.end(), id, id_less() );
+            if( itr != _recent.end() && itr->first == id )
+               return &*itr;
+            return nullptr;
+         }
+
+         /** Merges the buffer into the main vector and drops erased entries */
+         void compact()const
+         {
+            if( _recent.empty() && _erased == 0 )
+               return;
+            std::vector<value_type> merged;
+            merged.reserve( size() );
+            auto main_itr = _main.begin();
+            for( auto& entry : _recent )
+            {
+               for( ; main_itr != _main.end() && main_itr->first < entry.first; ++main_itr )
+                  if( !main_itr->erased )
+                     merged.push_back( std::move( *main_itr ) );
+               merged.push_back( std::move( entry ) );
+            }
+            for( ; main_itr != _main.end(); ++main_itr )
+               if( !main_itr->erased )
+                  merged.push_back( std::move( *main_itr ) );
+            _main.swap( merged );
+            _recent.clear();
+            _erased = 0;
+            update_limit();
+         }
+
+         void update_limit()const
+         {
+            size_t limit = 32;
+            while( limit * limit < _main.size() )
+               limit *= 2;
+            _recent_limit = limit;
+         }
+
+         // logically const: compact() only changes how the entries are stored
+         mutable std::vector<value_type> _main;
+         mutable std::vector<value_type> _recent;
+         mutable size_t                  _erased = 0;
+         mutable size_t                  _recent_limit = 32;
+   };
+
    struct undo_state
    {
-      unordered_map<object_id_type, unique_ptr<object> > old_values;
-      unordered_map<object_id_type, object_id_type>      old_index_next_ids;
-      std::unordered_set<object_id_type>                 new_ids;
-      unordered_map<object_id_type, unique_ptr<object> > removed;
+      undo_map<pooled_object_ptr> old_values;
+      undo_map<object_id_type>    old_index_next_ids;
+      undo_map<bool>              new_ids;
+      undo_map<pooled_object_ptr> removed;
    };
 
 
@@ -132,6 +303,15 @@ namespace graphene { namespace db {
 
          const undo_state& head()const;
 
+         /**
+          *  Looks up the value an object had before the oldest state on the stack was applied.
+          *  @return false if no state on the stack touched the object, otherwise true with value set to
+          *          the old value, or to nullptr if the object did not exist
+          */
+         bool find_original( object_id_type id, const object*& value )const;
+         /** Same for the next id of an index, if no state on the stack changed it next_id is left as is */
+         bool find_original_next_id( object_id_type& next_id )const;
+
       private:
          void undo();
          void merge();
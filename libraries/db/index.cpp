@@ -32,12 +32,22 @@ namespace graphene { namespace db {
    void base_primary_index::on_add( const object& obj )
    {
       _db.save_undo_add( obj );
+      mark_changed( obj.id );
       for( auto ob : _observers ) ob->on_add( obj );
    }
 
    void base_primary_index::on_remove( const object& obj )
-   { _db.save_undo_remove( obj ); for( auto ob : _observers ) ob->on_remove( obj ); }
+   { _db.save_undo_remove( obj ); mark_changed( obj.id ); for( auto ob : _observers ) ob->on_remove( obj ); }
 
    void base_primary_index::on_modify( const object& obj )
-   {for( auto ob : _observers ) ob->on_modify(  obj ); }
+   { mark_changed( obj.id ); for( auto ob : _observers ) ob->on_modify(  obj ); }
+
+   void base_primary_index::on_restore( const object& obj )
+   { mark_changed( obj.id ); }
+
+   bool base_primary_index::find_original( object_id_type id, const object*& value )const
+   { return _db._undo_db.find_original( id, value ); }
+
+   bool base_primary_index::find_original_next_id( object_id_type& next_id )const
+   { return _db._undo_db.find_original_next_id( next_id ); }
 } } // graphene::chain
@@ -22,13 +22,197 @@
  * THE SOFTWARE.
  */
 #include <graphene/db/object_database.hpp>
+#include <graphene/utilities/thread_pool.hpp>
 
 #include <fc/io/raw.hpp>
+#include <fc/io/fstream.hpp>
 #include <fc/container/flat.hpp>
 #include <fc/uint128.hpp>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <map>
+
 namespace graphene { namespace db {
 
+namespace detail {
+
+   /**
+    *  object_database/changes.log, a sequence of records each holding the vector<index_changes>
+    *  that takes the saved state from one consistent state to the next:
+    *
+    *     uint64_t size, fc::sha256 of the payload, payload
+    *
+    *  A record that was not written completely is dropped when the log is read.  Appends are made
+    *  one at a time, either on the thread that owns the database or on a single pool task.
+    */
+   class changes_log
+   {
+      public:
+         explicit changes_log( const fc::path& file ) : _file( file ) {}
+
+         uint64_t size()const { return fc::exists( _file ) ? fc::file_size( _file ) : 0; }
+
+         void append( const vector<index_changes>& changes )
+         {
+            write( _file, changes, true );
+            // keep the log bounded by the size of the state, not by its age
+            const uint64_t min_merge_size = 16*1024*1024;
+            const uint64_t log_size = size();
+            if( log_size > std::max( 2 * _merged_size, min_merge_size ) )
+               merge();
+         }
+
+         vector< vector<index_changes> > read()const
+         {
+            vector< vector<index_changes> > records;
+            if( !fc::exists( _file ) )
+               return records;
+            std::string data;
+            fc::read_file_contents( _file, data );
+            fc::datastream<const char*> ds( data.data(), data.size() );
+            size_t valid_size = 0;
+            while( ds.remaining() > 0 )
+            {
+               uint64_t   size = 0;
+               fc::sha256 checksum;
+               if( ds.remaining() < sizeof(size) + sizeof(checksum) )
+                  break;
+               fc::raw::unpack( ds, size );
+               fc::raw::unpack( ds, checksum );
+               if( ds.remaining() < size || fc::sha256::hash( ds.pos(), size ) != checksum )
+                  break;
+               fc::datastream<const char*> payload( ds.pos(), size );
+               records.emplace_back();
+               fc::raw::unpack( payload, records.back() );
+               ds.skip( size );
+               valid_size = data.size() - ds.remaining();
+            }
+            if( valid_size < data.size() )
+            {
+               wlog( "Dropping ${n} bytes at the end of ${f}, the last save was interrupted",
+                     ("n", data.size() - valid_size)("f", _file) );
+               fc::resize_file( _file, valid_size );
+            }
+            return records;
+         }
+
+         /**
+          *  Adds changes to a record, split into entries small enough to be unpacked again (fc limits
+          *  the size of a vector it unpacks).  open() joins the entries of an index back together.
+          */
+         static void add_changes( vector<index_changes>& record, index_changes&& changes )
+         {
+            const size_t max_entry_size = 100000;
+            if( changes.objects.size() <= max_entry_size && changes.removed.size() <= max_entry_size )
+            {
+               record.emplace_back( std::move( changes ) );
+               return;
+            }
+            for( size_t i = 0; i < changes.objects.size() || i < changes.removed.size(); i += max_entry_size )
+            {
+               record.emplace_back();
+               auto& entry = record.back();
+               entry.space_id = changes.space_id;
+               entry.type_id  = changes.type_id;
+               entry.next_id  = changes.next_id;
+               for( size_t j = i; j < changes.objects.size() && j < i + max_entry_size; ++j )
+                  entry.objects.emplace_back( std::move( changes.objects[j] ) );
+               for( size_t j = i; j < changes.removed.size() && j < i + max_entry_size; ++j )
+                  entry.removed.push_back( changes.removed[j] );
+            }
+         }
+
+      private:
+         /** Rewrites the log as a single record holding the latest version of each object */
+         void merge()
+         {
+            struct merged_index
+            {
+               object_id_type                                      next_id;
+               std::map< uint64_t, fc::optional< vector<char> > > objects; ///< empty if removed
+            };
+            std::map< std::pair<uint8_t,uint8_t>, merged_index > merged;
+            // the entries of a record never mention an object twice
+            for( const auto& record : read() )
+               for( const auto& changes : record )
+               {
+                  auto& m = merged[ std::make_pair( changes.space_id, changes.type_id ) ];
+                  m.next_id = changes.next_id;
+                  for( const auto& instance : changes.removed )
+                     m.objects[instance].reset();
+                  for( const auto& packed : changes.objects )
+                  {
+                     // every object starts with the id of graphene::db::object
+                     fc::datastream<const char*> ds( packed.data(), packed.size() );
+                     object_id_type id;
+                     fc::raw::unpack( ds, id );
+                     m.objects[id.instance()] = packed;
+                  }
+               }
+
+            vector<index_changes> record;
+            for( auto& m : merged )
+            {
+               index_changes changes;
+               changes.space_id = m.first.first;
+               changes.type_id  = m.first.second;
+               changes.next_id  = m.second.next_id;
+               for( auto& obj : m.second.objects )
+                  if( obj.second.valid() )
+                     changes.objects.emplace_back( std::move( *obj.second ) );
+                  else
+                     changes.removed.push_back( obj.first );
+               add_changes( record, std::move( changes ) );
+            }
+
+            const fc::path tmp = _file.generic_string() + ".tmp";
+            write( tmp, record, false );
+            fc::rename( tmp, _file );
+            _merged_size = size();
+         }
+
+         static void write( const fc::path& file, const vector<index_changes>& changes, bool append )
+         {
+            const auto payload = fc::raw::pack( changes );
+            const uint64_t size = payload.size();
+            std::vector<char> data( sizeof(size) + sizeof(fc::sha256) + payload.size() );
+            fc::datastream<char*> ds( data.data(), data.size() );
+            fc::raw::pack( ds, size );
+            fc::raw::pack( ds, fc::sha256::hash( payload.data(), payload.size() ) );
+            ds.write( payload.data(), payload.size() );
+
+            int fd = ::open( file.generic_string().c_str(), O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0644 );
+            FC_ASSERT( fd >= 0, "Unable to open ${f}: ${e}", ("f", file)("e", strerror(errno)) );
+            const off_t old_size = ::lseek( fd, 0, SEEK_END );
+            size_t written = 0;
+            while( written < data.size() )
+            {
+               const ssize_t n = ::write( fd, data.data() + written, data.size() - written );
+               if( n < 0 && errno == EINTR )
+                  continue;
+               if( n <= 0 )
+                  break;
+               written += n;
+            }
+            const bool ok = written == data.size() && ::fsync( fd ) == 0;
+            const int error = errno;
+            if( !ok && old_size >= 0 && ::ftruncate( fd, old_size ) != 0 )
+               wlog( "Unable to truncate ${f}", ("f", file) );
+            ::close( fd );
+            FC_ASSERT( ok, "Unable to write ${f}: ${e}", ("f", file)("e", strerror(error)) );
+         }
+
+         const fc::path _file;
+         uint64_t       _merged_size = 0;
+   };
+
+} // detail
+
+
 object_database::object_database()
 :_undo_db(*this)
 {
@@ -68,24 +252,138 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
    return *idx;
 }
 
+vector<const index*> object_database::get_indexes()const
+{
+   vector<const index*> result;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            result.push_back( idx.get() );
+   return result;
+}
+
 void object_database::flush()
 {
 //   ilog("Save object_database in ${d}", ("d", _data_dir));
+   if( _data_dir == fc::path() )
+      return; // never opened
+   const fc::path dir     = _data_dir / "object_database";
+   const fc::path new_dir = _data_dir / "object_database.new";
+   const fc::path old_dir = _data_dir / "object_database.old";
+
+   vector< std::pair<index*, fc::path> > files;
+   uint64_t saved_size = 0;
    for( uint32_t space = 0; space < _index.size(); ++space )
    {
-      fc::create_directories( _data_dir / "object_database" / fc::to_string(space) );
       const auto types = _index[space].size();
       for( uint32_t type = 0; type  <  types; ++type )
          if( _index[space][type] )
-            _index[space][type]->save( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
+         {
+            const fc::path file = fc::path( fc::to_string(space) ) / fc::to_string(type);
+            files.emplace_back( _index[space][type].get(), new_dir / file );
+            if( fc::exists( dir / file ) )
+               saved_size += fc::file_size( dir / file );
+         }
+   }
+
+   if( wait_for_changes() && _incremental_save && _changes_log && saved_size > 0
+       && _changes_log->size() <= saved_size / 2 )
+   {
+      try {
+         _changes_log->append( pack_changes( false ) );
+         return;
+      } catch( const fc::exception& e ) {
+         elog( "Unable to save the changes of the object database, saving every index: ${e}", ("e", e.to_detail_string()) );
+      }
+   }
+
+   fc::remove_all( new_dir );
+   for( uint32_t space = 0; space < _index.size(); ++space )
+      fc::create_directories( new_dir / fc::to_string(space) );
+
+   if( !_thread_pool )
+   {
+      for( const auto& f : files )
+         f.first->save( f.second );
+   }
+   else
+   {
+      vector< fc::future<void> > saved;
+      saved.reserve( files.size() );
+      for( const auto& f : files )
+         saved.push_back( _thread_pool->async( [&f](){ f.first->save( f.second ); }, "save index" ) );
+      graphene::utilities::thread_pool::wait_all( saved );
    }
+
+   // open() completes or discards a swap that was interrupted
+   if( fc::exists( dir ) )
+      fc::rename( dir, old_dir );
+   fc::rename( new_dir, dir );
+   fc::remove_all( old_dir );
+
+   _changes_log = std::make_shared<detail::changes_log>( dir / "changes.log" );
+   _changes_failed = false;
+}
+
+void object_database::save_checkpoint()
+{ try {
+   FC_ASSERT( _incremental_save && _changes_log, "Incremental saves are not enabled" );
+   if( !wait_for_changes() )
+      return; // the log is missing changes, wait for the next full flush()
+
+   auto changes = std::make_shared< vector<index_changes> >( pack_changes( true ) );
+   auto log = _changes_log;
+   if( _thread_pool )
+      _changes_write = _thread_pool->async( [log,changes](){ log->append( *changes ); }, "save checkpoint" );
+   else
+   {
+      try {
+         log->append( *changes );
+      } catch( const fc::exception& e ) {
+         elog( "Unable to save a checkpoint of the object database: ${e}", ("e", e.to_detail_string()) );
+         _changes_failed = true;
+      }
+   }
+} FC_CAPTURE_AND_RETHROW() }
+
+vector<index_changes> object_database::pack_changes( bool undo_base )
+{
+   vector<index_changes> result;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+         {
+            auto changes = idx->pack_changes( undo_base );
+            if( !changes.objects.empty() || !changes.removed.empty() )
+               detail::changes_log::add_changes( result, std::move( changes ) );
+         }
+   return result;
+}
+
+bool object_database::wait_for_changes()
+{
+   if( _changes_write.valid() )
+   {
+      try {
+         _changes_write.wait();
+      } catch( const fc::exception& e ) {
+         elog( "Unable to save a checkpoint of the object database: ${e}", ("e", e.to_detail_string()) );
+         _changes_failed = true;
+      }
+      _changes_write = fc::future<void>();
+   }
+   return !_changes_failed;
 }
 
 void object_database::wipe(const fc::path& data_dir)
 {
    close();
    ilog("Wiping object database...");
+   wait_for_changes();
+   _changes_log.reset();
    fc::remove_all(data_dir / "object_database");
+   fc::remove_all(data_dir / "object_database.new");
+   fc::remove_all(data_dir / "object_database.old");
    ilog("Done wiping object databse.");
 }
 
@@ -93,10 +391,86 @@ void object_database::open(const fc::path& data_dir)
 { try {
    ilog("Opening object database from ${d} ...", ("d", data_dir));
    _data_dir = data_dir;
+   const fc::path dir     = _data_dir / "object_database";
+   const fc::path new_dir = _data_dir / "object_database.new";
+   const fc::path old_dir = _data_dir / "object_database.old";
+
+   // finish or roll back a flush() that was interrupted
+   if( fc::exists( new_dir ) )
+   {
+      if( fc::exists( dir ) )
+         fc::remove_all( new_dir );
+      else
+         fc::rename( new_dir, dir );
+   }
+   fc::remove_all( old_dir );
+
+   vector< std::pair<index*, fc::path> > files;
    for( uint32_t space = 0; space < _index.size(); ++space )
       for( uint32_t type = 0; type  < _index[space].size(); ++type )
          if( _index[space][type] )
-            _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
+            files.emplace_back( _index[space][type].get(), dir / fc::to_string(space)/fc::to_string(type) );
+
+   if( !_thread_pool )
+   {
+      for( const auto& f : files )
+         f.first->open( f.second );
+   }
+   else
+   {
+      // unpack every file up front, insert each index as soon as its file has been read
+      vector< fc::future<void> > read;
+      read.reserve( files.size() );
+      for( const auto& f : files )
+         read.push_back( _thread_pool->async( [&f](){ f.first->read_objects( f.second ); }, "read index" ) );
+      try {
+         for( size_t i = 0; i < files.size(); ++i )
+         {
+            read[i].wait();
+            files[i].first->insert_read_objects();
+         }
+      } catch( ... ) {
+         // the remaining tasks still reference files
+         graphene::utilities::thread_pool::wait_all( read );
+         throw;
+      }
+   }
+
+   // a new data directory has no saved indexes yet, but checkpoints are logged from the start
+   fc::create_directories( dir );
+   _changes_log = std::make_shared<detail::changes_log>( dir / "changes.log" );
+   _changes_failed = false;
+   auto records = _changes_log->read();
+   for( auto& record : records )
+   {
+      std::map< std::pair<uint8_t,uint8_t>, index_changes > joined;
+      for( auto& entry : record )
+      {
+         auto& changes = joined[ std::make_pair( entry.space_id, entry.type_id ) ];
+         changes.space_id = entry.space_id;
+         changes.type_id  = entry.type_id;
+         changes.next_id  = entry.next_id;
+         std::move( entry.objects.begin(), entry.objects.end(), std::back_inserter( changes.objects ) );
+         changes.removed.insert( changes.removed.end(), entry.removed.begin(), entry.removed.end() );
+      }
+      for( const auto& item : joined )
+      {
+         const auto& changes = item.second;
+         if( changes.space_id >= _index.size() || changes.type_id >= _index[changes.space_id].size()
+             || !_index[changes.space_id][changes.type_id] )
+         {
+            wlog( "Skipping saved changes of ${s}.${t}, no such index is registered",
+                  ("s", changes.space_id)("t", changes.type_id) );
+            continue;
+         }
+         _index[changes.space_id][changes.type_id]->apply_changes( changes );
+      }
+   }
+   if( !records.empty() )
+      ilog( "Applied ${n} saved changes", ("n", records.size()) );
+
+   for( const auto& f : files )
+      f.first->enable_change_tracking( _incremental_save );
    ilog( "Done opening object database." );
 
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
@@ -52,10 +52,8 @@ void undo_database::on_create( const object& obj )
       _stack.emplace_back();
    auto& state = _stack.back();
    auto index_id = object_id_type( obj.id.space(), obj.id.type(), 0 );
-   auto itr = state.old_index_next_ids.find( index_id );
-   if( itr == state.old_index_next_ids.end() )
-      state.old_index_next_ids[index_id] = obj.id;
-   state.new_ids.insert(obj.id);
+   state.old_index_next_ids.emplace( index_id, object_id_type( obj.id ) );
+   state.new_ids.emplace( obj.id, true );
 }
 void undo_database::on_modify( const object& obj )
 {
@@ -64,11 +62,10 @@ void undo_database::on_modify( const object& obj )
    if( _stack.empty() )
       _stack.emplace_back();
    auto& state = _stack.back();
-   if( state.new_ids.find(obj.id) != state.new_ids.end() )
+   if( state.new_ids.count(obj.id) )
       return;
-   auto itr =  state.old_values.find(obj.id);
-   if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   if( state.old_values.count(obj.id) ) return;
+   state.old_values.emplace( obj.id, obj.clone_pooled() );
 }
 void undo_database::on_remove( const object& obj )
 {
@@ -82,14 +79,14 @@ void undo_database::on_remove( const object& obj )
       state.new_ids.erase(obj.id);
       return;
    }
-   if( state.old_values.count(obj.id) )
+   if( auto old_value = state.old_values.find(obj.id) )
    {
-      state.removed[obj.id] = std::move(state.old_values[obj.id]);
+      state.removed.emplace( obj.id, std::move(*old_value) );
       state.old_values.erase(obj.id);
       return;
    }
    if( state.removed.count(obj.id) ) return;
-   state.removed[obj.id] = obj.clone();
+   state.removed.emplace( obj.id, obj.clone_pooled() );
 }
 
 void undo_database::undo()
@@ -104,9 +101,9 @@ void undo_database::undo()
       _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
    }
 
-   for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
+   for( const auto& item : state.new_ids )
    {
-      _db.remove( _db.get_object(*ritr) );
+      _db.remove( _db.get_object( item.first ) );
    }
 
    for( auto& item : state.old_index_next_ids )
@@ -173,68 +170,68 @@ void undo_database::merge()
 
    // We can only be outside type A/AB (the nop path) if B is not nop, so it suffices to iterate through B's three containers.
 
+   // Entries of type B are collected in id order and merged into prev_state in one pass each, so
+   // merging a large state costs time linear in the size of both.
+
    // *+upd
+   std::vector< undo_map<pooled_object_ptr>::value_type > moved_values;
    for( auto& obj : state.old_values )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.count(obj.first) )
       {
          // new+upd -> new, type A
          continue;
       }
-      if( prev_state.old_values.find(obj.second->id) != prev_state.old_values.end() )
+      if( prev_state.old_values.count(obj.first) )
       {
          // upd(was=X) + upd(was=Y) -> upd(was=X), type A
          continue;
       }
       // del+upd -> N/A
-      assert( prev_state.removed.find(obj.second->id) == prev_state.removed.end() );
+      assert( !prev_state.removed.count(obj.first) );
       // nop+upd(was=Y) -> upd(was=Y), type B
-      prev_state.old_values[obj.second->id] = std::move(obj.second);
+      moved_values.emplace_back( obj.first, std::move(obj.second) );
    }
+   prev_state.old_values.insert_sorted( std::move(moved_values) );
 
    // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
-   for( auto id : state.new_ids )
-      prev_state.new_ids.insert(id);
+   std::vector< undo_map<bool>::value_type > new_ids;
+   new_ids.reserve( state.new_ids.size() );
+   for( auto& item : state.new_ids )
+      new_ids.emplace_back( item.first, true );
+   prev_state.new_ids.insert_sorted( std::move(new_ids) );
 
    // old_index_next_ids can only be updated, iterate over *+upd cases
    for( auto& item : state.old_index_next_ids )
    {
-      if( prev_state.old_index_next_ids.find( item.first ) == prev_state.old_index_next_ids.end() )
-      {
-         // nop+upd(was=Y) -> upd(was=Y), type B
-         prev_state.old_index_next_ids[item.first] = item.second;
-         continue;
-      }
-      else
-      {
-         // upd(was=X)+upd(was=Y) -> upd(was=X), type A
-         // type A implementation is a no-op, as discussed above, so there is no code here
-         continue;
-      }
+      // nop+upd(was=Y) -> upd(was=Y), type B
+      // upd(was=X)+upd(was=Y) -> upd(was=X), type A, emplace() keeps X
+      prev_state.old_index_next_ids.emplace( item.first, std::move(item.second) );
    }
 
    // *+del
+   std::vector< undo_map<pooled_object_ptr>::value_type > removed;
    for( auto& obj : state.removed )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.count(obj.first) )
       {
          // new + del -> nop (type C)
-         prev_state.new_ids.erase(obj.second->id);
+         prev_state.new_ids.erase(obj.first);
          continue;
       }
-      auto it = prev_state.old_values.find(obj.second->id);
-      if( it != prev_state.old_values.end() )
+      if( auto old_value = prev_state.old_values.find(obj.first) )
       {
          // upd(was=X) + del(was=Y) -> del(was=X)
-         prev_state.removed[obj.second->id] = std::move(it->second);
-         prev_state.old_values.erase(obj.second->id);
+         removed.emplace_back( obj.first, std::move(*old_value) );
+         prev_state.old_values.erase(obj.first);
          continue;
       }
       // del + del -> N/A
-      assert( prev_state.removed.find( obj.second->id ) == prev_state.removed.end() );
+      assert( !prev_state.removed.count(obj.first) );
       // nop + del(was=Y) -> del(was=Y)
-      prev_state.removed[obj.second->id] = std::move(obj.second);
+      removed.emplace_back( obj.first, std::move(obj.second) );
    }
+   prev_state.removed.insert_sorted( std::move(removed) );
    _stack.pop_back();
    --_active_sessions;
 }
@@ -258,9 +255,9 @@ void undo_database::pop_commit()
          _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
       }
 
-      for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
+      for( const auto& item : state.new_ids )
       {
-         _db.remove( _db.get_object(*ritr) );
+         _db.remove( _db.get_object( item.first ) );
       }
 
       for( auto& item : state.old_index_next_ids )
@@ -287,4 +284,42 @@ const undo_state& undo_database::head()const
    return _stack.back();
 }
 
+bool undo_database::find_original( object_id_type id, const object*& value )const
+{
+   // the oldest state that touched the object knows its value from before the stack
+   for( const auto& state : _stack )
+   {
+      if( state.new_ids.count( id ) )
+      {
+         value = nullptr;
+         return true;
+      }
+      if( auto old_value = state.old_values.find( id ) )
+      {
+         value = old_value->get();
+         return true;
+      }
+      if( auto removed = state.removed.find( id ) )
+      {
+         value = removed->get();
+         return true;
+      }
+   }
+   return false;
+}
+
+bool undo_database::find_original_next_id( object_id_type& next_id )const
+{
+   const object_id_type index_id( next_id.space(), next_id.type(), 0 );
+   for( const auto& state : _stack )
+   {
+      if( auto old_next_id = state.old_index_next_ids.find( index_id ) )
+      {
+         next_id = *old_next_id;
+         return true;
+      }
+   }
+   return false;
+}
+
 } } // graphene::db
@@ -53,7 +53,8 @@ namespace graphene { namespace account_history {
 enum account_history_object_type
 {
    key_account_object_type = 0,
-   bucket_object_type = 1 ///< used in market_history_plugin
+   bucket_object_type = 1, ///< used in market_history_plugin
+   market_ticker_object_type = 2 ///< used in market_history_plugin
 };
 
 
@@ -66,7 +66,8 @@ bookie_api_impl::bookie_api_impl(graphene::app::application& _app) : app(_app)
 binned_order_book bookie_api_impl::get_binned_order_book(graphene::chain::betting_market_id_type betting_market_id, int32_t precision)
 {
     std::shared_ptr<graphene::chain::database> db = app.chain_database();
-    const auto& bet_odds_idx = db->get_index_type<graphene::chain::bet_object_index>().indices().get<graphene::chain::by_odds>();
+    const auto& bet_idx = dynamic_cast<const graphene::db::primary_index<graphene::chain::bet_object_index>&>(db->get_index_type<graphene::chain::bet_object_index>());
+    const auto& price_levels = bet_idx.get_secondary_index<graphene::chain::bet_price_level_index>();
     const chain_parameters& current_params = db->get_global_properties().parameters;
 
     graphene::chain::bet_multiplier_type bin_size = GRAPHENE_BETTING_ODDS_PRECISION;
@@ -104,15 +105,15 @@ binned_order_book bookie_api_impl::get_binned_order_book(graphene::chain::bettin
         }
     };
 
-    // iterate through both sides of the order book (backs at increasing odds then lays at decreasing odds)
-    for (auto bet_odds_iter = bet_odds_idx.lower_bound(std::make_tuple(betting_market_id));
-         bet_odds_iter != bet_odds_idx.end() && betting_market_id == bet_odds_iter->betting_market_id;
-         ++bet_odds_iter)
+    // iterate through both sides of the order book level by level (backs at increasing odds then lays at decreasing odds)
+    auto levels = price_levels.get_levels(betting_market_id);
+    for (auto level_iter = levels.first; level_iter != levels.second; ++level_iter)
     {
+        const graphene::chain::bet_price_level_index::level_key& level = level_iter->first;
         if (current_bin && 
-            (bet_odds_iter->back_or_lay != current_bin->back_or_lay /* we have switched from back to lay bets */ ||
-             (bet_odds_iter->back_or_lay == bet_type::back ? bet_odds_iter->backer_multiplier > current_bin->backer_multiplier :
-                                                             bet_odds_iter->backer_multiplier < current_bin->backer_multiplier)))
+            (level.back_or_lay != current_bin->back_or_lay /* we have switched from back to lay bets */ ||
+             (level.back_or_lay == bet_type::back ? level.backer_multiplier > current_bin->backer_multiplier :
+                                                    level.backer_multiplier < current_bin->backer_multiplier)))
             flush_current_bin();
 
         if (!current_bin)
@@ -122,15 +123,15 @@ binned_order_book bookie_api_impl::get_binned_order_book(graphene::chain::bettin
 
             // for back bets, we want to group all bets with odds from 3.0001 to 4 into the "4" bin
             // for lay bets, we want to group all bets with odds from 3 to 3.9999 into the "3" bin
-            if (bet_odds_iter->back_or_lay == bet_type::back)
+            if (level.back_or_lay == bet_type::back)
             {
-               current_bin->backer_multiplier = (bet_odds_iter->backer_multiplier + bin_size - 1) / bin_size * bin_size;
+               current_bin->backer_multiplier = (level.backer_multiplier + bin_size - 1) / bin_size * bin_size;
                current_bin->backer_multiplier = std::min<graphene::chain::bet_multiplier_type>(current_bin->backer_multiplier, current_params.max_bet_multiplier());
                current_bin->back_or_lay = bet_type::back;
             }
             else
             {
-               current_bin->backer_multiplier = bet_odds_iter->backer_multiplier / bin_size * bin_size;
+               current_bin->backer_multiplier = level.backer_multiplier / bin_size * bin_size;
                current_bin->backer_multiplier = std::max<graphene::chain::bet_multiplier_type>(current_bin->backer_multiplier, current_params.min_bet_multiplier());
                current_bin->back_or_lay = bet_type::lay;
             }
@@ -138,7 +139,7 @@ binned_order_book bookie_api_impl::get_binned_order_book(graphene::chain::bettin
             current_bin->amount_to_bet.amount = 0;
         }
 
-        current_bin->amount_to_bet.amount += bet_odds_iter->amount_to_bet.amount;
+        current_bin->amount_to_bet.amount += level_iter->second.amount_to_bet;
     }
     if (current_bin)
         flush_current_bin();
@@ -28,6 +28,8 @@
 
 #include <fc/thread/future.hpp>
 
+#include <boost/multi_index/composite_key.hpp>
+
 namespace graphene { namespace market_history {
 using namespace chain;
 
@@ -106,6 +108,67 @@ struct order_history_object : public abstract_object<order_history_object>
   fill_order_operation op;
 };
 
+/**
+ *  The trades of one market during ticker_slot_seconds, see market_ticker_object.  Amounts and prices are in
+ *  the order of the ticker, base is the asset with the lower id.
+ */
+struct ticker_slot
+{
+   fc::time_point_sec  open;
+   share_type          high_base;
+   share_type          high_quote;
+   share_type          low_base;
+   share_type          low_quote;
+   share_type          close_base;
+   share_type          close_quote;
+   share_type          base_volume;
+   share_type          quote_volume;
+};
+
+/**
+ *  Rolling 24 hour statistics of one market.  The plugin adds every fill_order_operation to the slot it falls
+ *  into and drops slots once they have left the window, so reading a ticker never has to walk the trade history.
+ *  The window is kept with the granularity of one slot.
+ */
+struct market_ticker_object : public abstract_object<market_ticker_object>
+{
+   static const uint8_t space_id = ACCOUNT_HISTORY_SPACE_ID;
+   static const uint8_t type_id  = 2; // market_history_plugin type, referenced from account_history_plugin.hpp
+
+   static const uint32_t window_seconds = 86400;
+   static const uint32_t slot_seconds   = 900;
+
+   price latest()const { return asset( latest_base, base ) / asset( latest_quote, quote ); }
+   price open()const { return asset( open_base, base ) / asset( open_quote, quote ); }
+   price high()const { return asset( high_base, base ) / asset( high_quote, quote ); }
+   price low()const { return asset( low_base, base ) / asset( low_quote, quote ); }
+
+   /** adds a trade of base_amount for quote_amount made at time */
+   void add_trade( fc::time_point_sec time, share_type base_amount, share_type quote_amount );
+   /** drops every slot that has left the window at time now */
+   void expire( fc::time_point_sec now );
+
+   asset_id_type       base;
+   asset_id_type       quote;
+   /// last trade ever made in this market
+   share_type          latest_base;
+   share_type          latest_quote;
+   /// last trade made before the window, zero if there was none
+   share_type          open_base;
+   share_type          open_quote;
+   /// high, low and volumes within the window
+   share_type          high_base;
+   share_type          high_quote;
+   share_type          low_base;
+   share_type          low_quote;
+   share_type          base_volume;
+   share_type          quote_volume;
+   /// oldest first
+   vector<ticker_slot> slots;
+   /// when the oldest slot leaves the window
+   fc::time_point_sec  expiration = fc::time_point_sec::maximum();
+};
+
 struct by_key;
 typedef multi_index_container<
    bucket_object,
@@ -123,9 +186,31 @@ typedef multi_index_container<
    >
 > order_history_multi_index_type;
 
+struct by_market;
+struct by_expiration;
+typedef multi_index_container<
+   market_ticker_object,
+   indexed_by<
+      hashed_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
+      ordered_unique< tag<by_market>,
+         composite_key< market_ticker_object,
+            member< market_ticker_object, asset_id_type, &market_ticker_object::base >,
+            member< market_ticker_object, asset_id_type, &market_ticker_object::quote >
+         >
+      >,
+      ordered_unique< tag<by_expiration>,
+         composite_key< market_ticker_object,
+            member< market_ticker_object, fc::time_point_sec, &market_ticker_object::expiration >,
+            member< object, object_id_type, &object::id >
+         >
+      >
+   >
+> market_ticker_multi_index_type;
+
 
 typedef generic_index<bucket_object, bucket_object_multi_index_type> bucket_index;
 typedef generic_index<order_history_object, order_history_multi_index_type> history_index;
+typedef generic_index<market_ticker_object, market_ticker_multi_index_type> market_ticker_index;
 
 
 namespace detail
@@ -136,7 +221,8 @@ namespace detail
 /**
  *  The market history plugin can be configured to track any number of intervals via its configuration.  Once per block it
  *  will scan the virtual operations and look for fill_order_operations and then adjust the appropriate bucket objects for
- *  each fill order.
+ *  each fill order.  It also keeps a market_ticker_object with the statistics of the last 24 hours of every market,
+ *  regardless of the tracked buckets.
  */
 class market_history_plugin : public graphene::app::plugin
 {
@@ -172,4 +258,18 @@ FC_REFLECT_DERIVED( graphene::market_history::bucket_object, (graphene::db::obje
                     (open_base)(open_quote)
                     (close_base)(close_quote)
                     (base_volume)(quote_volume) )
+FC_REFLECT( graphene::market_history::ticker_slot,
+            (open)
+            (high_base)(high_quote)
+            (low_base)(low_quote)
+            (close_base)(close_quote)
+            (base_volume)(quote_volume) )
+FC_REFLECT_DERIVED( graphene::market_history::market_ticker_object, (graphene::db::object),
+                    (base)(quote)
+                    (latest_base)(latest_quote)
+                    (open_base)(open_quote)
+                    (high_base)(high_quote)
+                    (low_base)(low_quote)
+                    (base_volume)(quote_volume)
+                    (slots)(expiration) )
 
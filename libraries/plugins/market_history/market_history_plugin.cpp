@@ -53,6 +53,10 @@ class market_history_plugin_impl
        */
       void update_market_histories( const signed_block& b );
 
+      /** adds a fill to the ticker of its market, only one of the two fills of a match is counted */
+      void update_market_ticker( const fill_order_operation& o, fc::time_point_sec now );
+      void expire_market_tickers( fc::time_point_sec now );
+
       graphene::chain::database& database()
       {
          return _self.database();
@@ -216,20 +220,134 @@ market_history_plugin_impl::~market_history_plugin_impl()
 
 void market_history_plugin_impl::update_market_histories( const signed_block& b )
 {
-   if( _maximum_history_per_bucket_size == 0 ) return;
-   if( _tracked_buckets.size() == 0 ) return;
+   expire_market_tickers( b.timestamp );
+
+   const bool track_buckets = _maximum_history_per_bucket_size != 0 && _tracked_buckets.size() != 0;
 
    graphene::chain::database& db = database();
    const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
    for( const optional< operation_history_object >& o_op : hist )
    {
-      if( o_op.valid() )
+      if( !o_op.valid() )
+         continue;
+      if( o_op->op.which() == operation::tag<fill_order_operation>::value )
+         update_market_ticker( o_op->op.get<fill_order_operation>(), b.timestamp );
+      if( track_buckets )
          o_op->op.visit( operation_process_fill_order( _self, b.timestamp ) );
    }
 }
 
+void market_history_plugin_impl::update_market_ticker( const fill_order_operation& o, fc::time_point_sec now )
+{
+   // same filter as the buckets, the fill paying the asset with the lower id is the base side of the trade
+   if( o.pays.asset_id > o.receives.asset_id )
+      return;
+
+   graphene::chain::database& db = database();
+   const auto& by_market_idx = db.get_index_type<market_ticker_index>().indices().get<by_market>();
+   auto itr = by_market_idx.find( boost::make_tuple( o.pays.asset_id, o.receives.asset_id ) );
+   if( itr == by_market_idx.end() )
+      db.create<market_ticker_object>( [&]( market_ticker_object& t ) {
+         t.base = o.pays.asset_id;
+         t.quote = o.receives.asset_id;
+         t.add_trade( now, o.pays.amount, o.receives.amount );
+      });
+   else
+      db.modify( *itr, [&]( market_ticker_object& t ) {
+         t.add_trade( now, o.pays.amount, o.receives.amount );
+      });
+}
+
+void market_history_plugin_impl::expire_market_tickers( fc::time_point_sec now )
+{
+   graphene::chain::database& db = database();
+   const auto& by_expiration_idx = db.get_index_type<market_ticker_index>().indices().get<by_expiration>();
+   while( !by_expiration_idx.empty() && by_expiration_idx.begin()->expiration <= now )
+      db.modify( *by_expiration_idx.begin(), [&]( market_ticker_object& t ) {
+         t.expire( now );
+      });
+}
+
 } // end namespace detail
 
+void market_ticker_object::add_trade( fc::time_point_sec time, share_type base_amount, share_type quote_amount )
+{
+   const price trade_price = asset( base_amount, base ) / asset( quote_amount, quote );
+   const fc::time_point_sec slot_open( ( time.sec_since_epoch() / slot_seconds ) * slot_seconds );
+
+   if( slots.empty() || slots.back().open != slot_open )
+   {
+      ticker_slot slot;
+      slot.open = slot_open;
+      slot.high_base = slot.low_base = base_amount;
+      slot.high_quote = slot.low_quote = quote_amount;
+      slots.push_back( slot );
+   }
+   ticker_slot& slot = slots.back();
+   if( asset( slot.high_base, base ) / asset( slot.high_quote, quote ) < trade_price )
+   {
+      slot.high_base = base_amount;
+      slot.high_quote = quote_amount;
+   }
+   if( asset( slot.low_base, base ) / asset( slot.low_quote, quote ) > trade_price )
+   {
+      slot.low_base = base_amount;
+      slot.low_quote = quote_amount;
+   }
+   slot.close_base = base_amount;
+   slot.close_quote = quote_amount;
+   slot.base_volume += base_amount;
+   slot.quote_volume += quote_amount;
+
+   if( base_volume == 0 || high() < trade_price )
+   {
+      high_base = base_amount;
+      high_quote = quote_amount;
+   }
+   if( base_volume == 0 || low() > trade_price )
+   {
+      low_base = base_amount;
+      low_quote = quote_amount;
+   }
+   base_volume += base_amount;
+   quote_volume += quote_amount;
+   latest_base = base_amount;
+   latest_quote = quote_amount;
+   expiration = slots.front().open + ( slot_seconds + window_seconds );
+}
+
+void market_ticker_object::expire( fc::time_point_sec now )
+{
+   auto first_kept = slots.begin();
+   while( first_kept != slots.end() && first_kept->open + ( slot_seconds + window_seconds ) <= now )
+   {
+      open_base = first_kept->close_base;
+      open_quote = first_kept->close_quote;
+      base_volume -= first_kept->base_volume;
+      quote_volume -= first_kept->quote_volume;
+      ++first_kept;
+   }
+   slots.erase( slots.begin(), first_kept );
+
+   high_base = high_quote = low_base = low_quote = 0;
+   for( const ticker_slot& slot : slots )
+   {
+      if( high_quote == 0 || high() < asset( slot.high_base, base ) / asset( slot.high_quote, quote ) )
+      {
+         high_base = slot.high_base;
+         high_quote = slot.high_quote;
+      }
+      if( low_quote == 0 || low() > asset( slot.low_base, base ) / asset( slot.low_quote, quote ) )
+      {
+         low_base = slot.low_base;
+         low_quote = slot.low_quote;
+      }
+   }
+
+   expiration = slots.empty() ? fc::time_point_sec::maximum()
+                              : slots.front().open + ( slot_seconds + window_seconds );
+}
+
 
 
 
@@ -268,6 +386,7 @@ void market_history_plugin::plugin_initialize(const boost::program_options::vari
    database().applied_block.connect( [&]( const signed_block& b){ my->update_market_histories(b); } );
    database().add_index< primary_index< bucket_index  > >();
    database().add_index< primary_index< history_index  > >();
+   database().add_index< primary_index< market_ticker_index > >();
 
    if( options.count( "bucket-size" ) )
    {
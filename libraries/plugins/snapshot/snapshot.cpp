@@ -36,6 +36,7 @@ namespace bpo = boost::program_options;
 static const char* OPT_BLOCK_NUM  = "snapshot-at-block";
 static const char* OPT_BLOCK_TIME = "snapshot-at-time";
 static const char* OPT_DEST       = "snapshot-to";
+static const char* OPT_FORMAT     = "snapshot-format";
 
 void snapshot_plugin::plugin_set_program_options(
    boost::program_options::options_description& command_line_options,
@@ -44,7 +45,8 @@ void snapshot_plugin::plugin_set_program_options(
    command_line_options.add_options()
          (OPT_BLOCK_NUM, bpo::value<uint32_t>(), "Block number after which to do a snapshot")
          (OPT_BLOCK_TIME, bpo::value<string>(), "Block time (ISO format) after which to do a snapshot")
-         (OPT_DEST, bpo::value<string>(), "Pathname of JSON file where to store the snapshot")
+         (OPT_DEST, bpo::value<string>(), "Pathname of the file where to store the snapshot")
+         (OPT_FORMAT, bpo::value<string>()->default_value("json"), "Snapshot format, \"json\" (one object per line) or \"binary\" (can be loaded with --bootstrap-from-snapshot)")
          ;
    config_file_options.add(command_line_options);
 }
@@ -62,6 +64,9 @@ void snapshot_plugin::plugin_initialize(const boost::program_options::variables_
    {
       FC_ASSERT( options.count(OPT_DEST), "Must specify snapshot-to in addition to snapshot-at-block or snapshot-at-time!" );
       dest = options[OPT_DEST].as<std::string>();
+      const std::string format = options[OPT_FORMAT].as<std::string>();
+      FC_ASSERT( format == "json" || format == "binary", "snapshot-format must be json or binary" );
+      binary = ( format == "binary" );
       if( options.count(OPT_BLOCK_NUM) )
          snapshot_block = options[OPT_BLOCK_NUM].as<uint32_t>();
       if( options.count(OPT_BLOCK_TIME) )
@@ -112,12 +117,32 @@ static void create_snapshot( const graphene::chain::database& db, const fc::path
    ilog("snapshot plugin: created snapshot");
 }
 
+static void create_binary_snapshot( const graphene::chain::database& db, const fc::path& dest )
+{
+   ilog("snapshot plugin: creating binary snapshot");
+   try
+   {
+      db.save_snapshot( dest );
+   }
+   catch ( fc::exception& e )
+   {
+      wlog( "Failed to create snapshot: ${ex}", ("ex",e) );
+      return;
+   }
+   ilog("snapshot plugin: created binary snapshot");
+}
+
 void snapshot_plugin::check_snapshot( const graphene::chain::signed_block& b )
 { try {
     uint32_t current_block = b.block_num();
     if( (last_block < snapshot_block && snapshot_block <= current_block)
            || (last_time < snapshot_time && snapshot_time <= b.timestamp) )
-       create_snapshot( database(), dest );
+    {
+       if( binary )
+          create_binary_snapshot( database(), dest );
+       else
+          create_snapshot( database(), dest );
+    }
     last_block = current_block;
     last_time = b.timestamp;
 } FC_LOG_AND_RETHROW() }
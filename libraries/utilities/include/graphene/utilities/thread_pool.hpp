@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/thread/thread.hpp>
+#include <fc/thread/future.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace utilities {
+
+/**
+ * @brief a fixed set of fc::threads that CPU bound work can be fanned out to
+ *
+ * Tasks are handed to the threads round-robin.  Waiting on the futures returned
+ * by async() only blocks the calling fc task, so the caller's fc::thread keeps
+ * servicing its other tasks in the meantime.  for_each_range() instead blocks
+ * the calling thread itself and must not be called from one of the pool's threads.
+ */
+class thread_pool
+{
+   public:
+      /**
+       * @param num_threads number of worker threads to start, 0 starts one per hardware thread
+       * @param name prefix used to name the worker threads
+       */
+      explicit thread_pool( uint32_t num_threads = 0, const std::string& name = "worker" );
+      ~thread_pool();
+
+      uint32_t size()const { return _threads.size(); }
+
+      /** @return the worker threads round-robin, for callers that keep related tasks on one thread */
+      fc::thread& next_thread() { return *_threads[ _next_thread++ % _threads.size() ]; }
+
+      /** Runs f on the next worker thread */
+      template<typename Functor>
+      auto async( Functor&& f, const char* desc = "thread_pool task" ) -> fc::future<decltype(f())>
+      {
+         return next_thread().async( std::forward<Functor>(f), desc );
+      }
+
+      /**
+       * Partitions [0, count) into at most size() contiguous ranges, calls f( begin, end )
+       * for each of them on a different worker and waits for all of them to finish.
+       *
+       * The wait blocks the calling thread without yielding, so no other task of the
+       * caller's fc::thread can run while f reads state the caller is in the middle of
+       * changing, e.g. a block that is being applied.
+       *
+       * The first exception thrown by f is rethrown on the calling thread, but only
+       * once every range has completed.
+       */
+      template<typename Functor>
+      void for_each_range( size_t count, const Functor& f )
+      {
+         if( count == 0 )
+            return;
+         const size_t ranges = std::min<size_t>( count, _threads.size() );
+         completion_latch latch( ranges );
+         for( size_t i = 0; i < ranges; ++i )
+         {
+            const size_t begin = count * i / ranges;
+            const size_t end   = count * (i + 1) / ranges;
+            _threads[i]->async( [&f,&latch,begin,end]()
+            {
+               std::exception_ptr error;
+               try
+               {
+                  f( begin, end );
+               }
+               catch( ... )
+               {
+                  error = std::current_exception();
+               }
+               latch.count_down( error );
+            }, "thread_pool range" );
+         }
+         latch.wait();
+      }
+
+      /** Waits for every future in done, then rethrows the first failure if there was one */
+      template<typename T>
+      static void wait_all( std::vector< fc::future<T> >& done )
+      {
+         std::exception_ptr first_error;
+         for( auto& d : done )
+         {
+            try
+            {
+               d.wait();
+            }
+            catch( ... )
+            {
+               if( !first_error )
+                  first_error = std::current_exception();
+            }
+         }
+         if( first_error )
+            std::rethrow_exception( first_error );
+      }
+
+   private:
+      /** Counts finished tasks with a std::condition_variable, so waiting does not yield to other fc tasks */
+      class completion_latch
+      {
+         public:
+            explicit completion_latch( size_t count ) : _remaining( count ) {}
+
+            void count_down( std::exception_ptr error )
+            {
+               std::lock_guard<std::mutex> lock( _mutex );
+               if( error && !_first_error )
+                  _first_error = error;
+               if( --_remaining == 0 )
+                  _done.notify_all();
+            }
+
+            /** Waits for every task, then rethrows the first failure if there was one */
+            void wait()
+            {
+               std::unique_lock<std::mutex> lock( _mutex );
+               _done.wait( lock, [this]() { return _remaining == 0; } );
+               if( _first_error )
+                  std::rethrow_exception( _first_error );
+            }
+
+         private:
+            std::mutex              _mutex;
+            std::condition_variable _done;
+            size_t                  _remaining;
+            std::exception_ptr      _first_error;
+      };
+
+      std::vector< std::unique_ptr<fc::thread> > _threads;
+      std::atomic<uint32_t>                      _next_thread;
+};
+
+} } // graphene::utilities
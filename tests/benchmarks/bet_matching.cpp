@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/betting_market_object.hpp>
+
+#include "../common/betting_test_markets.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+BOOST_FIXTURE_TEST_SUITE( bet_matching_bench, database_fixture )
+
+/**
+ * Fills deep books of small lay bets over many odds levels and sweeps them with large back bets.
+ */
+BOOST_AUTO_TEST_CASE( deep_book_sweep_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t levels = 100;
+      const uint32_t bets_per_level = 200;
+#else
+      const uint32_t levels = 20;
+      const uint32_t bets_per_level = 20;
+#endif
+      const uint32_t maker_count = 50;
+      const uint32_t sweeps = 10;
+
+      ACTORS( (taker) );
+      CREATE_ICE_HOCKEY_BETTING_MARKET(false, 0);
+
+      vector<account_id_type> makers;
+      for( uint32_t i = 0; i < maker_count; ++i )
+      {
+         makers.push_back( create_account( "maker" + fc::to_string( i ) ).id );
+         transfer( account_id_type(), makers.back(), asset( 100000000 ) );
+      }
+      transfer( account_id_type(), taker_id, asset( 1000000000 ) );
+
+      generate_block();
+
+      // every round builds a book at odds from 2.0 up in steps of 0.01, a taker sweeps all of it and the
+      // round is undone
+      int64_t fill_time = 0;
+      int64_t sweep_time = 0;
+      for( uint32_t sweep = 0; sweep < sweeps; ++sweep )
+      {
+         auto fill_start = fc::time_point::now();
+         for( uint32_t level = 0; level < levels; ++level )
+         {
+            bet_multiplier_type multiplier = 2 * GRAPHENE_BETTING_ODDS_PRECISION + level * GRAPHENE_BETTING_ODDS_PRECISION / 100;
+            share_type minimum = bet_object::get_ratio( multiplier ).second;
+            for( uint32_t i = 0; i < bets_per_level; ++i )
+               place_bet( makers[(level * bets_per_level + i) % maker_count], capitals_win_market.id, bet_type::lay,
+                          asset( minimum * 10, asset_id_type() ), multiplier );
+         }
+         auto sweep_start = fc::time_point::now();
+         fill_time += (sweep_start - fill_start).count();
+         place_bet( taker_id, capitals_win_market.id, bet_type::back, asset( 100000000, asset_id_type() ),
+                    2 * GRAPHENE_BETTING_ODDS_PRECISION );
+         sweep_time += (fc::time_point::now() - sweep_start).count();
+
+         const auto& bet_odds_idx = db.get_index_type<bet_object_index>().indices().get<by_odds>();
+         BOOST_CHECK( bet_odds_idx.lower_bound( std::make_tuple( capitals_win_market.id, bet_type::lay ) ) ==
+                      bet_odds_idx.upper_bound( std::make_tuple( capitals_win_market.id, bet_type::lay ) ) );
+         db.clear_pending();
+      }
+
+      ilog( "Placed ${n} maker bets in ${f} milliseconds, ${s} takers swept ${l} levels of ${b} bets in ${t} milliseconds.",
+            ("n", sweeps * levels * bets_per_level)("f", fill_time / 1000)
+            ("s", sweeps)("l", levels)("b", bets_per_level)("t", sweep_time / 1000) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
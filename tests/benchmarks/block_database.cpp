@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/block_database.hpp>
+#include <graphene/chain/protocol/transfer.hpp>
+#include <graphene/utilities/tempdir.hpp>
+#include <graphene/utilities/thread_pool.hpp>
+
+#include <fc/smart_ref_impl.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <algorithm>
+#include <random>
+
+using namespace graphene::chain;
+
+namespace {
+
+void fill_block_database( const fc::path& dir, uint32_t block_count )
+{
+   block_database bdb;
+   bdb.open( dir );
+   signed_block b;
+   for( uint32_t i = 0; i < block_count; ++i )
+   {
+      if( i > 0 ) b.previous = b.id();
+      b.transactions.clear();
+      for( uint32_t t = 0; t < 10; ++t )
+      {
+         processed_transaction trx;
+         transfer_operation op;
+         op.from = account_id_type( i );
+         op.to = account_id_type( t );
+         op.amount = asset( i * 10 + t );
+         trx.operations.push_back( op );
+         b.transactions.push_back( trx );
+      }
+      b.transaction_merkle_root = b.calculate_merkle_root();
+      bdb.store( b.id(), b );
+   }
+   bdb.close();
+}
+
+/// @return milliseconds spent fetching @ref block_nums through a @ref backend database
+int64_t time_fetches( block_database::backend_type backend, const fc::path& dir, const vector<uint32_t>& block_nums )
+{
+   block_database bdb( backend );
+   bdb.open( dir );
+   auto start_time = fc::time_point::now();
+   for( uint32_t num : block_nums )
+      BOOST_REQUIRE( bdb.fetch_by_number( num ).valid() );
+   auto elapsed = (fc::time_point::now() - start_time).count() / 1000;
+   bdb.close();
+   return elapsed;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( block_database_fetch_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t block_count = 200000;
+#else
+      const uint32_t block_count = 20000;
+#endif
+
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      fill_block_database( data_dir.path(), block_count );
+
+      vector<uint32_t> sequential( block_count );
+      for( uint32_t i = 0; i < block_count; ++i )
+         sequential[i] = i + 1;
+      vector<uint32_t> random_order = sequential;
+      std::shuffle( random_order.begin(), random_order.end(), std::mt19937( 1 ) );
+
+      for( auto backend : { block_database::stream_backend, block_database::mapped_backend } )
+      {
+         const char* name = backend == block_database::stream_backend ? "stream" : "mapped";
+         ilog( "${b} backend: fetched ${c} blocks sequentially in ${t} milliseconds.",
+               ("b", name)("c", block_count)("t", time_fetches( backend, data_dir.path(), sequential )) );
+         ilog( "${b} backend: fetched ${c} blocks in random order in ${t} milliseconds.",
+               ("b", name)("c", block_count)("t", time_fetches( backend, data_dir.path(), random_order )) );
+      }
+
+      // the mapped backend can be shared by concurrent readers
+      graphene::utilities::thread_pool pool( 4, "bench-reader" );
+      block_database bdb( block_database::mapped_backend );
+      bdb.open( data_dir.path() );
+      auto start_time = fc::time_point::now();
+      pool.for_each_range( random_order.size(), [&]( size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i )
+            FC_ASSERT( bdb.fetch_by_number( random_order[i] ).valid() );
+      });
+      ilog( "mapped backend: fetched ${c} blocks in random order from ${n} threads in ${t} milliseconds.",
+            ("c", block_count)("n", pool.size())("t", (fc::time_point::now() - start_time).count() / 1000) );
+      bdb.close();
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/vesting_balance_object.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+BOOST_FIXTURE_TEST_SUITE( dividend_distribution_bench, database_fixture )
+
+/**
+ * Gathers the holdings of a dividend asset the way schedule_pending_dividend_balances does, with a
+ * chain holding as many vesting balances in other assets as there are holders of the dividend asset.
+ */
+BOOST_AUTO_TEST_CASE( dividend_holders_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t holder_count = 1000000;
+#else
+      const uint32_t holder_count = 50000;
+#endif
+      const asset_id_type dividend_asset = asset_id_type( 100 );
+      const asset_id_type other_asset = asset_id_type( 101 );
+
+      for( uint32_t i = 0; i < holder_count; ++i )
+      {
+         const account_id_type owner( 1000 + i );
+         db.create<account_balance_object>( [&]( account_balance_object& b ) {
+            b.owner = owner;
+            b.asset_type = dividend_asset;
+            b.balance = 1000 + i % 997;
+         });
+         // every fourth holder also has part of its stake vesting
+         if( i % 4 == 0 )
+            db.create<vesting_balance_object>( [&]( vesting_balance_object& vbo ) {
+               vbo.owner = owner;
+               vbo.balance = asset( 500 + i % 991, dividend_asset );
+               vbo.policy = cdd_vesting_policy();
+            });
+         db.create<vesting_balance_object>( [&]( vesting_balance_object& vbo ) {
+            vbo.owner = owner;
+            vbo.balance = asset( 500 + i % 991, other_asset );
+            vbo.policy = cdd_vesting_policy();
+         });
+      }
+
+      const auto& balances = db.get_index_type<account_balance_index>().indices().get<by_asset_balance>();
+      const auto& vesting_idx = dynamic_cast<const primary_index<vesting_balance_index>&>(db.get_index_type<vesting_balance_index>());
+      auto holders_begin = balances.lower_bound( boost::make_tuple( dividend_asset ) );
+      auto holders_end = balances.upper_bound( boost::make_tuple( dividend_asset, share_type() ) );
+
+      auto total_holdings = [&]( const std::map<account_id_type, share_type>& vesting_amounts ) -> share_type {
+         share_type total;
+         for( const account_balance_object& b : boost::make_iterator_range( holders_begin, holders_end ) )
+         {
+            total += b.balance;
+            auto itr = vesting_amounts.find( b.owner );
+            if( itr != vesting_amounts.end() )
+               total += itr->second;
+         }
+         return total;
+      };
+
+      // what every dividend asset used to pay: a walk over all vesting balances on chain into a fresh map
+      auto start_time = fc::time_point::now();
+      std::map<account_id_type, share_type> scanned;
+      for( const vesting_balance_object& vbo : vesting_idx.indices().get<by_id>() )
+         if( vbo.balance.asset_id == dividend_asset && vbo.balance.amount )
+            scanned[vbo.owner] += vbo.balance.amount;
+      share_type scanned_total = total_holdings( scanned );
+      auto scan_time = fc::time_point::now() - start_time;
+
+      start_time = fc::time_point::now();
+      share_type cached_total = total_holdings( vesting_idx.get_secondary_index<vesting_balance_holder_index>().get_holders( dividend_asset ) );
+      auto cached_time = fc::time_point::now() - start_time;
+
+      BOOST_CHECK_EQUAL( scanned_total.value, cached_total.value );
+      ilog( "Summed the holdings of ${n} holders in ${s} milliseconds scanning all vesting balances, "
+            "${c} milliseconds with the holder index.",
+            ("n", holder_count)("s", scan_time.count() / 1000)("c", cached_time.count() / 1000) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
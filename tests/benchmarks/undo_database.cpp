@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/protocol/transfer.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+BOOST_FIXTURE_TEST_SUITE( undo_database_bench, database_fixture )
+
+BOOST_AUTO_TEST_CASE( push_transaction_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t rounds = 50;
+#else
+      const uint32_t rounds = 5;
+#endif
+      const uint32_t transactions_per_round = 1000;
+
+      ACTORS( (alice)(bob) );
+      fund( alice_id(db), asset( 1000000000 ) );
+
+      // every transaction runs in its own session merged into the pending one, clear_pending()
+      // undoes them all at once
+      int64_t push_time = 0;
+      int64_t clear_time = 0;
+      for( uint32_t round = 0; round < rounds; ++round )
+      {
+         auto start_time = fc::time_point::now();
+         for( uint32_t i = 0; i < transactions_per_round; ++i )
+         {
+            signed_transaction tx;
+            transfer_operation op;
+            op.from = alice_id;
+            op.to = bob_id;
+            op.amount = asset( i + 1 );
+            tx.operations.push_back( op );
+            tx.set_expiration( db.head_block_time() + fc::minutes(1) );
+            PUSH_TX( db, tx, ~0 );
+         }
+         auto pushed_time = fc::time_point::now();
+         db.clear_pending();
+         push_time += (pushed_time - start_time).count();
+         clear_time += (fc::time_point::now() - pushed_time).count();
+      }
+      ilog( "Pushed ${n} transactions in ${t} milliseconds, undone in ${u} milliseconds.",
+            ("n", rounds * transactions_per_round)("t", push_time / 1000)("u", clear_time / 1000) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( merge_and_undo_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t cycles = 2000;
+#else
+      const uint32_t cycles = 200;
+#endif
+      const uint32_t sessions_per_cycle = 100;
+      const uint32_t objects_per_session = 20;
+
+      for( uint32_t i = 0; i < objects_per_session * 2; ++i )
+         db.create<account_balance_object>( [&]( account_balance_object& b ) {
+            b.owner = account_id_type( 1000 + i );
+            b.asset_type = asset_id_type( 100 );
+         });
+      const auto& balances = db.get_index_type<account_balance_index>().indices();
+
+      auto start_time = fc::time_point::now();
+      for( uint32_t cycle = 0; cycle < cycles; ++cycle )
+      {
+         auto outer = db._undo_db.start_undo_session();
+         for( uint32_t s = 0; s < sessions_per_cycle; ++s )
+         {
+            auto inner = db._undo_db.start_undo_session();
+            uint32_t n = 0;
+            for( auto itr = balances.begin(); itr != balances.end() && n < objects_per_session; ++itr, ++n )
+               db.modify( *itr, [&]( account_balance_object& b ) { b.balance += 1; } );
+            db.create<account_balance_object>( [&]( account_balance_object& b ) {
+               b.owner = account_id_type( 2000 + s );
+               b.asset_type = asset_id_type( 100 );
+            });
+            inner.merge();
+         }
+         outer.undo();
+      }
+      ilog( "${c} cycles of ${s} merged sessions and an undo in ${t} milliseconds.",
+            ("c", cycles)("s", sessions_per_cycle)("t", (fc::time_point::now() - start_time).count() / 1000) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/vote_tally.hpp>
+#include <graphene/utilities/thread_pool.hpp>
+
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <thread>
+
+using namespace graphene::chain;
+
+BOOST_AUTO_TEST_CASE( vote_tally_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t voter_count = 3000000;
+#else
+      const uint32_t voter_count = 100000;
+#endif
+      const uint32_t vote_id_count = 2000;
+      const uint32_t opinion_count = 10000;
+      const uint32_t votes_per_opinion = 30;
+
+      // most voters vote for themselves, so almost every voter has its own set of opinions
+      vector<account_options> opinions( opinion_count );
+      for( uint32_t i = 0; i < opinion_count; ++i )
+      {
+         for( uint32_t v = 0; v < votes_per_opinion; ++v )
+            opinions[i].votes.insert( vote_id_type( vote_id_type::witness, (i * 7919 + v * 104729) % vote_id_count ) );
+         opinions[i].num_witness = i % 101;
+         opinions[i].num_committee = i % 51;
+      }
+      vector<vote_tally::voter> voters( voter_count );
+      for( uint32_t i = 0; i < voter_count; ++i )
+      {
+         voters[i].opinion = &opinions[(i * 2654435761u) % opinion_count];
+         voters[i].stake = 1000 + i % 100000;
+      }
+
+      auto run = [&]( graphene::utilities::thread_pool* pool ) -> vote_tally
+      {
+         vote_tally tally( vote_id_count, 1001, 1001 );
+         auto start = fc::time_point::now();
+         tally.tally( voters, pool );
+         ilog( "Tallied ${n} voters on ${t} threads in ${ms} milliseconds",
+               ("n", voter_count)("t", pool ? pool->size() : 1)
+               ("ms", (fc::time_point::now() - start).count() / 1000) );
+         return tally;
+      };
+
+      vote_tally serial = run( nullptr );
+      graphene::utilities::thread_pool pool( std::max( 2u, std::thread::hardware_concurrency() ) );
+      vote_tally parallel = run( &pool );
+      BOOST_CHECK( serial.votes() == parallel.votes() );
+      BOOST_CHECK( serial.witness_histogram() == parallel.witness_histogram() );
+      BOOST_CHECK_EQUAL( serial.total_stake(), parallel.total_stake() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -423,6 +423,79 @@ BOOST_AUTO_TEST_CASE(binned_order_books)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(taker_sweeps_price_levels)
+{
+   try
+   {
+      ACTORS( (alice)(bob)(carol)(dan) );
+      CREATE_ICE_HOCKEY_BETTING_MARKET(false, 0);
+
+      transfer(account_id_type(), alice_id, asset(10000));
+      transfer(account_id_type(), bob_id, asset(10000));
+      transfer(account_id_type(), carol_id, asset(10000));
+      transfer(account_id_type(), dan_id, asset(10000));
+
+      const auto& bet_idx = dynamic_cast<const primary_index<bet_object_index>&>(db.get_index_type<bet_object_index>());
+      const bet_price_level_index& price_levels = bet_idx.get_secondary_index<bet_price_level_index>();
+
+      // lay 200 at 3.0 (1:2), then 100 each at 2.0 (1:1)
+      place_bet(bob_id, capitals_win_market.id, bet_type::lay, asset(200, asset_id_type()), 3 * GRAPHENE_BETTING_ODDS_PRECISION);
+      place_bet(carol_id, capitals_win_market.id, bet_type::lay, asset(100, asset_id_type()), 2 * GRAPHENE_BETTING_ODDS_PRECISION);
+      place_bet(dan_id, capitals_win_market.id, bet_type::lay, asset(100, asset_id_type()), 2 * GRAPHENE_BETTING_ODDS_PRECISION);
+      place_bet(bob_id, capitals_win_market.id, bet_type::lay, asset(100, asset_id_type()), 2 * GRAPHENE_BETTING_ODDS_PRECISION);
+
+      auto levels = price_levels.get_levels(capitals_win_market.id, bet_type::lay);
+      BOOST_REQUIRE_EQUAL(std::distance(levels.first, levels.second), 2);
+      BOOST_CHECK_EQUAL(levels.first->first.backer_multiplier, 3 * GRAPHENE_BETTING_ODDS_PRECISION);
+      BOOST_CHECK_EQUAL(levels.first->second.amount_to_bet.value, 200);
+      BOOST_CHECK_EQUAL(levels.first->second.bet_count, 1u);
+      BOOST_CHECK_EQUAL(std::next(levels.first)->first.backer_multiplier, 2 * GRAPHENE_BETTING_ODDS_PRECISION);
+      BOOST_CHECK_EQUAL(std::next(levels.first)->second.amount_to_bet.value, 300);
+      BOOST_CHECK_EQUAL(std::next(levels.first)->second.bet_count, 3u);
+
+      // alice's back of 1000 at 2.0 takes the 3.0 level, then the 2.0 level in the order the bets were placed,
+      // and 600 stay on the books
+      place_bet(alice_id, capitals_win_market.id, bet_type::back, asset(1000, asset_id_type()), 2 * GRAPHENE_BETTING_ODDS_PRECISION);
+      BOOST_CHECK_EQUAL(get_balance(alice_id, asset_id_type()), 9000);
+      BOOST_CHECK_EQUAL(get_balance(bob_id, asset_id_type()), 9700);
+      BOOST_CHECK_EQUAL(get_balance(carol_id, asset_id_type()), 9900);
+      BOOST_CHECK_EQUAL(get_balance(dan_id, asset_id_type()), 9900);
+
+      levels = price_levels.get_levels(capitals_win_market.id, bet_type::lay);
+      BOOST_CHECK(levels.first == levels.second);
+      levels = price_levels.get_levels(capitals_win_market.id);
+      BOOST_REQUIRE_EQUAL(std::distance(levels.first, levels.second), 1);
+      BOOST_CHECK(levels.first->first.back_or_lay == bet_type::back);
+      BOOST_CHECK_EQUAL(levels.first->second.amount_to_bet.value, 600);
+
+      const auto& positions = db.get_index_type<betting_market_position_index>().indices().get<by_bettor_betting_market>();
+      const betting_market_position_object& alice_position = *positions.find(boost::make_tuple(alice_id, capitals_win_market.id));
+      BOOST_CHECK_EQUAL(alice_position.pay_if_payout_condition.value, 900);
+      BOOST_CHECK_EQUAL(alice_position.pay_if_not_payout_condition.value, 0);
+      BOOST_CHECK_EQUAL(alice_position.pay_if_canceled.value, 400);
+      const betting_market_position_object& bob_position = *positions.find(boost::make_tuple(bob_id, capitals_win_market.id));
+      BOOST_CHECK_EQUAL(bob_position.pay_if_payout_condition.value, 0);
+      BOOST_CHECK_EQUAL(bob_position.pay_if_not_payout_condition.value, 500);
+      BOOST_CHECK_EQUAL(bob_position.pay_if_canceled.value, 300);
+
+      // bob's lay of 700 takes alice's back and leaves 100, which his own back then matches
+      place_bet(bob_id, capitals_win_market.id, bet_type::lay, asset(700, asset_id_type()), 2 * GRAPHENE_BETTING_ODDS_PRECISION);
+      levels = price_levels.get_levels(capitals_win_market.id, bet_type::lay);
+      BOOST_REQUIRE_EQUAL(std::distance(levels.first, levels.second), 1);
+      BOOST_CHECK_EQUAL(levels.first->second.amount_to_bet.value, 100);
+      place_bet(bob_id, capitals_win_market.id, bet_type::back, asset(200, asset_id_type()), 2 * GRAPHENE_BETTING_ODDS_PRECISION);
+      // backing 100 against his lay position returns 200 of guaranteed winnings
+      BOOST_CHECK_EQUAL(get_balance(bob_id, asset_id_type()), 9700 - 700 - 200 + 200);
+      levels = price_levels.get_levels(capitals_win_market.id, bet_type::lay);
+      BOOST_CHECK(levels.first == levels.second);
+      levels = price_levels.get_levels(capitals_win_market.id, bet_type::back);
+      BOOST_REQUIRE_EQUAL(std::distance(levels.first, levels.second), 1);
+      BOOST_CHECK_EQUAL(levels.first->second.amount_to_bet.value, 100);
+      BOOST_CHECK_EQUAL(levels.first->second.bet_count, 1u);
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( peerplays_sport_create_test )
 {
    try
@@ -491,6 +564,55 @@ BOOST_AUTO_TEST_CASE( cancel_unmatched_in_betting_group_test )
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(settle_with_worker_threads)
+{
+   try
+   {
+      CREATE_ICE_HOCKEY_BETTING_MARKET(false, 0);
+      db.set_worker_threads( 4 );
+
+      // with an existing balance the rake is credited once after all payouts
+      const asset_object& core = asset_id_type()(db);
+      BOOST_REQUIRE(core.dividend_data_id);
+      const account_id_type rake_account_id = (*core.dividend_data_id)(db).dividend_distribution_account;
+      transfer(account_id_type(), rake_account_id, asset(1));
+      const int64_t rake_balance = get_balance(rake_account_id, asset_id_type());
+
+      // enough bettors for the payouts to be computed on the worker threads
+      const uint32_t pair_count = 600;
+      vector<account_id_type> backers;
+      vector<account_id_type> layers;
+      for (uint32_t i = 0; i < pair_count; ++i)
+      {
+         backers.push_back(create_account("backer" + fc::to_string(i)).id);
+         layers.push_back(create_account("layer" + fc::to_string(i)).id);
+         transfer(account_id_type(), backers.back(), asset(1000));
+         transfer(account_id_type(), layers.back(), asset(1000));
+         place_bet(layers.back(), capitals_win_market.id, bet_type::lay, asset(100, asset_id_type()), 2 * GRAPHENE_BETTING_ODDS_PRECISION);
+         place_bet(backers.back(), capitals_win_market.id, bet_type::back, asset(100, asset_id_type()), 2 * GRAPHENE_BETTING_ODDS_PRECISION);
+      }
+      generate_blocks(1);
+
+      update_betting_market_group(moneyline_betting_markets.id, _status = betting_market_group_status::closed);
+      // caps win
+      resolve_betting_market_group(moneyline_betting_markets.id,
+                                  {{capitals_win_market.id, betting_market_resolution_type::win},
+                                   {blackhawks_win_market.id, betting_market_resolution_type::not_win}});
+      generate_blocks(1);
+
+      uint16_t rake_fee_percentage = db.get_global_properties().parameters.betting_rake_fee_percentage();
+      int64_t rake_value = (100 * rake_fee_percentage + GRAPHENE_100_PERCENT - 1) / GRAPHENE_100_PERCENT;
+      for (uint32_t i = 0; i < pair_count; ++i)
+      {
+         BOOST_CHECK_EQUAL(get_balance(backers[i], asset_id_type()), 1000 - 100 + 200 - rake_value);
+         BOOST_CHECK_EQUAL(get_balance(layers[i], asset_id_type()), 1000 - 100);
+      }
+      BOOST_CHECK_EQUAL(get_balance(rake_account_id, asset_id_type()), rake_balance + pair_count * rake_value);
+      const auto& positions = db.get_index_type<betting_market_position_index>().indices().get<by_betting_market_bettor>();
+      BOOST_CHECK(positions.lower_bound(capitals_win_market.id) == positions.upper_bound(capitals_win_market.id));
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE(match_using_takers_expected_amounts)
 {
    try
@@ -32,11 +32,16 @@
 #include <graphene/chain/committee_member_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/market_object.hpp>
+#include <graphene/chain/transaction_object.hpp>
 #include <graphene/chain/witness_schedule_object.hpp>
 
 #include <graphene/utilities/tempdir.hpp>
+#include <graphene/utilities/thread_pool.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <atomic>
 
 #include "../common/database_fixture.hpp"
 
@@ -126,6 +131,233 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_database_backends_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      vector<block_id_type> ids;
+      {
+         block_database bdb( block_database::mapped_backend );
+         bdb.open( data_dir.path() );
+         signed_block b;
+         for( uint32_t i = 0; i < 5; ++i )
+         {
+            if( i > 0 ) b.previous = b.id();
+            b.witness = witness_id_type(i+1);
+            bdb.store( b.id(), b );
+            ids.push_back( b.id() );
+         }
+         bdb.remove( ids.back() );
+         BOOST_CHECK( !bdb.contains( ids.back() ) );
+         BOOST_CHECK( *bdb.last_id() == ids[3] );
+         bdb.close();
+      }
+      {
+         // files written by the mapped backend are readable by the stream backend and vice versa
+         block_database bdb( block_database::stream_backend );
+         bdb.open( data_dir.path() );
+         BOOST_CHECK( *bdb.last_id() == ids[3] );
+         for( uint32_t i = 0; i < 4; ++i )
+         {
+            BOOST_CHECK( bdb.contains( ids[i] ) );
+            BOOST_CHECK( bdb.fetch_block_id( i+1 ) == ids[i] );
+         }
+         BOOST_CHECK( !bdb.contains( ids[4] ) );
+
+         signed_block b = *bdb.last();
+         b.previous = b.id();
+         b.witness = witness_id_type(100);
+         bdb.store( b.id(), b );
+         ids[4] = b.id();
+         bdb.close();
+      }
+      {
+         block_database bdb( block_database::mapped_backend );
+         bdb.open( data_dir.path() );
+         BOOST_CHECK( *bdb.last_id() == ids[4] );
+         BOOST_CHECK( bdb.fetch_by_number( 5 )->witness == witness_id_type(100) );
+         BOOST_CHECK( !bdb.fetch_by_number( 6 ).valid() );
+         BOOST_CHECK_THROW( bdb.fetch_block_id( 6 ), fc::key_not_found_exception );
+         bdb.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( mapped_block_database_concurrent_overwrite )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      block_database bdb( block_database::mapped_backend );
+      bdb.open( data_dir.path() );
+
+      // two competing versions of block 2, the index entry is overwritten in place on every switch
+      signed_block b1;
+      b1.witness = witness_id_type(1);
+      bdb.store( b1.id(), b1 );
+      signed_block a = b1, b = b1;
+      a.previous = b.previous = b1.id();
+      a.witness = witness_id_type(2);
+      b.witness = witness_id_type(3);
+      b.timestamp = fc::time_point_sec( 10 );
+      bdb.store( a.id(), a );
+
+      fc::thread reader( "reader" );
+      std::atomic<bool> done( false );
+      std::atomic<uint32_t> torn( 0 );
+      auto reader_done = reader.async( [&]() {
+         while( !done )
+         {
+            const block_id_type id = bdb.fetch_block_id( 2 );
+            if( id != a.id() && id != b.id() )
+               ++torn;
+         }
+      });
+      for( uint32_t i = 0; i < 5000; ++i )
+      {
+         const signed_block& next = ( i % 2 ) ? a : b;
+         bdb.store( next.id(), next );
+      }
+      done = true;
+      reader_done.wait();
+
+      BOOST_CHECK_EQUAL( torn.load(), 0u );
+      BOOST_CHECK( bdb.fetch_block_id( 2 ) == a.id() );
+      bdb.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_cache_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.get_cache().set_max_size( 3 );
+      bdb.open( data_dir.path() );
+
+      signed_block b;
+      vector<signed_block> blocks;
+      for( uint32_t i = 0; i < 5; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+         blocks.push_back( b );
+      }
+      BOOST_CHECK_EQUAL( bdb.get_cache().get_stats().size, 3u );
+
+      // the most recent blocks are served from the cache
+      BOOST_CHECK( bdb.fetch_by_number( 5 )->witness == witness_id_type(5) );
+      BOOST_CHECK( bdb.fetch_optional( blocks[3].id() )->witness == witness_id_type(4) );
+      BOOST_CHECK_EQUAL( bdb.get_cache().get_stats().hits, 2u );
+      BOOST_CHECK_EQUAL( bdb.get_cache().get_stats().misses, 0u );
+
+      // older blocks are read from disk and cached, evicting the least recently used one
+      BOOST_CHECK( bdb.fetch_by_number( 1 )->witness == witness_id_type(1) );
+      BOOST_CHECK_EQUAL( bdb.get_cache().get_stats().misses, 1u );
+      BOOST_CHECK( bdb.fetch_by_number( 1 )->witness == witness_id_type(1) );
+      BOOST_CHECK_EQUAL( bdb.get_cache().get_stats().hits, 3u );
+      BOOST_CHECK( !bdb.get_cache().find( 3 ) );
+
+      auto packed = bdb.fetch_packed( blocks[1].id() );
+      BOOST_REQUIRE( packed );
+      BOOST_CHECK( *packed == fc::raw::pack( blocks[1] ) );
+      BOOST_CHECK( !bdb.fetch_packed( block_id_type() ) );
+
+      // scans such as a replay neither use nor fill the cache
+      auto stats = bdb.get_cache().get_stats();
+      BOOST_CHECK( bdb.read_by_number( 3 )->witness == witness_id_type(3) );
+      BOOST_CHECK_EQUAL( bdb.get_cache().get_stats().hits, stats.hits );
+      BOOST_CHECK_EQUAL( bdb.get_cache().get_stats().misses, stats.misses );
+      BOOST_CHECK( !bdb.get_cache().find( 3 ) );
+
+      // removing a block invalidates its entry
+      bdb.remove( blocks[4].id() );
+      BOOST_CHECK( !bdb.fetch_by_number( 5 ).valid() );
+      BOOST_CHECK( !bdb.fetch_optional( blocks[4].id() ).valid() );
+
+      bdb.get_cache().set_max_size( 0 );
+      BOOST_CHECK_EQUAL( bdb.get_cache().get_stats().size, 0u );
+      bdb.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( segmented_block_log_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      vector<block_id_type> ids( 1 );
+      signed_block b;
+      {
+         // start with a block log in the flat layout
+         block_database bdb;
+         bdb.open( data_dir.path() );
+         for( uint32_t i = 1; i <= 30; ++i )
+         {
+            if( i > 1 ) b.previous = b.id();
+            b.witness = witness_id_type(i);
+            bdb.store( b.id(), b );
+            ids.push_back( b.id() );
+         }
+         bdb.close();
+      }
+      {
+         // it is converted into segments of 10 blocks when opened
+         block_database bdb;
+         bdb.get_cache().set_max_size( 0 );
+         bdb.enable_segments( 25, 10 );
+         bdb.open( data_dir.path() );
+         BOOST_CHECK( !fc::exists( data_dir.path() / "index" ) );
+         BOOST_CHECK( *bdb.last_id() == ids[30] );
+         BOOST_CHECK_EQUAL( bdb.first_retained_block_num(), 1u );
+         for( uint32_t i = 1; i <= 30; ++i )
+            BOOST_CHECK( bdb.fetch_block_id( i ) == ids[i] );
+
+         for( uint32_t i = 31; i <= 60; ++i )
+         {
+            b.previous = b.id();
+            b.witness = witness_id_type(i);
+            bdb.store( b.id(), b );
+            ids.push_back( b.id() );
+         }
+         // blocks 36 to 60 must be retained, so blocks 1 to 29 are gone
+         BOOST_CHECK_EQUAL( bdb.first_retained_block_num(), 30u );
+         BOOST_CHECK( !bdb.fetch_by_number( 29 ).valid() );
+         BOOST_CHECK( !bdb.contains( ids[29] ) );
+         BOOST_CHECK_THROW( bdb.fetch_block_id( 29 ), fc::key_not_found_exception );
+         BOOST_CHECK( bdb.fetch_by_number( 30 )->witness == witness_id_type(30) );
+         BOOST_CHECK( bdb.fetch_optional( ids[45] )->witness == witness_id_type(45) );
+
+         bdb.remove( ids[60] );
+         BOOST_CHECK( *bdb.last_id() == ids[59] );
+         bdb.close();
+      }
+      {
+         // without enable_segments() a segmented block log is still recognized
+         block_database bdb;
+         bdb.open( data_dir.path() );
+         BOOST_CHECK( bdb.backend() == block_database::segmented_backend );
+         BOOST_CHECK( bdb.last()->id() == ids[59] );
+         BOOST_CHECK_EQUAL( bdb.first_retained_block_num(), 30u );
+         bdb.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -1308,4 +1540,823 @@ BOOST_FIXTURE_TEST_CASE( miss_many_blocks, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( parallel_signature_recovery, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( account_id_type(), alice_id, asset( 1000000 ) );
+      generate_block();
+
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      database db2;
+      db2.open( data_dir2.path(), make_genesis );
+      db2.set_worker_threads( 4 );
+      BOOST_CHECK( db.get_chain_id() == db2.get_chain_id() );
+
+      while( db2.head_block_num() < db.head_block_num() )
+      {
+         optional< signed_block > b = db.fetch_block_by_number( db2.head_block_num()+1 );
+         db2.push_block(*b, database::skip_witness_signature|
+               database::skip_authority_check|
+               database::skip_witness_schedule_check);
+      }
+
+      auto push_transfer = [&]( const fc::ecc::private_key& key, int64_t amount, uint32_t skip )
+      {
+         signed_transaction tx;
+         transfer_operation op;
+         op.from = alice_id;
+         op.to = bob_id;
+         op.amount = asset( amount );
+         tx.operations.push_back( op );
+         for( auto& o : tx.operations ) db.current_fee_schedule().set_fee( o );
+         set_expiration( db, tx );
+         sign( tx, key );
+         PUSH_TX( db, tx, skip );
+      };
+
+      // db2 recovers the keys of these transactions on its worker threads
+      for( int64_t i = 1; i <= 10; ++i )
+         push_transfer( alice_private_key, i, database::skip_nothing );
+      signed_block b = generate_block( database::skip_nothing );
+      PUSH_BLOCK( db2, b, database::skip_witness_signature | database::skip_witness_schedule_check );
+      BOOST_CHECK_EQUAL( db2.get_balance( bob_id, asset_id_type() ).amount.value, 55 );
+      BOOST_CHECK( db2.head_block_id() == db.head_block_id() );
+
+      // a transaction that fails validation on the worker threads must invalidate the block
+      push_transfer( alice_private_key, 13, database::skip_nothing );
+      b = generate_block( database::skip_nothing );
+      signed_block invalid = b;
+      {
+         signed_transaction tx;
+         transfer_operation op;
+         op.from = alice_id;
+         op.to = alice_id;
+         op.amount = asset( 1 );
+         tx.operations.push_back( op );
+         for( auto& o : tx.operations ) db.current_fee_schedule().set_fee( o );
+         set_expiration( db, tx );
+         sign( tx, alice_private_key );
+         invalid.transactions.insert( invalid.transactions.begin(), processed_transaction( tx ) );
+         invalid.transaction_merkle_root = invalid.calculate_merkle_root();
+      }
+      GRAPHENE_REQUIRE_THROW( PUSH_BLOCK( db2, invalid, database::skip_witness_signature | database::skip_witness_schedule_check ), fc::exception );
+      BOOST_CHECK_EQUAL( db2.get_balance( bob_id, asset_id_type() ).amount.value, 55 );
+      PUSH_BLOCK( db2, b, database::skip_witness_signature | database::skip_witness_schedule_check );
+      BOOST_CHECK_EQUAL( db2.get_balance( bob_id, asset_id_type() ).amount.value, 68 );
+      BOOST_CHECK( db2.head_block_id() == db.head_block_id() );
+
+      // a transaction signed with the wrong key must still invalidate the block
+      push_transfer( alice_private_key, 11, database::skip_nothing );
+      push_transfer( bob_private_key, 12, database::skip_transaction_signatures | database::skip_authority_check );
+      b = generate_block( database::skip_authority_check );
+      GRAPHENE_REQUIRE_THROW( PUSH_BLOCK( db2, b, database::skip_witness_signature | database::skip_witness_schedule_check ), fc::exception );
+      BOOST_CHECK_EQUAL( db2.get_balance( bob_id, asset_id_type() ).amount.value, 68 );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( thread_pool_range_wait_does_not_yield )
+{
+   try
+   {
+      graphene::utilities::thread_pool pool( 2 );
+      bool other_task_ran = false;
+      auto other_task = fc::async( [&]() { other_task_ran = true; } );
+      std::atomic<uint32_t> ranges( 0 );
+      pool.for_each_range( 2, [&]( size_t, size_t ) {
+         fc::usleep( fc::milliseconds( 20 ) );
+         ++ranges;
+      });
+      // a task of this thread must not run while the ranges are processed
+      BOOST_CHECK( !other_task_ran );
+      BOOST_CHECK_EQUAL( ranges.load(), 2u );
+      other_task.wait();
+      BOOST_CHECK( other_task_ran );
+
+      // failures are rethrown once every range is done
+      ranges = 0;
+      GRAPHENE_REQUIRE_THROW( pool.for_each_range( 2, [&]( size_t begin, size_t ) {
+         fc::usleep( fc::milliseconds( begin == 0 ? 0 : 20 ) );
+         ++ranges;
+         FC_ASSERT( begin != 0 );
+      }), fc::exception );
+      BOOST_CHECK_EQUAL( ranges.load(), 2u );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( signature_key_cache_test, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( account_id_type(), alice_id, asset( 1000000 ) );
+      generate_block();
+      BOOST_CHECK_EQUAL( db.get_signature_key_cache().size(), 0 );
+
+      signed_transaction tx;
+      transfer_operation op;
+      op.from = alice_id;
+      op.to = bob_id;
+      op.amount = asset( 100 );
+      tx.operations.push_back( op );
+      for( auto& o : tx.operations ) db.current_fee_schedule().set_fee( o );
+      set_expiration( db, tx );
+      sign( tx, alice_private_key );
+      PUSH_TX( db, tx, database::skip_nothing );
+      BOOST_CHECK_EQUAL( db.get_signature_key_cache().size(), 1 );
+
+      // the cached key is used when the transaction is re-applied and included in the block
+      generate_block( database::skip_nothing );
+      BOOST_CHECK_EQUAL( db.get_balance( bob_id, asset_id_type() ).amount.value, 100 );
+      BOOST_CHECK_EQUAL( db.get_signature_key_cache().size(), 1 );
+
+      generate_blocks( tx.expiration + db.block_interval() );
+      generate_block();
+      BOOST_CHECK_EQUAL( db.get_signature_key_cache().size(), 0 );
+
+      // keys are only reused for the digest they were recovered from
+      signature_key_cache cache;
+      const digest_type digest = tx.sig_digest( db.get_chain_id() );
+      cache.insert( digest, tx.signatures[0], alice_public_key, tx.expiration );
+      BOOST_CHECK( cache.find( digest, tx.signatures[0] ).valid() );
+      BOOST_CHECK( !cache.find( tx.digest(), tx.signatures[0] ).valid() );
+      cache.set_max_size( 0 );
+      BOOST_CHECK_EQUAL( cache.size(), 0 );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( execution_profiler_test, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      auto& profiler = db.get_execution_profiler();
+      BOOST_CHECK( !profiler.enabled() );
+      generate_block();
+      BOOST_CHECK_EQUAL( profiler.get_profile().blocks, 0 );
+      BOOST_CHECK( profiler.get_profile().block_phases.empty() );
+
+      profiler.enable( true );
+      transfer( account_id_type(), alice_id, asset( 1000000 ) );
+      transfer( alice_id, bob_id, asset( 100 ) );
+      generate_block();
+
+      auto find = []( const vector<execution_histogram>& entries, const string& name ) {
+         return std::find_if( entries.begin(), entries.end(), [&]( const execution_histogram& e ) {
+            return e.name == name;
+         });
+      };
+      execution_profile profile = profiler.get_profile();
+      BOOST_CHECK( profile.enabled );
+      BOOST_CHECK_EQUAL( profile.blocks, 1 );
+      // both transfers were pushed and applied again in the block
+      auto transfers = find( profile.operations, "transfer_operation" );
+      BOOST_REQUIRE( transfers != profile.operations.end() );
+      BOOST_CHECK_GE( transfers->count, 4 );
+      uint64_t bucket_total = 0;
+      for( auto b : transfers->buckets )
+         bucket_total += b;
+      BOOST_CHECK_EQUAL( bucket_total, transfers->count );
+      BOOST_CHECK( find( profile.operations, "account_create_operation" ) == profile.operations.end() );
+      auto applied = find( profile.block_phases, "transactions" );
+      BOOST_REQUIRE( applied != profile.block_phases.end() );
+      BOOST_CHECK_EQUAL( applied->count, 1 );
+      BOOST_CHECK( find( profile.block_phases, "ending_lotteries" ) != profile.block_phases.end() );
+
+      // a block that fails in the middle of its transactions adds no samples
+      signed_block bad = generate_block();
+      db.pop_block();
+      {
+         signed_transaction tx;
+         transfer_operation op;
+         op.from = bob_id;
+         op.to = alice_id;
+         op.amount = asset( 100000000 );
+         tx.operations.push_back( op );
+         for( auto& o : tx.operations ) db.current_fee_schedule().set_fee( o );
+         set_expiration( db, tx );
+         bad.transactions.push_back( processed_transaction( tx ) );
+         bad.transaction_merkle_root = bad.calculate_merkle_root();
+      }
+      const auto header_samples = find( profiler.get_profile().block_phases, "header_validation" )->count;
+      const auto blocks = profiler.get_profile().blocks;
+      GRAPHENE_REQUIRE_THROW( db.push_block( bad, database::skip_witness_signature | database::skip_transaction_signatures
+                                                  | database::skip_authority_check ), fc::exception );
+      profile = profiler.get_profile();
+      BOOST_CHECK_EQUAL( find( profile.block_phases, "header_validation" )->count, header_samples );
+      BOOST_CHECK_EQUAL( profile.blocks, blocks );
+
+      profiler.enable( false );
+      generate_block();
+      BOOST_CHECK_EQUAL( profiler.get_profile().blocks, blocks );
+      profiler.reset();
+      BOOST_CHECK( profiler.get_profile().operations.empty() );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( deadline_scheduler_test, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( account_id_type(), alice_id, asset( 1000000 ) );
+      const asset_object& test = create_user_issued_asset( "TEST" );
+      generate_block();
+      const deadline_scheduler& scheduler = db.get_deadline_scheduler();
+
+      // dedupe entries are removed once the head block time has passed their expiration
+      signed_transaction tx;
+      transfer_operation op;
+      op.from = alice_id;
+      op.to = bob_id;
+      op.amount = asset( 100 );
+      tx.operations.push_back( op );
+      for( auto& o : tx.operations ) db.current_fee_schedule().set_fee( o );
+      set_expiration( db, tx );
+      sign( tx, alice_private_key );
+      PUSH_TX( db, tx, database::skip_nothing );
+      const auto& dedupe_index = db.get_index_type<transaction_index>().indices().get<by_expiration>();
+      BOOST_REQUIRE( !dedupe_index.empty() );
+      auto next = scheduler.next_deadline( deadline_scheduler::expired_transactions );
+      BOOST_REQUIRE( next.valid() );
+      BOOST_CHECK( *next == dedupe_index.begin()->trx.expiration + 1 );
+      generate_block();
+
+      BOOST_CHECK( !scheduler.next_deadline( deadline_scheduler::expired_limit_orders ).valid() );
+      const limit_order_object* order1 = create_sell_order( alice_id, asset( 100 ), test.amount( 100 ) );
+      const limit_order_object* order2 = create_sell_order( alice_id, asset( 200 ), test.amount( 100 ) );
+      BOOST_REQUIRE( order1 && order2 );
+      const limit_order_id_type order1_id = order1->id;
+      const limit_order_id_type order2_id = order2->id;
+      BOOST_CHECK( *scheduler.next_deadline( deadline_scheduler::expired_limit_orders ) == time_point_sec::maximum() );
+      BOOST_CHECK( !scheduler.is_due( deadline_scheduler::expired_limit_orders, db.head_block_time() ) );
+
+      const time_point_sec expiration = db.head_block_time() + 10 * db.block_interval();
+      db.modify( *order1, [&]( limit_order_object& o ) { o.expiration = expiration; } );
+      BOOST_CHECK( *scheduler.next_deadline( deadline_scheduler::expired_limit_orders ) == expiration );
+
+      // undoing a removal restores the deadline
+      {
+         auto session = db._undo_db.start_undo_session();
+         db.remove( order1_id(db) );
+         BOOST_CHECK( *scheduler.next_deadline( deadline_scheduler::expired_limit_orders ) == time_point_sec::maximum() );
+         session.undo();
+      }
+      BOOST_CHECK( *scheduler.next_deadline( deadline_scheduler::expired_limit_orders ) == expiration );
+
+      // a modifier may modify another object of the same index
+      const time_point_sec expiration2 = expiration + db.block_interval();
+      db.modify( *order1, [&]( limit_order_object& ) {
+         db.modify( order2_id(db), [&]( limit_order_object& o ) { o.expiration = expiration2; } );
+      });
+      BOOST_CHECK( *scheduler.next_deadline( deadline_scheduler::expired_limit_orders ) == expiration );
+
+      generate_blocks( expiration - db.block_interval() );
+      BOOST_CHECK( db.find( order1_id ) != nullptr );
+      BOOST_CHECK( !scheduler.is_due( deadline_scheduler::expired_limit_orders, db.head_block_time() ) );
+      generate_block();
+      BOOST_CHECK( db.find( order1_id ) == nullptr );
+      BOOST_CHECK( db.find( order2_id ) != nullptr );
+      BOOST_CHECK( *scheduler.next_deadline( deadline_scheduler::expired_limit_orders ) == expiration2 );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( pending_transaction_pool_test, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( account_id_type(), alice_id, asset( 10000000 ) );
+      generate_block();
+
+      auto make_transfer = [&]( int64_t amount, int64_t fee_multiplier ) -> signed_transaction
+      {
+         signed_transaction tx;
+         transfer_operation op;
+         op.from = alice_id;
+         op.to = bob_id;
+         op.amount = asset( amount );
+         tx.operations.push_back( op );
+         for( auto& o : tx.operations ) db.current_fee_schedule().set_fee( o );
+         tx.operations[0].get<transfer_operation>().fee.amount *= fee_multiplier;
+         set_expiration( db, tx );
+         sign( tx, alice_private_key );
+         return tx;
+      };
+
+      // the block is built by decreasing fee, not in arrival order
+      PUSH_TX( db, make_transfer( 1, 1 ), database::skip_nothing );
+      PUSH_TX( db, make_transfer( 2, 3 ), database::skip_nothing );
+      PUSH_TX( db, make_transfer( 3, 2 ), database::skip_nothing );
+      const pending_transaction_pool& pool = db.get_pending_transactions();
+      BOOST_REQUIRE_EQUAL( pool.size(), 3u );
+      for( const auto& e : pool.entries() )
+      {
+         BOOST_CHECK_EQUAL( e.packed_size, fc::raw::pack_size( e.trx ) );
+         BOOST_CHECK( e.authority_checked );
+      }
+      const auto& by_fee = pool.entries().get<pending_transaction_pool::by_fee>();
+      BOOST_CHECK( by_fee.begin()->fee_per_kb > std::prev( by_fee.end() )->fee_per_kb );
+
+      signed_block block = generate_block();
+      BOOST_REQUIRE_EQUAL( block.transactions.size(), 3u );
+      BOOST_CHECK_EQUAL( block.transactions[0].operations[0].get<transfer_operation>().amount.amount.value, 2 );
+      BOOST_CHECK_EQUAL( block.transactions[1].operations[0].get<transfer_operation>().amount.amount.value, 3 );
+      BOOST_CHECK_EQUAL( block.transactions[2].operations[0].get<transfer_operation>().amount.amount.value, 1 );
+      BOOST_CHECK( db.get_pending_transactions().empty() );
+
+      // a full pool drops the lowest fee, a transaction paying less than all others is rejected
+      db.set_max_pending_transactions( 2 );
+      PUSH_TX( db, make_transfer( 4, 2 ), database::skip_nothing );
+      PUSH_TX( db, make_transfer( 5, 3 ), database::skip_nothing );
+      PUSH_TX( db, make_transfer( 6, 4 ), database::skip_nothing );
+      BOOST_REQUIRE_EQUAL( pool.size(), 2u );
+      for( const auto& e : pool.entries() )
+         BOOST_CHECK( e.trx.operations[0].get<transfer_operation>().amount.amount.value != 4 );
+      GRAPHENE_REQUIRE_THROW( PUSH_TX( db, make_transfer( 7, 1 ), database::skip_nothing ), fc::exception );
+      BOOST_CHECK_EQUAL( pool.size(), 2u );
+      db.set_max_pending_transactions( 100000 );
+      db.clear_pending();
+
+      // expired transactions are dropped
+      pending_transaction_pool standalone;
+      signed_transaction tx1 = make_transfer( 8, 1 );
+      signed_transaction tx2 = make_transfer( 9, 1 );
+      tx1.expiration = db.head_block_time();
+      tx2.expiration = db.head_block_time() + 60;
+      BOOST_CHECK( standalone.add( tx1, fc::raw::pack_size( tx1 ), 10, false ) );
+      BOOST_CHECK( standalone.add( tx2, fc::raw::pack_size( tx2 ), 10, false ) );
+      BOOST_CHECK_EQUAL( standalone.remove_expired( db.head_block_time() ), 0u );
+      BOOST_CHECK_EQUAL( standalone.remove_expired( db.head_block_time() + 1 ), 1u );
+      BOOST_CHECK( !standalone.contains( tx1.id() ) );
+      BOOST_CHECK( standalone.contains( tx2.id() ) );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( read_write_lock_test, database_fixture )
+{
+   try
+   {
+      // a reader on another thread never sees a block being applied while it holds the read side
+      fc::thread reader( "reader" );
+      std::atomic<bool> done( false );
+      std::atomic<uint32_t> reads( 0 );
+      std::atomic<uint32_t> torn_reads( 0 );
+      auto reader_done = reader.async( [&]() {
+         while( !done )
+         {
+            read_write_lock::read_guard read( db.get_read_write_lock() );
+            const uint32_t head = db.head_block_num();
+            fc::usleep( fc::microseconds( 500 ) );
+            if( db.head_block_num() != head )
+               ++torn_reads;
+            ++reads;
+         }
+      });
+      while( reads == 0 )
+         fc::usleep( fc::milliseconds( 1 ) );
+
+      for( int i = 0; i < 20; ++i )
+      {
+         // writers nest
+         read_write_lock::write_guard write( db.get_read_write_lock() );
+         generate_block();
+      }
+      done = true;
+      reader_done.wait();
+
+      BOOST_CHECK_EQUAL( torn_reads.load(), 0u );
+      BOOST_CHECK( reads.load() > 0 );
+
+      // a second writer is held back while the first one yields, and the owner may nest
+      read_write_lock lock;
+      bool second_writing = false;
+      fc::future<void> second_done;
+      fc::future<void> reader_waits;
+      std::atomic<bool> read( false );
+      {
+         read_write_lock::write_guard first( lock );
+         second_done = fc::async( [&]() {
+            read_write_lock::write_guard second( lock );
+            second_writing = true;
+         });
+         fc::usleep( fc::milliseconds( 10 ) );
+         {
+            read_write_lock::write_guard nested( lock );
+            fc::usleep( fc::milliseconds( 10 ) );
+         }
+         BOOST_CHECK( !second_writing );
+
+         // readers wait for the owner as well
+         reader_waits = reader.async( [&]() {
+            read_write_lock::read_guard guard( lock );
+            read = true;
+         });
+         fc::usleep( fc::milliseconds( 10 ) );
+         BOOST_CHECK( !read );
+         BOOST_CHECK( !second_writing );
+      }
+      second_done.wait();
+      reader_waits.wait();
+      BOOST_CHECK( second_writing );
+      BOOST_CHECK( read );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( reindex_with_worker_threads )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      auto skip_sigs = database::skip_transaction_signatures | database::skip_authority_check;
+      block_id_type last_irreversible_id;
+      share_type init0_balance;
+      account_id_type init0_id;
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis);
+         init0_id = db.get_index_type<account_index>().indices().get<by_name>().find("init0")->id;
+
+         // produce more than one batch of prefetched blocks
+         for( uint32_t i = 1; i <= 2500; ++i )
+         {
+            // keep the transfers well below the last irreversible block
+            if( i % 100 == 0 && i <= 2400 )
+            {
+               signed_transaction trx;
+               set_expiration( db, trx );
+               transfer_operation t;
+               t.to = init0_id;
+               t.amount = asset( i );
+               trx.operations.push_back( t );
+               PUSH_TX( db, trx, skip_sigs );
+            }
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         }
+         last_irreversible_id = db.get_block_id_for_num( db.get_dynamic_global_properties().last_irreversible_block_num );
+         init0_balance = db.get_balance( init0_id, asset_id_type() ).amount;
+         // closing rewinds the chain to the last irreversible block
+         db.close();
+      }
+      {
+         database db;
+         db.set_worker_threads( 4 );
+         db.reindex( data_dir.path(), make_genesis() );
+         BOOST_CHECK( db.head_block_id() == last_irreversible_id );
+         BOOST_CHECK_EQUAL( db.get_balance( init0_id, asset_id_type() ).amount.value, init0_balance.value );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( object_database_with_worker_threads )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      auto skip_sigs = database::skip_transaction_signatures | database::skip_authority_check;
+      account_id_type init0_id;
+      {
+         // saved in parallel
+         database db;
+         db.set_worker_threads( 4 );
+         db.open(data_dir.path(), make_genesis);
+         init0_id = db.get_index_type<account_index>().indices().get<by_name>().find("init0")->id;
+         for( uint32_t i = 1; i <= 200; ++i )
+         {
+            if( i % 10 == 0 )
+            {
+               signed_transaction trx;
+               set_expiration( db, trx );
+               transfer_operation t;
+               t.to = init0_id;
+               t.amount = asset( i );
+               trx.operations.push_back( t );
+               PUSH_TX( db, trx, skip_sigs );
+            }
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         }
+         db.close();
+      }
+      block_id_type head_id;
+      share_type init0_balance;
+      size_t account_count;
+      {
+         // loaded and saved on the calling thread
+         database db;
+         db.open(data_dir.path(), make_genesis);
+         head_id = db.head_block_id();
+         init0_balance = db.get_balance( init0_id, asset_id_type() ).amount;
+         account_count = db.get_index_type<account_index>().indices().size();
+         BOOST_CHECK( init0_balance > 0 );
+         db.close();
+      }
+      {
+         // loaded in parallel
+         database db;
+         db.set_worker_threads( 4 );
+         db.open(data_dir.path(), make_genesis);
+         BOOST_CHECK( db.head_block_id() == head_id );
+         BOOST_CHECK_EQUAL( db.get_balance( init0_id, asset_id_type() ).amount.value, init0_balance.value );
+         BOOST_CHECK_EQUAL( db.get_index_type<account_index>().indices().size(), account_count );
+         // secondary indexes are rebuilt on insertion
+         BOOST_CHECK( db.get_index_type<account_index>().indices().get<by_name>().find("init0") != db.get_index_type<account_index>().indices().get<by_name>().end() );
+         db.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( incremental_state_save )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      auto skip_sigs = database::skip_transaction_signatures | database::skip_authority_check;
+      const fc::path changes_log = data_dir.path() / "object_database" / "changes.log";
+      account_id_type init0_id;
+
+      auto produce = [&]( database& db, uint32_t count ) {
+         for( uint32_t i = 1; i <= count; ++i )
+         {
+            if( i % 5 == 0 )
+            {
+               signed_transaction trx;
+               set_expiration( db, trx );
+               transfer_operation t;
+               t.to = init0_id;
+               t.amount = asset( i );
+               trx.operations.push_back( t );
+               PUSH_TX( db, trx, skip_sigs );
+            }
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         }
+      };
+
+      block_id_type head_id;
+      share_type init0_balance;
+      {
+         database db;
+         db.set_incremental_save( true );
+         db.open(data_dir.path(), make_genesis);
+         init0_id = db.get_index_type<account_index>().indices().get<by_name>().find("init0")->id;
+         produce( db, 50 );
+         // nothing has been saved yet, every index is written
+         db.close();
+         BOOST_CHECK( !fc::exists( changes_log ) );
+      }
+      {
+         database db;
+         db.set_incremental_save( true );
+         db.open(data_dir.path(), make_genesis);
+         produce( db, 50 );
+         db.close();
+         BOOST_CHECK( fc::exists( changes_log ) );
+      }
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis);
+         head_id = db.head_block_id();
+         init0_balance = db.get_balance( init0_id, asset_id_type() ).amount;
+         BOOST_CHECK( db.head_block_num() > 50 );
+         // without incremental saves the log is folded into the index files
+         db.close();
+         BOOST_CHECK( !fc::exists( changes_log ) );
+      }
+      {
+         // the saved changes match what replaying the blocks gives
+         database db;
+         db.reindex( data_dir.path(), make_genesis() );
+         BOOST_CHECK( db.head_block_id() == head_id );
+         BOOST_CHECK_EQUAL( db.get_balance( init0_id, asset_id_type() ).amount.value, init0_balance.value );
+         db.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( state_checkpoint_after_unclean_shutdown )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      auto skip_sigs = database::skip_transaction_signatures | database::skip_authority_check;
+      account_id_type init0_id;
+      block_id_type head_id;
+      share_type init0_balance;
+      {
+         database db;
+         db.set_worker_threads( 4 );
+         db.set_state_checkpoint_interval( 10 );
+         db.open(data_dir.path(), make_genesis);
+         init0_id = db.get_index_type<account_index>().indices().get<by_name>().find("init0")->id;
+         for( uint32_t i = 1; i <= 105; ++i )
+         {
+            if( i % 5 == 0 )
+            {
+               signed_transaction trx;
+               set_expiration( db, trx );
+               transfer_operation t;
+               t.to = init0_id;
+               t.amount = asset( i );
+               trx.operations.push_back( t );
+               PUSH_TX( db, trx, skip_sigs );
+            }
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         }
+         head_id = db.head_block_id();
+         init0_balance = db.get_balance( init0_id, asset_id_type() ).amount;
+         // no close(), as if the node had crashed
+      }
+      BOOST_CHECK( fc::exists( data_dir.path() / "object_database" / "changes.log" ) );
+      {
+         database db;
+         db.set_state_checkpoint_interval( 10 );
+         db.open(data_dir.path(), make_genesis);
+         // the blocks after the checkpoint are replayed from the block log
+         BOOST_CHECK( db.head_block_id() == head_id );
+         BOOST_CHECK_EQUAL( db.get_balance( init0_id, asset_id_type() ).amount.value, init0_balance.value );
+         db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         db.close();
+      }
+
+      // a crash before the first checkpoint leaves only the genesis state, the whole block log is replayed
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      {
+         database db;
+         db.set_state_checkpoint_interval( 10 );
+         db.open(data_dir2.path(), make_genesis);
+         for( uint32_t i = 1; i <= 5; ++i )
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         head_id = db.head_block_id();
+      }
+      {
+         database db;
+         db.set_state_checkpoint_interval( 10 );
+         db.open(data_dir2.path(), make_genesis);
+         BOOST_CHECK_EQUAL( db.head_block_num(), 5u );
+         BOOST_CHECK( db.head_block_id() == head_id );
+         db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         db.close();
+      }
+
+      // a block stored on a side fork leaves the head where it was, no checkpoint is saved again
+      fc::temp_directory data_dir3( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir4( graphene::utilities::temp_directory_path() );
+      {
+         database db;
+         db.set_state_checkpoint_interval( 10 );
+         db.open(data_dir3.path(), make_genesis);
+         database other;
+         other.open(data_dir4.path(), make_genesis);
+         for( uint32_t i = 1; i < 10; ++i )
+            other.push_block( db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                                 database::skip_nothing ) );
+         db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         head_id = db.head_block_id();
+         const fc::path changes_log = data_dir3.path() / "object_database" / "changes.log";
+         const uint64_t checkpointed_size = fc::file_size( changes_log );
+
+         auto side_block = other.generate_block( other.get_slot_time(2), other.get_scheduled_witness(2), init_account_priv_key,
+                                                 database::skip_nothing );
+         BOOST_REQUIRE_EQUAL( side_block.block_num(), 10u );
+         db.push_block( side_block );
+         BOOST_CHECK( db.head_block_id() == head_id );
+         BOOST_CHECK_EQUAL( fc::file_size( changes_log ), checkpointed_size );
+         other.close();
+         db.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( bootstrap_from_snapshot )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir3( graphene::utilities::temp_directory_path() );
+      fc::temp_directory snapshot_dir( graphene::utilities::temp_directory_path() );
+      const fc::path snapshot = snapshot_dir.path() / "snapshot.bin";
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      database db1;
+      db1.set_worker_threads( 4 );
+      db1.open( data_dir1.path(), make_genesis );
+      const account_id_type init0_id = db1.get_index_type<account_index>().indices().get<by_name>().find("init0")->id;
+      auto transfer_to_init0 = [&]( share_type amount ) {
+         signed_transaction trx;
+         set_expiration( db1, trx );
+         transfer_operation t;
+         t.to = init0_id;
+         t.amount = asset( amount );
+         trx.operations.push_back( t );
+         PUSH_TX( db1, trx, database::skip_transaction_signatures | database::skip_authority_check );
+      };
+
+      for( uint32_t i = 0; i < 50; ++i )
+      {
+         transfer_to_init0( i + 1 );
+         db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+      }
+      db1.save_snapshot( snapshot );
+      BOOST_REQUIRE( fc::exists( snapshot ) );
+      const block_id_type snapshot_head_id = db1.head_block_id();
+
+      database db2;
+      db2.open_from_snapshot( data_dir2.path(), snapshot );
+      BOOST_CHECK( db2.head_block_id() == snapshot_head_id );
+      BOOST_CHECK( db2.get_balance( init0_id, asset_id_type() ) == db1.get_balance( init0_id, asset_id_type() ) );
+      BOOST_CHECK_EQUAL( db2.first_retained_block_num(), 50u );
+
+      // the bootstrapped node follows the chain from the snapshot on
+      for( uint32_t i = 0; i < 20; ++i )
+      {
+         transfer_to_init0( 100 );
+         auto b = db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         PUSH_BLOCK( db2, b );
+      }
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+      BOOST_CHECK( db2.get_balance( init0_id, asset_id_type() ) == db1.get_balance( init0_id, asset_id_type() ) );
+
+      // its block log starts at the snapshot, a replay is refused before the state is wiped
+      BOOST_CHECK_THROW( db2.reindex( data_dir2.path(), make_genesis() ), fc::exception );
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+      BOOST_CHECK( db2.get_balance( init0_id, asset_id_type() ) == db1.get_balance( init0_id, asset_id_type() ) );
+
+      // an existing block log is kept as it is instead of being converted to segments
+      fc::temp_directory data_dir4( graphene::utilities::temp_directory_path() );
+      {
+         database db4;
+         db4.open( data_dir4.path(), make_genesis );
+         for( uint32_t i = 1; i <= 10; ++i )
+            PUSH_BLOCK( db4, *db1.fetch_block_by_number( i ) );
+         db4.close();
+      }
+      {
+         database db4;
+         db4.open_from_snapshot( data_dir4.path(), snapshot );
+         BOOST_CHECK( db4.head_block_id() == snapshot_head_id );
+         BOOST_CHECK_EQUAL( db4.first_retained_block_num(), 1u );
+         BOOST_CHECK( db4.fetch_block_by_number( 5 ).valid() );
+      }
+
+      // a corrupted snapshot is rejected
+      {
+         std::fstream f( snapshot.generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+         f.seekp( -1, std::ios::end );
+         f.put( 'x' );
+      }
+      database db3;
+      BOOST_CHECK_THROW( db3.open_from_snapshot( data_dir3.path(), snapshot ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -25,11 +25,15 @@
 #include <boost/test/unit_test.hpp>
 
 #include <graphene/app/database_api.hpp>
+#include <graphene/chain/read_write_lock.hpp>
+
+#include <atomic>
 
 #include "../common/database_fixture.hpp"
 
 using namespace graphene::chain;
 using namespace graphene::chain::test;
+using namespace graphene::market_history;
 
 BOOST_FIXTURE_TEST_SUITE(database_api_tests, database_fixture)
 
@@ -68,4 +72,283 @@ BOOST_FIXTURE_TEST_SUITE(database_api_tests, database_fixture)
       } FC_LOG_AND_RETHROW()
   }
 
+  BOOST_AUTO_TEST_CASE(market_ticker_rolls_over_24_hours) {
+      try {
+          ACTORS( (buyer)(seller) );
+          const asset_object& ticker_asset = create_user_issued_asset( "TICKER" );
+          const asset_id_type ticker_id = ticker_asset.id;
+          const double ticker_unit = pow( 10, ticker_asset.precision );
+          const double core_unit = pow( 10, asset_id_type()(db).precision );
+          issue_uia( seller, asset( 10000, ticker_id ) );
+          fund( buyer, asset( 10000 ) );
+          graphene::app::database_api db_api(db);
+
+          // 2 TICKER per core
+          create_sell_order( buyer, asset( 100 ), asset( 200, ticker_id ) );
+          create_sell_order( seller, asset( 200, ticker_id ), asset( 100 ) );
+          generate_block();
+          const fc::time_point_sec first_trade = db.head_block_time();
+
+          market_ticker ticker = db_api.get_ticker( "TICKER", GRAPHENE_SYMBOL );
+          BOOST_CHECK_CLOSE( ticker.latest, ( 200 / ticker_unit ) / ( 100 / core_unit ), 1e-9 );
+          BOOST_CHECK_CLOSE( ticker.base_volume, 200 / ticker_unit, 1e-9 );
+          BOOST_CHECK_CLOSE( ticker.quote_volume, 100 / core_unit, 1e-9 );
+          BOOST_CHECK_EQUAL( ticker.percent_change, 0 );
+
+          // 4 TICKER per core half a day later
+          generate_blocks( first_trade + 43200 );
+          create_sell_order( buyer, asset( 100 ), asset( 400, ticker_id ) );
+          create_sell_order( seller, asset( 400, ticker_id ), asset( 100 ) );
+          generate_block();
+
+          market_volume volume = db_api.get_24_volume( "TICKER", GRAPHENE_SYMBOL );
+          BOOST_CHECK_CLOSE( volume.base_volume, 600 / ticker_unit, 1e-9 );
+          BOOST_CHECK_CLOSE( volume.quote_volume, 200 / core_unit, 1e-9 );
+          volume = db_api.get_24_volume( GRAPHENE_SYMBOL, "TICKER" );
+          BOOST_CHECK_CLOSE( volume.base_volume, 200 / core_unit, 1e-9 );
+          BOOST_CHECK_CLOSE( volume.quote_volume, 600 / ticker_unit, 1e-9 );
+
+          // the first trade leaves the window
+          generate_blocks( first_trade + market_ticker_object::window_seconds + 2 * market_ticker_object::slot_seconds );
+          ticker = db_api.get_ticker( "TICKER", GRAPHENE_SYMBOL );
+          BOOST_CHECK_CLOSE( ticker.latest, ( 400 / ticker_unit ) / ( 100 / core_unit ), 1e-9 );
+          BOOST_CHECK_CLOSE( ticker.base_volume, 400 / ticker_unit, 1e-9 );
+          BOOST_CHECK_CLOSE( ticker.quote_volume, 100 / core_unit, 1e-9 );
+          BOOST_CHECK_CLOSE( ticker.percent_change, 100, 1e-9 );
+
+          // and so does the second one, the latest price is kept
+          generate_blocks( first_trade + 43200 + market_ticker_object::window_seconds + 2 * market_ticker_object::slot_seconds );
+          ticker = db_api.get_ticker( "TICKER", GRAPHENE_SYMBOL );
+          BOOST_CHECK_CLOSE( ticker.latest, ( 400 / ticker_unit ) / ( 100 / core_unit ), 1e-9 );
+          BOOST_CHECK_EQUAL( ticker.base_volume, 0 );
+          BOOST_CHECK_EQUAL( ticker.quote_volume, 0 );
+          BOOST_CHECK_EQUAL( ticker.percent_change, 0 );
+
+          const auto& ticker_idx = db.get_index_type<market_ticker_index>().indices().get<graphene::market_history::by_market>();
+          const market_ticker_object& ticker_obj = *ticker_idx.find( boost::make_tuple( asset_id_type(), ticker_id ) );
+          BOOST_CHECK( ticker_obj.slots.empty() );
+          BOOST_CHECK( ticker_obj.expiration == fc::time_point_sec::maximum() );
+
+      } FC_LOG_AND_RETHROW()
+  }
+
+  BOOST_AUTO_TEST_CASE(object_changes_are_converted_once) {
+      try {
+          ACTOR( nathan );
+          generate_block();
+          auto change_set = std::make_shared<graphene::app::object_change_set>( std::ref( db ) );
+
+          // two subscribers of nathan sharing the notifications
+          graphene::app::database_api first_api( db, change_set );
+          graphene::app::database_api second_api( db, change_set );
+          std::set<object_id_type> first_received;
+          std::set<object_id_type> second_received;
+          auto collect = []( std::set<object_id_type>& received ) {
+             return [&received]( const fc::variant& updates ) {
+                for( const fc::variant& update : updates.get_array() )
+                   if( update.is_object() )
+                      received.insert( update["id"].as<object_id_type>() );
+             };
+          };
+          first_api.set_subscribe_callback( collect( first_received ), false );
+          second_api.set_subscribe_callback( collect( second_received ), false );
+          first_api.get_full_accounts( { "nathan" }, true );
+          second_api.get_full_accounts( { "nathan" }, true );
+
+          // connected after both subscribers, so it sees what they converted
+          size_t changed_objects = 0;
+          size_t conversions = 0;
+          bool found_nathan = false;
+          boost::signals2::scoped_connection probe = change_set->applied.connect(
+             [&]( const graphene::app::object_changes& changes ) {
+                if( changes.type != graphene::app::object_changes::changed_objects )
+                   return;
+                for( size_t i = 0; i < changes.ids.size(); ++i )
+                   if( changes.get_object(i) )
+                      ++changed_objects;
+                conversions += changes.conversions();
+                if( changes.impacted_accounts.get().count( nathan_id ) )
+                   found_nathan = true;
+             });
+
+          transfer( account_id_type(), nathan_id, asset( 1000 ) );
+          generate_block();
+          // the subscribers are called back asynchronously on this thread
+          for( int i = 0; i < 100 && ( first_received.empty() || second_received.empty() ); ++i )
+             fc::usleep( fc::milliseconds( 10 ) );
+
+          BOOST_CHECK( found_nathan );
+          BOOST_CHECK( conversions > 0 );
+          // each changed object is converted at most once for both subscribers
+          BOOST_CHECK( conversions <= changed_objects );
+          const object_id_type statistics_id = nathan_id(db).statistics;
+          BOOST_CHECK( first_received.count( statistics_id ) );
+          BOOST_CHECK( second_received.count( statistics_id ) );
+          BOOST_CHECK( first_received == second_received );
+
+      } FC_LOG_AND_RETHROW()
+  }
+
+  BOOST_AUTO_TEST_CASE(full_account_cache_is_invalidated_by_impacted_accounts) {
+      try {
+          ACTORS( (nathan)(dan) );
+          generate_block();
+          auto cache = std::make_shared<graphene::app::full_account_cache>( std::ref( db ) );
+          graphene::app::database_api db_api( db, std::shared_ptr<graphene::app::object_change_set>(), cache );
+
+          auto core_balance = [&]() -> share_type {
+             auto accounts = db_api.get_full_accounts( { "nathan" }, false );
+             BOOST_REQUIRE_EQUAL( accounts.size(), 1u );
+             for( const auto& balance : accounts["nathan"].balances )
+                if( balance.asset_type == asset_id_type() )
+                   return balance.balance;
+             return 0;
+          };
+
+          BOOST_CHECK_EQUAL( core_balance().value, 0 );
+          BOOST_CHECK_EQUAL( core_balance().value, 0 );
+          auto stats = db_api.get_full_account_cache_stats();
+          BOOST_CHECK_EQUAL( stats.misses, 1u );
+          BOOST_CHECK_EQUAL( stats.hits, 1u );
+          BOOST_CHECK_EQUAL( stats.size, 1u );
+
+          // a pending transaction that does not touch nathan keeps the entry
+          transfer( account_id_type(), dan_id, asset( 1000 ) );
+          BOOST_CHECK_EQUAL( core_balance().value, 0 );
+          BOOST_CHECK_EQUAL( db_api.get_full_account_cache_stats().hits, 2u );
+
+          // one that does drops it
+          transfer( account_id_type(), nathan_id, asset( 1000 ) );
+          BOOST_CHECK_EQUAL( db_api.get_full_account_cache_stats().size, 0u );
+          BOOST_CHECK_EQUAL( core_balance().value, 1000 );
+
+          generate_block();
+          BOOST_CHECK_EQUAL( core_balance().value, 1000 );
+          BOOST_CHECK_EQUAL( core_balance().value, get_balance( nathan_id, asset_id_type() ) );
+
+          // undoing the block drops the entry again
+          db.pop_block();
+          db.clear_pending();
+          BOOST_CHECK_EQUAL( core_balance().value, 0 );
+
+          stats = db_api.get_full_account_cache_stats();
+          BOOST_CHECK( stats.invalidations >= 3u );
+          BOOST_CHECK_EQUAL( stats.hits, 3u );
+
+          cache->set_max_size( 0 );
+          BOOST_CHECK_EQUAL( cache->get_stats().size, 0u );
+          BOOST_CHECK_EQUAL( core_balance().value, 0 );
+          BOOST_CHECK_EQUAL( cache->get_stats().size, 0u );
+
+      } FC_LOG_AND_RETHROW()
+  }
+
+  BOOST_AUTO_TEST_CASE(full_account_cache_is_invalidated_for_new_owners) {
+      try {
+          ACTORS( (nathan)(dan) );
+          const asset_id_type moved_id = create_user_issued_asset( "MOVED", nathan, 0 ).id;
+          generate_block();
+          auto cache = std::make_shared<graphene::app::full_account_cache>( std::ref( db ) );
+          graphene::app::database_api db_api( db, std::shared_ptr<graphene::app::object_change_set>(), cache );
+
+          auto issued_by_dan = [&]() {
+             auto accounts = db_api.get_full_accounts( { "dan" }, false );
+             BOOST_REQUIRE_EQUAL( accounts.size(), 1u );
+             return accounts["dan"].assets;
+          };
+          BOOST_CHECK( issued_by_dan().empty() );
+          BOOST_CHECK_EQUAL( cache->get_stats().size, 1u );
+
+          // the asset moves to dan, whose entry is dropped although only nathan is impacted by the old value
+          asset_update_operation update_op;
+          update_op.issuer = nathan_id;
+          update_op.asset_to_update = moved_id;
+          update_op.new_issuer = dan_id;
+          update_op.new_options = moved_id(db).options;
+          signed_transaction tx;
+          tx.operations.push_back( update_op );
+          set_expiration( db, tx );
+          sign( tx, nathan_private_key );
+          PUSH_TX( db, tx );
+          BOOST_CHECK_EQUAL( cache->get_stats().size, 0u );
+          BOOST_REQUIRE_EQUAL( issued_by_dan().size(), 1u );
+
+          generate_block();
+          BOOST_REQUIRE_EQUAL( issued_by_dan().size(), 1u );
+          BOOST_CHECK( issued_by_dan()[0] == moved_id );
+
+      } FC_LOG_AND_RETHROW()
+  }
+
+  BOOST_AUTO_TEST_CASE(subscriptions_change_on_api_thread_while_blocks_are_applied) {
+      try {
+          ACTORS( (nathan)(dan) );
+          const asset_id_type subs_id = create_user_issued_asset( "SUBS" ).id;
+          issue_uia( dan_id, asset( 100000, subs_id ) );
+          fund( nathan_id(db), asset( 100000 ) );
+          generate_block();
+
+          std::atomic<uint32_t> blocks_seen( 0 );
+          std::atomic<uint32_t> updates_seen( 0 );
+          std::atomic<uint32_t> market_updates_seen( 0 );
+          std::atomic<bool> done( false );
+
+          // like a client of an API thread: its API is created and its subscriptions are changed there, holding
+          // the database for reading, while the callbacks are delivered there too
+          fc::thread api_thread( "api" );
+          std::shared_ptr<graphene::app::database_api> db_api;
+          api_thread.async( [&]() {
+             read_write_lock::read_guard read( db.get_read_write_lock() );
+             db_api = std::make_shared<graphene::app::database_api>( std::ref( db ) );
+             db_api->set_block_applied_callback( [&]( const fc::variant& ) { ++blocks_seen; } );
+          }).wait();
+
+          auto subscriber = api_thread.async( [&]() {
+             for( uint32_t i = 0; !done; ++i )
+             {
+                {
+                   read_write_lock::read_guard read( db.get_read_write_lock() );
+                   db_api->set_block_applied_callback( [&]( const fc::variant& ) { ++blocks_seen; } );
+                   db_api->set_subscribe_callback( [&]( const fc::variant& ) { ++updates_seen; }, false );
+                   db_api->get_full_accounts( { "nathan" }, true );
+                   db_api->subscribe_to_market( [&]( const fc::variant& ) { ++market_updates_seen; },
+                                                asset_id_type(), subs_id );
+                }
+                fc::usleep( fc::microseconds( 300 ) );
+                {
+                   read_write_lock::read_guard read( db.get_read_write_lock() );
+                   if( i % 2 == 0 )
+                      db_api->unsubscribe_from_market( subs_id, asset_id_type() );
+                   else
+                      db_api->cancel_all_subscriptions();
+                }
+                fc::usleep( fc::microseconds( 300 ) );
+             }
+          });
+
+          for( int i = 0; i < 50; ++i )
+          {
+             transfer( account_id_type(), nathan_id, asset( 1 ) );
+             create_sell_order( nathan_id, asset( 10 ), asset( 10, subs_id ) );
+             create_sell_order( dan_id, asset( 10, subs_id ), asset( 10 ) );
+             generate_block();
+             fc::usleep( fc::microseconds( 200 ) );
+          }
+          done = true;
+          subscriber.wait();
+
+          api_thread.async( [&]() {
+             read_write_lock::read_guard read( db.get_read_write_lock() );
+             db_api->cancel_all_subscriptions();
+             db_api->set_block_applied_callback( []( const fc::variant& ) {} );
+          }).wait();
+          // the callbacks queued before are delivered by now
+          api_thread.async( [&]() { db_api.reset(); } ).wait();
+
+          BOOST_CHECK( blocks_seen.load() > 0 );
+          BOOST_CHECK( updates_seen.load() > 0 );
+
+      } FC_LOG_AND_RETHROW()
+  }
+
 BOOST_AUTO_TEST_SUITE_END()
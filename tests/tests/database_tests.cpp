@@ -59,3 +59,63 @@ BOOST_AUTO_TEST_CASE( undo_test )
       throw;
    }
 }
+
+BOOST_AUTO_TEST_CASE( merge_test )
+{
+   try {
+      database db;
+      auto create_balance = [&]( uint32_t owner ) {
+         return db.create<account_balance_object>( [&]( account_balance_object& obj ){
+            obj.owner = account_id_type( owner );
+            obj.asset_type = asset_id_type( 100 );
+         }).id;
+      };
+
+      // more objects than the undo states buffer before merging them
+      vector<account_balance_id_type> ids;
+      for( uint32_t i = 0; i < 200; ++i )
+         ids.push_back( create_balance( i ) );
+      const auto next_id = ids.back().instance.value + 1;
+
+      auto outer = db._undo_db.start_undo_session();
+      account_balance_id_type created;
+      {
+         auto ses = db._undo_db.start_undo_session();
+         for( uint32_t i = 1; i < ids.size(); i += 2 )
+            db.modify( ids[i](db), []( account_balance_object& obj ){ obj.balance = 1; } );
+         for( uint32_t i = 0; i < ids.size(); i += 4 )
+            db.remove( ids[i](db) );
+         created = create_balance( 1000 );
+         ses.merge();
+      }
+      {
+         auto ses = db._undo_db.start_undo_session();
+         for( uint32_t i = 0; i < ids.size(); ++i )
+            if( db.find( ids[i] ) )
+               db.modify( ids[i](db), []( account_balance_object& obj ){ obj.balance += 10; } );
+         db.remove( created(db) ); // new + del
+         db.remove( ids[1](db) );  // upd + del
+         create_balance( 1001 );
+         ses.merge();
+      }
+      BOOST_CHECK( db.find( created ) == nullptr );
+      BOOST_CHECK( db.find( ids[1] ) == nullptr );
+      BOOST_CHECK_EQUAL( ids[3](db).balance.value, 11 );
+      BOOST_CHECK_EQUAL( ids[2](db).balance.value, 10 );
+
+      outer.undo();
+      for( const auto& id : ids )
+      {
+         BOOST_REQUIRE( db.find( id ) != nullptr );
+         BOOST_CHECK_EQUAL( id(db).balance.value, 0 );
+      }
+      const auto& by_owner = db.get_index_type<account_balance_index>().indices().get<by_account_asset>();
+      BOOST_CHECK( by_owner.find( boost::make_tuple( account_id_type( 1000 ), asset_id_type( 100 ) ) ) == by_owner.end() );
+      BOOST_CHECK( by_owner.find( boost::make_tuple( account_id_type( 1001 ), asset_id_type( 100 ) ) ) == by_owner.end() );
+      BOOST_CHECK_EQUAL( create_balance( 2000 ).instance.value, next_id );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
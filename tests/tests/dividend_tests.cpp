@@ -656,4 +656,73 @@ BOOST_AUTO_TEST_CASE( check_dividend_corner_cases )
       throw;
    }
 }
+BOOST_AUTO_TEST_CASE( vesting_balance_holders )
+{
+   try {
+      ACTORS((alice)(bob));
+      const asset_id_type holder_asset = asset_id_type(1);
+      const auto& vesting_idx = dynamic_cast<const primary_index<vesting_balance_index>&>(db.get_index_type<vesting_balance_index>());
+      const auto& holders = vesting_idx.get_secondary_index<vesting_balance_holder_index>();
+
+      // the sums must match a walk over the by_asset_balance index
+      auto check_holders = [&]( asset_id_type asset_id ) {
+         std::map<account_id_type, share_type> expected;
+         const auto& by_balance = vesting_idx.indices().get<by_asset_balance>();
+         auto end = by_balance.upper_bound( boost::make_tuple( asset_id, share_type() ) );
+         for( auto itr = by_balance.lower_bound( boost::make_tuple( asset_id ) ); itr != end; ++itr )
+            expected[itr->owner] += itr->balance.amount;
+         const auto& actual = holders.get_holders( asset_id );
+         BOOST_CHECK( actual == expected );
+      };
+      auto create_vesting = [&]( account_id_type owner, asset amount ) -> const vesting_balance_object& {
+         return db.create<vesting_balance_object>( [&]( vesting_balance_object& vbo ) {
+            vbo.owner = owner;
+            vbo.balance = amount;
+            vbo.policy = cdd_vesting_policy();
+         });
+      };
+
+      BOOST_CHECK( holders.get_holders( holder_asset ).empty() );
+      const vesting_balance_object& alice_vb1 = create_vesting( alice_id, asset( 100, holder_asset ) );
+      const vesting_balance_object& alice_vb2 = create_vesting( alice_id, asset( 50, holder_asset ) );
+      const vesting_balance_object& bob_vb = create_vesting( bob_id, asset( 0, holder_asset ) );
+      const vesting_balance_id_type alice_vb1_id = alice_vb1.id;
+      const vesting_balance_id_type alice_vb2_id = alice_vb2.id;
+      const vesting_balance_id_type bob_vb_id = bob_vb.id;
+      BOOST_REQUIRE_EQUAL( holders.get_holders( holder_asset ).size(), 1u );
+      BOOST_CHECK_EQUAL( holders.get_holders( holder_asset ).at( alice_id ).value, 150 );
+      check_holders( holder_asset );
+      check_holders( asset_id_type() );
+
+      db.modify( bob_vb, []( vesting_balance_object& vbo ) { vbo.balance.amount = 25; } );
+      BOOST_CHECK_EQUAL( holders.get_holders( holder_asset ).at( bob_id ).value, 25 );
+      db.modify( alice_vb1, []( vesting_balance_object& vbo ) { vbo.balance.amount = 0; } );
+      BOOST_CHECK_EQUAL( holders.get_holders( holder_asset ).at( alice_id ).value, 50 );
+      check_holders( holder_asset );
+
+      // undone changes are taken out again
+      {
+         auto session = db._undo_db.start_undo_session();
+         db.remove( alice_vb2 );
+         db.modify( bob_vb_id(db), [&]( vesting_balance_object& vbo ) { vbo.owner = alice_id; } );
+         BOOST_REQUIRE_EQUAL( holders.get_holders( holder_asset ).size(), 1u );
+         BOOST_CHECK_EQUAL( holders.get_holders( holder_asset ).at( alice_id ).value, 25 );
+         check_holders( holder_asset );
+         session.undo();
+      }
+      BOOST_CHECK_EQUAL( holders.get_holders( holder_asset ).at( alice_id ).value, 50 );
+      BOOST_CHECK_EQUAL( holders.get_holders( holder_asset ).at( bob_id ).value, 25 );
+      check_holders( holder_asset );
+
+      // the undo history restores removed objects as new copies
+      db.remove( alice_vb1_id(db) );
+      db.remove( alice_vb2_id(db) );
+      db.remove( bob_vb_id(db) );
+      BOOST_CHECK( holders.get_holders( holder_asset ).empty() );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
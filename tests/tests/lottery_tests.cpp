@@ -437,6 +437,62 @@ BOOST_AUTO_TEST_CASE( ending_by_date_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( ending_several_by_date_test )
+{
+   try {
+      // lotteries with an odd asset id are created active
+      vector<asset_id_type> lotteries;
+      while( lotteries.size() < 3 )
+      {
+         asset_id_type test_asset_id = db.get_index<asset_object>().get_next_id();
+         INVOKE( create_lottery_asset_test );
+         if( test_asset_id(db).lottery_options->is_active )
+            lotteries.push_back( test_asset_id );
+      }
+      for( int i = 1; i < 4; ++i )
+         transfer( account_id_type(), account_id_type(i), asset(1000000) );
+      for( size_t l = 0; l < lotteries.size(); ++l )
+      {
+         for( int i = 1; i < 4; ++i )
+         {
+            ticket_purchase_operation tpo;
+            tpo.fee = asset();
+            tpo.buyer = account_id_type(i);
+            tpo.lottery = lotteries[l];
+            tpo.tickets_to_buy = i + l;
+            tpo.amount = asset(100 * tpo.tickets_to_buy);
+            trx.operations.push_back(std::move(tpo));
+            graphene::chain::test::set_expiration(db, trx);
+            PUSH_TX( db, trx, ~0 );
+            trx.operations.clear();
+         }
+      }
+      generate_block();
+      for( size_t l = 0; l < lotteries.size(); ++l )
+      {
+         const asset_object& lottery = lotteries[l](db);
+         auto holders = lottery.get_holders(db);
+         BOOST_CHECK_EQUAL( holders.size(), 6 + 3 * l );
+         BOOST_CHECK( lottery.dynamic_data(db).current_supply == holders.size() );
+      }
+
+      const time_point_sec last_end = lotteries.back()(db).lottery_options->end_date;
+      while( db.head_block_time() < last_end + fc::seconds(30) )
+         generate_block();
+      for( auto lottery : lotteries )
+      {
+         BOOST_CHECK( !lottery(db).lottery_options->is_active );
+         BOOST_CHECK_EQUAL( lottery(db).dynamic_data(db).current_supply.value, 0 );
+         for( int i = 1; i < 4; ++i )
+            BOOST_CHECK_EQUAL( db.get_balance( account_id_type(i), lottery ).amount.value, 0 );
+         BOOST_CHECK( db.get_balance( lottery ).amount.value == 0 );
+      }
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( ending_by_participants_count_test )
 {
    try {
@@ -26,6 +26,8 @@
 
 #include <graphene/app/database_api.hpp>
 #include <graphene/chain/exceptions.hpp>
+#include <graphene/chain/vote_tally.hpp>
+#include <graphene/utilities/thread_pool.hpp>
 
 #include <iostream>
 
@@ -163,4 +165,129 @@ BOOST_AUTO_TEST_CASE(last_voting_date_proxy)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(provisional_vote_totals)
+{
+   try
+   {
+      ACTORS((alice)(bob));
+      const asset_object& test_asset = create_user_issued_asset( "TEST" );
+      transfer(committee_account, alice_id, asset(100000));
+      transfer(committee_account, bob_id, asset(50000));
+
+      const vote_totals& totals = db.get_vote_totals();
+      const vote_id_type vote1 = witness_id_type(1)(db).vote_id;
+      const vote_id_type vote2 = witness_id_type(2)(db).vote_id;
+      const uint64_t vote1_before = totals.votes(vote1);
+      const uint64_t vote2_before = totals.votes(vote2);
+      BOOST_CHECK( totals.matches_recount() );
+
+      auto update_options = [&]( account_id_type account, const fc::ecc::private_key& key,
+                                 const std::function<void(account_options&)>& change )
+      {
+         account_update_operation op;
+         op.account = account;
+         op.new_options = account(db).options;
+         change( *op.new_options );
+         trx.operations.push_back(op);
+         sign(trx, key);
+         PUSH_TX( db, trx, ~0 );
+         trx.clear();
+      };
+      auto stake_of = [&]( account_id_type account ) {
+         return uint64_t( db.get_balance( account, asset_id_type() ).amount.value
+                          + account(db).statistics(db).total_core_in_orders.value );
+      };
+
+      // alice votes, then bob votes with alice's opinions
+      update_options( alice_id, alice_private_key, [&]( account_options& o ) { o.votes.insert( vote1 ); } );
+      BOOST_CHECK_EQUAL( totals.votes(vote1), vote1_before + stake_of(alice_id) );
+      update_options( bob_id, bob_private_key, [&]( account_options& o ) { o.voting_account = alice_id; } );
+      BOOST_CHECK_EQUAL( totals.votes(vote1), vote1_before + stake_of(alice_id) + stake_of(bob_id) );
+      BOOST_CHECK( totals.matches_recount() );
+
+      // alice changes her opinion, which moves bob's stake too
+      update_options( alice_id, alice_private_key, [&]( account_options& o ) {
+         o.votes.erase( vote1 );
+         o.votes.insert( vote2 );
+      });
+      BOOST_CHECK_EQUAL( totals.votes(vote1), vote1_before );
+      BOOST_CHECK_EQUAL( totals.votes(vote2), vote2_before + stake_of(alice_id) + stake_of(bob_id) );
+
+      // core in open orders is still voting
+      BOOST_REQUIRE( create_sell_order( bob_id, asset(1000), test_asset.amount(10) ) != nullptr );
+      BOOST_CHECK_EQUAL( bob_id(db).statistics(db).total_core_in_orders.value, 1000 );
+      BOOST_CHECK_EQUAL( totals.votes(vote2), vote2_before + stake_of(alice_id) + stake_of(bob_id) );
+      BOOST_CHECK( totals.matches_recount() );
+
+      // undone changes are taken out again
+      {
+         auto session = db._undo_db.start_undo_session();
+         transfer(bob_id, account_id_type(), asset(20000));
+         BOOST_CHECK( totals.matches_recount() );
+         session.undo();
+      }
+      BOOST_CHECK_EQUAL( totals.votes(vote2), vote2_before + stake_of(alice_id) + stake_of(bob_id) );
+
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      BOOST_CHECK( totals.matches_recount() );
+      db.pop_block();
+      BOOST_CHECK( totals.matches_recount() );
+
+      vector<uint64_t> api_totals = graphene::app::database_api(db).get_provisional_vote_totals( { vote1, vote2 } );
+      BOOST_REQUIRE_EQUAL( api_totals.size(), 2u );
+      BOOST_CHECK_EQUAL( api_totals[0], totals.votes(vote1) );
+      BOOST_CHECK_EQUAL( api_totals[1], totals.votes(vote2) );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(vote_tally_with_worker_threads)
+{
+   try
+   {
+      // opinions with votes out of range and witness / committee counts above the maximum
+      vector<account_options> opinions( 50 );
+      for( size_t i = 0; i < opinions.size(); ++i )
+      {
+         for( uint32_t v = 0; v < i % 7; ++v )
+            opinions[i].votes.insert( vote_id_type( vote_id_type::witness, (i * 13 + v * 5) % 120 ) );
+         opinions[i].num_witness = i % 30;
+         opinions[i].num_committee = i % 25;
+      }
+      vector<vote_tally::voter> voters( 10000 );
+      for( size_t i = 0; i < voters.size(); ++i )
+      {
+         if( i % 11 == 0 )
+            continue; // not voting
+         voters[i].opinion = &opinions[i % opinions.size()];
+         voters[i].stake = i * 1000 + 7;
+      }
+
+      vote_tally serial( 100, 21, 11 );
+      serial.tally( voters, nullptr );
+      graphene::utilities::thread_pool pool( 4 );
+      vote_tally parallel( 100, 21, 11 );
+      parallel.tally( voters, &pool );
+
+      BOOST_CHECK( serial.votes() == parallel.votes() );
+      BOOST_CHECK( serial.witness_histogram() == parallel.witness_histogram() );
+      BOOST_CHECK( serial.committee_histogram() == parallel.committee_histogram() );
+      BOOST_CHECK_EQUAL( serial.total_stake(), parallel.total_stake() );
+      BOOST_CHECK_EQUAL( serial.votes().size(), 100u );
+      BOOST_CHECK_EQUAL( serial.witness_histogram().size(), 11u );
+
+      uint64_t expected_total = 0;
+      uint64_t expected_vote_0 = 0;
+      for( const auto& v : voters )
+      {
+         if( v.opinion == nullptr )
+            continue;
+         expected_total += v.stake;
+         if( v.opinion->votes.count( vote_id_type( vote_id_type::witness, 0 ) ) )
+            expected_vote_0 += v.stake;
+      }
+      BOOST_CHECK_EQUAL( parallel.total_stake(), expected_total );
+      BOOST_CHECK_EQUAL( parallel.votes()[0], expected_vote_0 );
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()